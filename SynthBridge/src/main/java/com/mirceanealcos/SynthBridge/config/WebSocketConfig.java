@@ -1,7 +1,10 @@
 package com.mirceanealcos.SynthBridge.config;
 
 import com.mirceanealcos.SynthBridge.dto.MidiEventDto;
+import com.mirceanealcos.SynthBridge.dto.ParameterAutomationDto;
 import com.mirceanealcos.SynthBridge.dto.PresetChangeDto;
+import com.mirceanealcos.SynthBridge.dto.StreamControlDto;
+import com.mirceanealcos.SynthBridge.handler.ComposerOutputHandler;
 import com.mirceanealcos.SynthBridge.handler.JsonWebSocketHandler;
 import io.micrometer.core.instrument.MeterRegistry;
 import org.springframework.beans.factory.annotation.Autowired;
@@ -25,7 +28,9 @@ public class WebSocketConfig implements WebSocketConfigurer {
     public void registerWebSocketHandlers(WebSocketHandlerRegistry registry) {
         registry.addHandler(new JsonWebSocketHandler<>(PresetChangeDto.class, meterRegistry, "preset_handler"), "/user/preset")
                 .addHandler(new JsonWebSocketHandler<>(MidiEventDto.class, meterRegistry,  "user_midi_input_handler"), "/user/input")
-                .addHandler(new JsonWebSocketHandler<>(MidiEventDto.class, meterRegistry,  "ai_midi_output_handler"), "/composer/output")
+                .addHandler(new ComposerOutputHandler(meterRegistry), "/composer/output")
+                .addHandler(new JsonWebSocketHandler<>(StreamControlDto.class, meterRegistry, "stream_control_handler"), "/host/streams")
+                .addHandler(new JsonWebSocketHandler<>(ParameterAutomationDto.class, meterRegistry, "automation_handler"), "/host/automation")
                 .setAllowedOrigins("*");
     }
 
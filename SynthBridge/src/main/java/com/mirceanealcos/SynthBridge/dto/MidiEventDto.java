@@ -1,6 +1,7 @@
 package com.mirceanealcos.SynthBridge.dto;
 
 import com.fasterxml.jackson.annotation.JsonIgnoreProperties;
+import com.fasterxml.jackson.annotation.JsonInclude;
 import com.fasterxml.jackson.annotation.JsonProperty;
 import lombok.AllArgsConstructor;
 import lombok.Data;
@@ -9,6 +10,7 @@ import lombok.NoArgsConstructor;
 @Data
 @AllArgsConstructor
 @NoArgsConstructor
+@JsonInclude(JsonInclude.Include.NON_NULL)
 @JsonIgnoreProperties(ignoreUnknown = true)
 public class MidiEventDto {
 
@@ -22,6 +24,34 @@ public class MidiEventDto {
     private Integer velocity;
     @JsonProperty("role")
     private String role;
+    @JsonProperty("session")
+    private String session;
+    @JsonProperty("phrase_id")
+    private Long phraseId;
+
+    // "cc" / "pitch_bend" from the user's controller
+    @JsonProperty("channel")
+    private Integer channel;
+    @JsonProperty("controller")
+    private Integer controller;
+    @JsonProperty("value")
+    private Integer value;
+
+    // SynthHost's running key estimate of the user's playing, e.g. "E- major"
+    @JsonProperty("key")
+    private String key;
+    @JsonProperty("key_confidence")
+    private Double keyConfidence;
+
+    // clock-sync ping/pong between SynthHost and the composer
+    @JsonProperty("peer")
+    private String peer;
+    @JsonProperty("seq")
+    private Long seq;
+    @JsonProperty("t0")
+    private Long t0;
+    @JsonProperty("t1")
+    private Long t1;
 
     @Override
     public String toString() {
@@ -31,6 +61,13 @@ public class MidiEventDto {
                 ", type='" + type + '\'' +
                 ", velocity=" + velocity +
                 ", role='" + role + '\'' +
+                ", session='" + session + '\'' +
+                ", phraseId=" + phraseId +
+                ", controller=" + controller +
+                ", value=" + value +
+                ", key='" + key + '\'' +
+                ", peer='" + peer + '\'' +
+                ", seq=" + seq +
                 '}';
     }
 
@@ -0,0 +1,35 @@
+package com.mirceanealcos.SynthBridge.dto;
+
+import com.fasterxml.jackson.annotation.JsonIgnoreProperties;
+import com.fasterxml.jackson.annotation.JsonInclude;
+import com.fasterxml.jackson.annotation.JsonProperty;
+import lombok.AllArgsConstructor;
+import lombok.Data;
+import lombok.NoArgsConstructor;
+
+// Moves one plugin parameter of a role's streams in SynthHost, e.g. a filter cutoff macro
+@Data
+@AllArgsConstructor
+@NoArgsConstructor
+@JsonInclude(JsonInclude.Include.NON_NULL)
+@JsonIgnoreProperties(ignoreUnknown = true)
+public class ParameterAutomationDto {
+
+    @JsonProperty("session")
+    private String session;
+    @JsonProperty("role")
+    private String role;
+    // plugin parameter id or name
+    @JsonProperty("parameter")
+    private String parameter;
+    // normalized 0..1
+    @JsonProperty("value")
+    private Double value;
+    @JsonProperty("ramp_ms")
+    private Integer rampMs;
+    @JsonProperty("timestamp")
+    private Long timestamp;
+    @JsonProperty("peer")
+    private String peer;
+
+}
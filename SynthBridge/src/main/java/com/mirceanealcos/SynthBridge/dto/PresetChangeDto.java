@@ -1,19 +1,35 @@
 package com.mirceanealcos.SynthBridge.dto;
 
 import com.fasterxml.jackson.annotation.JsonIgnoreProperties;
+import com.fasterxml.jackson.annotation.JsonInclude;
 import com.fasterxml.jackson.annotation.JsonProperty;
 import com.mirceanealcos.SynthBridge.dto.enums.Preset;
 import lombok.AllArgsConstructor;
 import lombok.Data;
 import lombok.NoArgsConstructor;
 
+import java.util.List;
+
 @Data
 @AllArgsConstructor
 @NoArgsConstructor
+@JsonInclude(JsonInclude.Include.NON_NULL)
 @JsonIgnoreProperties(ignoreUnknown = true)
 public class PresetChangeDto {
 
     @JsonProperty("preset")
     private Preset preset;
+    @JsonProperty("session")
+    private String session;
+
+    // completion report from SynthHost
+    @JsonProperty("event")
+    private String event;
+    @JsonProperty("error")
+    private String error;
+    @JsonProperty("ms")
+    private Long ms;
+    @JsonProperty("streams")
+    private List<PresetLoadDto> streams;
 
 }
@@ -0,0 +1,28 @@
+package com.mirceanealcos.SynthBridge.dto;
+
+import com.fasterxml.jackson.annotation.JsonIgnoreProperties;
+import com.fasterxml.jackson.annotation.JsonInclude;
+import com.fasterxml.jackson.annotation.JsonProperty;
+import lombok.AllArgsConstructor;
+import lombok.Data;
+import lombok.NoArgsConstructor;
+
+@Data
+@AllArgsConstructor
+@NoArgsConstructor
+@JsonInclude(JsonInclude.Include.NON_NULL)
+@JsonIgnoreProperties(ignoreUnknown = true)
+public class PresetLoadDto {
+
+    @JsonProperty("stream")
+    private Integer stream;
+    @JsonProperty("preset")
+    private String preset;
+    @JsonProperty("ms")
+    private Long ms;
+    @JsonProperty("skipped")
+    private Boolean skipped;
+    @JsonProperty("error")
+    private String error;
+
+}
@@ -0,0 +1,70 @@
+package com.mirceanealcos.SynthBridge.dto;
+
+import com.fasterxml.jackson.annotation.JsonIgnoreProperties;
+import com.fasterxml.jackson.annotation.JsonInclude;
+import com.fasterxml.jackson.annotation.JsonProperty;
+import lombok.AllArgsConstructor;
+import lombok.Data;
+import lombok.NoArgsConstructor;
+
+import java.util.List;
+import java.util.Map;
+
+@Data
+@AllArgsConstructor
+@NoArgsConstructor
+@JsonInclude(JsonInclude.Include.NON_NULL)
+@JsonIgnoreProperties(ignoreUnknown = true)
+public class StreamControlDto {
+
+    // requests towards SynthHost
+    @JsonProperty("action")
+    private String action;
+    @JsonProperty("session")
+    private String session;
+    @JsonProperty("stream")
+    private Integer stream;
+    @JsonProperty("port")
+    private Integer port;
+    @JsonProperty("role")
+    private String role;
+    @JsonProperty("ai")
+    private Boolean ai;
+    @JsonProperty("midi_input")
+    private String midiInput;
+    @JsonProperty("max_note_ms")
+    private Integer maxNoteMs;
+    @JsonProperty("max_voices")
+    private Integer maxVoices;
+    @JsonProperty("max_notes_per_second")
+    private Integer maxNotesPerSecond;
+
+    // replies from SynthHost
+    @JsonProperty("event")
+    private String event;
+    @JsonProperty("error")
+    private String error;
+    @JsonProperty("ms")
+    private Long ms;
+    @JsonProperty("sessions")
+    private Integer sessions;
+    @JsonProperty("cores")
+    private Integer cores;
+    @JsonProperty("load")
+    private Double load;
+    @JsonProperty("load_per_session")
+    private Double loadPerSession;
+    @JsonProperty("headroom")
+    private Double headroom;
+    @JsonProperty("free_port_blocks")
+    private Integer freePortBlocks;
+    @JsonProperty("available_sessions")
+    private Integer availableSessions;
+    @JsonProperty("estimated")
+    private Boolean estimated;
+    @JsonProperty("peers")
+    private List<Map<String, Object>> peers;
+    @JsonProperty("rejected_pongs")
+    private Long rejectedPongs;
+
+}
@@ -0,0 +1,53 @@
+package com.mirceanealcos.SynthBridge.handler;
+
+import com.mirceanealcos.SynthBridge.dto.MidiEventDto;
+import io.micrometer.core.instrument.MeterRegistry;
+import org.springframework.web.socket.WebSocketSession;
+
+import java.util.Set;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * /composer/output, where composers send generated events and SynthHost runs clock sync.
+ * Pings go only to composer peers (connections that have tagged a message with a peer id)
+ * and pongs only back to connections that sent pings, so UI subscribers never see either.
+ * A composer announces itself with {"type":"hello","peer":id} on connecting, which goes no further.
+ */
+public class ComposerOutputHandler extends JsonWebSocketHandler<MidiEventDto> {
+
+    private final Set<WebSocketSession> peers = ConcurrentHashMap.newKeySet();
+    private final Set<WebSocketSession> pingers = ConcurrentHashMap.newKeySet();
+
+    public ComposerOutputHandler(MeterRegistry meterRegistry) {
+        super(MidiEventDto.class, meterRegistry, "ai_midi_output_handler");
+    }
+
+    @Override
+    protected void onReceived(WebSocketSession sender, MidiEventDto event) {
+        if ("ping".equals(event.getType())) {
+            pingers.add(sender);
+        } else if (event.getPeer() != null) {
+            peers.add(sender);
+        }
+    }
+
+    @Override
+    protected boolean shouldDeliver(WebSocketSession target, MidiEventDto event) {
+        if ("hello".equals(event.getType())) {
+            return false;
+        }
+        if ("ping".equals(event.getType())) {
+            return peers.contains(target);
+        }
+        if ("pong".equals(event.getType())) {
+            return pingers.contains(target);
+        }
+        return true;
+    }
+
+    @Override
+    protected void onClosed(WebSocketSession session) {
+        peers.remove(session);
+        pingers.remove(session);
+    }
+}
@@ -15,6 +15,7 @@ import org.springframework.web.socket.handler.TextWebSocketHandler;
 
 import java.util.Collections;
 import java.util.HashSet;
+import java.util.List;
 import java.util.Set;
 
 public class JsonWebSocketHandler<T> extends TextWebSocketHandler {
@@ -47,15 +48,23 @@ public class JsonWebSocketHandler<T> extends TextWebSocketHandler {
 
     @Override
     protected void handleTextMessage(WebSocketSession session, TextMessage message) throws Exception {
-        messageCounter.increment();
         try {
-            T json = mapper.readValue(message.getPayload(), payloadType);
-            log.info(json.toString());
-            synchronized (sessions) {
-                for (WebSocketSession s : sessions) {
-                    if (s.isOpen() && !session.equals(s)) {
-                        s.sendMessage(new TextMessage(mapper.writeValueAsString(json)));
+            // SynthHost coalesces messages queued behind an in-flight write into one JSON array frame;
+            // fan them back out so subscribers keep receiving one object per message.
+            String payload = message.getPayload().trim();
+            List<T> items = payload.startsWith("[")
+                    ? mapper.readValue(payload, mapper.getTypeFactory().constructCollectionType(List.class, payloadType))
+                    : List.of(mapper.readValue(payload, payloadType));
+            messageCounter.increment(items.size());
+            for (T json : items) {
+                log.info(json.toString());
+                onReceived(session, json);
+                synchronized (sessions) {
+                    for (WebSocketSession s : sessions) {
+                        if (s.isOpen() && !session.equals(s) && shouldDeliver(s, json)) {
+                            s.sendMessage(new TextMessage(mapper.writeValueAsString(json)));
 
+                        }
                     }
                 }
             }
@@ -67,9 +76,23 @@ public class JsonWebSocketHandler<T> extends TextWebSocketHandler {
         }
     }
 
+    /** Called for every message before it is fanned out; lets a subclass learn who its peers are. */
+    protected void onReceived(WebSocketSession sender, T json) {
+    }
+
+    /** Whether a message goes to the given subscriber (never to its sender); by default it does. */
+    protected boolean shouldDeliver(WebSocketSession target, T json) {
+        return true;
+    }
+
+    /** Called once a subscriber is gone. */
+    protected void onClosed(WebSocketSession session) {
+    }
+
     @Override
     public void handleTransportError(WebSocketSession session, Throwable exception) throws Exception {
         sessions.remove(session);
+        onClosed(session);
         session.close(CloseStatus.SERVER_ERROR);
         log.error("Transport error: " + exception.getMessage());
         errorCounter.increment();
@@ -79,6 +102,7 @@ public class JsonWebSocketHandler<T> extends TextWebSocketHandler {
     public void afterConnectionClosed(WebSocketSession session, CloseStatus status) {
         log.info("Connection to " + session.getId() + " closed.");
         sessions.remove(session);
+        onClosed(session);
         disconnectCounter.increment();
     }
 }
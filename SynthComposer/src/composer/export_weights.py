@@ -0,0 +1,64 @@
+# export_weights.py
+# =================
+# Writes a music_rnn.pt checkpoint as the flat little-endian file SynthHost's
+# native composer loads (SynthHost/composer/MusicRNN.cpp):
+#
+#   "MRNN0001"
+#   uint32 × 8   vocab, roles, keys, embed_dim, role_dim, key_dim, hidden_dim, num_layers
+#   keys         per key index: uint32 length + utf-8 name
+#   float32      embed, role_embed, key_embed,
+#                per layer: weight_ih, weight_hh, bias_ih, bias_hh,
+#                fc.weight, fc.bias            (PyTorch layouts, row-major)
+#
+#   python -m src.composer.export_weights --model_path music_rnn.pt --out music_rnn.bin
+
+import argparse
+import struct
+
+import torch
+
+from src.composer.music_rnn import MusicRNN, VOCAB, ROLES
+
+MAGIC = b"MRNN0001"
+
+def export(model_path, out_path):
+    ckpt = torch.load(model_path, map_location="cpu")
+    key2idx = ckpt.get("key2idx")
+    if key2idx is None:
+        raise RuntimeError("Checkpoint missing 'key2idx'; re-save your model with key2idx included.")
+
+    model = MusicRNN(vocab_size=len(VOCAB), num_roles=len(ROLES), num_keys=len(key2idx))
+    model.load_state_dict(ckpt["model_state"])
+    state = model.state_dict()
+    lstm = model.lstm
+
+    tensors = ["embed.weight", "role_embed.weight", "key_embed.weight"]
+    for layer in range(lstm.num_layers):
+        tensors += [f"lstm.weight_ih_l{layer}", f"lstm.weight_hh_l{layer}",
+                    f"lstm.bias_ih_l{layer}", f"lstm.bias_hh_l{layer}"]
+    tensors += ["fc.weight", "fc.bias"]
+
+    with open(out_path, "wb") as f:
+        f.write(MAGIC)
+        f.write(struct.pack("<8I",
+                            len(VOCAB), len(ROLES), len(key2idx),
+                            model.embed.embedding_dim,
+                            model.role_embed.embedding_dim,
+                            model.key_embed.embedding_dim,
+                            lstm.hidden_size,
+                            lstm.num_layers))
+        for key, _ in sorted(key2idx.items(), key=lambda kv: kv[1]):
+            name = key.encode("utf-8")
+            f.write(struct.pack("<I", len(name)))
+            f.write(name)
+        for name in tensors:
+            f.write(state[name].detach().numpy().astype("<f4").tobytes())
+
+    print(f"💾 Exported {len(tensors)} tensors, {len(key2idx)} keys to {out_path}", flush=True)
+
+if __name__ == "__main__":
+    p = argparse.ArgumentParser()
+    p.add_argument("--model_path", type=str, default="music_rnn.pt")
+    p.add_argument("--out",        type=str, default="music_rnn.bin")
+    args = p.parse_args()
+    export(args.model_path, args.out)
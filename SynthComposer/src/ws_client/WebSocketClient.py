@@ -5,6 +5,7 @@ import time
 import asyncio
 import json
 import re
+import socket
 
 import torch
 import websockets
@@ -29,6 +30,7 @@ WS_URI_OUT    = "ws://localhost:8080/composer/output"
 MODEL_PATH    = "../composer/music_rnn.pt"
 GENERATE_LENGTH = 128
 TIME_QUANT_MS = 10   # must match your music_rnn.py
+PEER_ID       = f"composer-{socket.gethostname()}-{os.getpid()}"
 
 # ——— UTILITIES ——————————————————————————————————————————
 
@@ -100,6 +102,75 @@ def normalize_key_name(raw_key: str) -> str:
     # fallback: lowercase, no spaces
     return k.replace(" ", "")
 
+def with_session(event: dict, session) -> dict:
+    """
+    Tag an outgoing event with the SynthHost session of the input that produced it,
+    so a host running several sessions routes it to the right stream set.
+    """
+    if session:
+        event["session"] = session
+    return event
+
+def with_peer(event: dict) -> dict:
+    """
+    Tag an outgoing event with this composer's peer id; SynthHost keeps a clock offset
+    per peer and uses it to translate our timestamps into its own clock.
+    """
+    event["peer"] = PEER_ID
+    return event
+
+def now_ms() -> int:
+    return int(time.time() * 1000)
+
+async def cancel_phrases(ws_out, phrases: dict, session):
+    """
+    Tell SynthHost to drop the still-queued part of every phrase we generated
+    (it also releases the notes those phrases left sounding).
+    """
+    for role, phrase_id in phrases.items():
+        await ws_out.send(json.dumps(with_peer(with_session({
+            "type":      "cancel",
+            "role":      role,
+            "phrase_id": phrase_id,
+            "timestamp": now_ms()
+        }, session))))
+    phrases.clear()
+
+async def answer_pings(ws_out):
+    """
+    Answer SynthHost's clock-sync pings on the output socket (NTP-style: echo its send
+    time as t0, our receive time as t1 and our send time as the timestamp).
+    """
+    async for msg in ws_out:
+        received = now_ms()
+        try:
+            evt = json.loads(msg)
+        except ValueError:
+            continue
+        if not isinstance(evt, dict) or evt.get("type") != "ping":
+            continue
+        await ws_out.send(json.dumps(with_peer({
+            "type":      "pong",
+            "seq":       evt.get("seq"),
+            "t0":        evt.get("timestamp"),
+            "t1":        received,
+            "timestamp": now_ms()
+        })))
+
+class SessionState:
+    """
+    What the composer keeps per SynthHost session. Sessions are independent jams, so each has
+    its own note history, key and the phrases generated for it.
+    """
+    def __init__(self):
+        self.keydet      = KeyDetector()
+        self.buffer      = []    # (t_sec, pitch, vel)
+        self.last_gen    = time.time()
+        self.current_key = None
+        self.host_key    = None  # last key SynthHost reported
+        self.user_role   = None
+        self.phrases     = {}    # role -> id of the last phrase sent for it
+
 # ——— MAIN ASYNC LOOP —————————————————————————————
 
 async def run():
@@ -125,15 +196,16 @@ async def run():
     model.eval()
     print("✅ Loaded RNN checkpoint")
 
-    keydet       = KeyDetector()
-    buffer       = []    # (t_sec, pitch, vel)
-    pending_offs = []    # (send_time_sec, role, pitch)
-    last_gen     = time.time()
-    current_key  = None
+    sessions     = {}    # session id (None for the host's default) -> SessionState
+    pending_offs = []    # (send_time_sec, role, pitch, session, phrase_id)
+    next_phrase  = 1
 
     async with websockets.connect(WS_URI_IN) as ws_in, \
                websockets.connect(WS_URI_OUT) as ws_out:
         print("🎶 Connected to WS in/out")
+        # the bridge only forwards SynthHost's clock pings to connections it knows as peers
+        await ws_out.send(json.dumps(with_peer({"type": "hello", "timestamp": now_ms()})))
+        pinger = asyncio.create_task(answer_pings(ws_out))
         async for msg in ws_in:
             evt = json.loads(msg)
             now = time.time()
@@ -141,44 +213,61 @@ async def run():
             # flush pending note_offs
             due = [off for off in pending_offs if off[0] <= now]
             pending_offs[:] = [off for off in pending_offs if off[0] > now]
-            for send_t, role, pitch in due:
-                await ws_out.send(json.dumps({
+            for send_t, role, pitch, session, phrase_id in due:
+                await ws_out.send(json.dumps(with_peer(with_session({
                     "type":      "note_off",
                     "role":      role,
                     "note":      pitch,
                     "velocity":  0,
-                    "timestamp": int(send_t * 1000)
-                }))
-
-            # key detection
-            keydet.feed_event(evt)
-            det = keydet.estimate_key()
+                    "timestamp": int(send_t * 1000),
+                    "phrase_id": phrase_id
+                }, session))))
+
+            session = evt.get("session")
+            state = sessions.setdefault(session, SessionState())
+
+            # the user switched instrument: what we queued for the old roles no longer fits
+            if evt.get("role") and evt["role"] != state.user_role:
+                if state.user_role is not None:
+                    await cancel_phrases(ws_out, state.phrases, session)
+                state.user_role = evt["role"]
+
+            # key detection: SynthHost tags user notes with its own running estimate;
+            # fall back to analysing the notes here when it doesn't
+            if evt.get("key"):
+                det = evt["key"] if evt["key"] != state.host_key else None
+                state.host_key = evt["key"]
+            else:
+                state.keydet.feed_event(evt)
+                det = state.keydet.estimate_key()
             if det:
                 norm = normalize_key_name(det)
                 if norm in KEY2IDX:
-                    current_key = norm
-                    print(f"🎹 Key → {det}  (normalized to '{current_key}')")
+                    if state.current_key is not None and norm != state.current_key:
+                        await cancel_phrases(ws_out, state.phrases, session)
+                    state.current_key = norm
+                    print(f"🎹 Key → {det}  (normalized to '{state.current_key}')")
                 else:
                     print(f"⚠️ Detected key '{det}' normalized to '{norm}', which is not in model keys")
 
 
             # buffer user note_on
             if evt.get("type") == "note_on":
-                buffer.append((
+                state.buffer.append((
                     evt["timestamp"] / 1000.0,
                     evt["note"],
                     evt["velocity"]
                 ))
 
             # wait until we have a valid key
-            if current_key is None or current_key not in KEY2IDX:
+            if state.current_key is None or state.current_key not in KEY2IDX:
                 continue
 
             # generate every second
-            if now - last_gen >= 1.0:
-                last_gen = now
+            if now - state.last_gen >= 1.0:
+                state.last_gen = now
 
-                seed = buffer_to_seed_tokens(buffer)
+                seed = buffer_to_seed_tokens(state.buffer)
                 if not seed:
                     continue
                 for role in ROLES:
@@ -189,24 +278,28 @@ async def run():
                         model,
                         seed,
                         role,
-                        current_key,
+                        state.current_key,
                         GENERATE_LENGTH,
                         device=device,
                         temp=1.0
                     )
                     evs = token_stream_to_events(tok_idxs, role, start_time=now)
+                    phrase_id = next_phrase
+                    next_phrase += 1
+                    state.phrases[role] = phrase_id
                     for t, typ, pitch, vel in evs:
-                        await ws_out.send(json.dumps({
+                        await ws_out.send(json.dumps(with_peer(with_session({
                             "type":      typ,
                             "role":      role,
                             "note":      pitch,
                             "velocity":  vel,
-                            "timestamp": int(t * 1000)
-                        }))
+                            "timestamp": int(t * 1000),
+                            "phrase_id": phrase_id
+                        }, session))))
                         if typ == "note_on":
-                            pending_offs.append((t + 0.1, role, pitch))
+                            pending_offs.append((t + 0.1, role, pitch, session, phrase_id))
 
-                buffer.clear()
+                state.buffer.clear()
 
 if __name__ == "__main__":
     asyncio.run(run())
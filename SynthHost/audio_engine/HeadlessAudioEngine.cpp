@@ -1,7 +1,14 @@
 #include "HeadlessAudioEngine.h"
+#include "LookAheadRenderer.h"
 #include "./utils/AudioRingBuffer.h"
 #include "../utils/serum/SerumEditor.h"
+#include "../capture/SessionRecorder.h"
+#include "../executor/MessageThread.h"
+#include "../executor/ThreadPolicy.h"
+#include "../vst_hosting/NativeSynthInstance.h"
+#include "../vst_hosting/Vst3DirectInstance.h"
 #include <juce_audio_formats/juce_audio_formats.h>
+#include <mutex>
 
 class InternalCallback : public juce::AudioIODeviceCallback
 {
@@ -16,42 +23,129 @@ public:
         if (! owner->plugin)
             return;
 
-        juce::AudioBuffer<float> pluginBuffer (numOutputChannels, numSamples);
+        // the driver's thread; it can change across device restarts
+        if (! threadPolicyApplied)
+        {
+            ThreadPolicy::instance().applyToCurrentThread (ThreadPolicy::Role::RENDER, owner->threadSlot);
+            threadPolicyApplied = true;
+        }
+
+        render (numOutputChannels, numSamples, nullptr);
+
+        for (int ch = 0; ch < numOutputChannels; ++ch)
+            juce::FloatVectorOperations::clear (outputs[ch], numSamples);
+    }
+
+    // One block into the ring buffer. injectedMidi stands in for the controller input when
+    // rendering offline.
+    void render (int numChannels, int numSamples, const juce::MidiBuffer* injectedMidi)
+    {
+        // allocated in prepare(); only grows here if the device hands over a bigger block
+        pluginBuffer.setSize (numChannels, numSamples, false, false, true);
+
+        // rendered ahead on the look-ahead worker, which also accounts for the load
+        if (owner->lookAhead != nullptr)
+        {
+            owner->lookAhead->release (pluginBuffer);
+            owner->ringBuffer->write (pluginBuffer);
+            return;
+        }
+
+        juce::AudioProcessLoadMeasurer::ScopedTimer loadTimer (owner->loadMeasurer, numSamples);
         pluginBuffer.clear();
 
-        juce::MidiBuffer midi;
+        auto& midi = blockMidi;
+        midi.clear();
         owner->midiInputCollector.removeNextBlockOfMessages (midi, numSamples);
+        if (injectedMidi != nullptr)
+            midi.addEvents (*injectedMidi, 0, numSamples, 0);
 
-        if (owner->shouldInjectAI) {
-            std::lock_guard<std::mutex> lock(owner->pendingMutex);
-            auto& queue = owner->pendingMidi;
-            std::vector<std::pair<int, juce::MidiMessage>> nextQueue;
-            nextQueue.reserve(queue.size());
-
-            for (auto& event: queue) {
-                int delay = event.first;
-                auto& msg = event.second;
-                if (delay < numSamples)
-                    midi.addEvent(msg, delay);
-                else
-                    nextQueue.emplace_back(delay - numSamples, msg);
-            }
-            queue.swap(nextQueue);
+        if (owner->shouldInjectAI)
+        {
+            owner->midiScheduler.renderNextBlock (midi, numSamples);
+            owner->midiGovernor.process (midi, numSamples);
         }
 
-        owner->plugin->processBlock (pluginBuffer, midi);
+        const auto& automation = owner->parameterAutomation.renderNextBlock (numSamples);
+        process (pluginBuffer, midi, automation);
 
         owner->ringBuffer->write (pluginBuffer);
+    }
 
-        for (int ch = 0; ch < numOutputChannels; ++ch)
-            juce::FloatVectorOperations::clear (outputs[ch], numSamples);
+    // buffer comes in cleared, and stays so while the plugin is idle
+    void process (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                  const std::vector<ParameterAutomation::Point>& automation)
+    {
+        auto& idle = owner->idleDetector;
+        if (! idle.shouldRender (midi, ! automation.empty(), buffer.getNumSamples()))
+            return;
+
+        // a preset load holds the callback lock and suspends the plugin; render silence meanwhile
+        const juce::ScopedTryLock pluginLock (owner->plugin->getCallbackLock());
+        if (pluginLock.isLocked() && ! owner->plugin->isSuspended())
+        {
+            const auto started = juce::Time::getHighResolutionTicks();
+            if (automation.empty())
+                owner->plugin->processBlock (buffer, midi);
+            else
+                processAutomated (buffer, midi, automation);
+            const auto elapsed = juce::Time::getHighResolutionTicks() - started;
+            idle.rendered (midi, buffer, (int64_t) (juce::Time::highResolutionTicksToSeconds (elapsed) * 1e6));
+        }
+    }
+
+    // A direct VST3 instance takes the points as parameter changes inside one process call; any
+    // other plugin is rendered in slices between the points, with its parameters set before each.
+    void processAutomated (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                           const std::vector<ParameterAutomation::Point>& points)
+    {
+        auto& plugin = *owner->plugin;
+        if (auto* direct = dynamic_cast<Vst3DirectInstance*> (&plugin))
+        {
+            for (const auto& point : points)
+                direct->addParameterChange (point.parameter, point.value, point.sampleOffset);
+            plugin.processBlock (buffer, midi);
+            return;
+        }
+
+        const auto& parameters = plugin.getParameters();
+        const int numSamples = buffer.getNumSamples();
+        size_t next = 0;
+        int start = 0;
+        while (start < numSamples)
+        {
+            for (; next < points.size() && points[next].sampleOffset <= start; ++next)
+                if (points[next].parameter < (uint32_t) parameters.size())
+                    parameters[(int) points[next].parameter]->setValue (points[next].value);
+
+            const int end = next < points.size() ? points[next].sampleOffset : numSamples;
+            juce::AudioBuffer<float> slice (buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                            start, end - start);
+            sliceMidi.clear();
+            sliceMidi.addEvents (midi, start, end - start, -start);
+            plugin.processBlock (slice, sliceMidi);
+            start = end;
+        }
     }
 
     void audioDeviceAboutToStart (juce::AudioIODevice* device) override
     {
-        owner->plugin->prepareToPlay (device->getCurrentSampleRate(),
-                                      device->getCurrentBufferSizeSamples());
-        owner->midiInputCollector.getMidiMessageCollector().reset (device->getCurrentSampleRate());
+        threadPolicyApplied = false;
+        prepare (device->getCurrentSampleRate(), device->getCurrentBufferSizeSamples());
+    }
+
+    void prepare (double sampleRate, int blockSize)
+    {
+        owner->plugin->prepareToPlay (sampleRate, blockSize);
+        owner->loadMeasurer.reset (sampleRate, blockSize);
+        owner->midiInputCollector.getMidiMessageCollector().reset (sampleRate);
+        owner->midiGovernor.prepare (sampleRate, blockSize);
+        owner->idleDetector.prepare (sampleRate);
+        blockMidi.ensureSize ((size_t) blockSize * 4);
+        sliceMidi.ensureSize ((size_t) blockSize * 4);
+        // cleared so the pages are touched now rather than on the first callback
+        pluginBuffer.setSize (2, blockSize);
+        pluginBuffer.clear();
     }
 
     void audioDeviceStopped() override
@@ -62,15 +156,24 @@ public:
 
 private:
     HeadlessAudioEngine* owner;
+    // kept across callbacks so a block's MIDI doesn't allocate
+    juce::MidiBuffer blockMidi;
+    juce::MidiBuffer sliceMidi;
+    juce::AudioBuffer<float> pluginBuffer;
+    bool threadPolicyApplied = false;
 };
 
 //==============================================================================
 
+std::mutex HeadlessAudioEngine::midiInputsMutex;
+std::map<juce::String, HeadlessAudioEngine*> HeadlessAudioEngine::midiInputOwners;
+
 HeadlessAudioEngine::HeadlessAudioEngine (double sr, int bs)
     : sampleRate (sr), blockSize (bs)
 {
     // Now stereo: 2 channels, capacity = 2 * blockSize frames
     ringBuffer = std::make_shared<AudioRingBuffer> (2, 2 * blockSize);
+    offlineScratch.resize ((size_t) (2 * 2 * blockSize));
     callback   = std::make_unique<InternalCallback> (this);
 }
 
@@ -79,43 +182,162 @@ HeadlessAudioEngine::~HeadlessAudioEngine()
     stop();
 }
 
+void HeadlessAudioEngine::processPlugin (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                                         const std::vector<ParameterAutomation::Point>& automation)
+{
+    static_cast<InternalCallback*> (callback.get())->process (buffer, midi, automation);
+}
+
+bool HeadlessAudioEngine::enableLookAhead (int horizonSamples)
+{
+    auto* synth = dynamic_cast<NativeSynthInstance*> (plugin.get());
+    if (! shouldInjectAI || synth == nullptr || horizonSamples <= 0)
+        return false;
+    if (lookAhead != nullptr)
+        return true;
+
+    // swapped in between two callbacks; the worker starts once the device is prepared again
+    const bool running = deviceManager.getCurrentAudioDevice() != nullptr;
+    if (running)
+        deviceManager.removeAudioCallback (callback.get());
+    lookAhead = std::make_unique<LookAheadRenderer> (*this, *synth, horizonSamples,
+                                                     juce::jmin (2 * blockSize, 8192));
+    lookAheadSamples = horizonSamples;
+    if (running)
+    {
+        deviceManager.addAudioCallback (callback.get());
+        lookAhead->start();
+    }
+    return true;
+}
+
 void HeadlessAudioEngine::setMidiRole(std::string role) {
     this->midiInputCollector.setUserRole(role);
 }
 
+void HeadlessAudioEngine::setSessionID(std::string sessionID) {
+    if (captureId >= 0)
+        SessionRecorder::instance().recordSession(captureId, sessionID);
+    this->midiInputCollector.setSessionID(sessionID);
+}
+
+void HeadlessAudioEngine::setCaptureId(int id) {
+    captureId = id;
+    midiInputCollector.setCaptureId(id);
+}
+
+void HeadlessAudioEngine::prepareOffline()
+{
+    if (plugin)
+        static_cast<InternalCallback*> (callback.get())->prepare (sampleRate, blockSize);
+}
+
+void HeadlessAudioEngine::renderOffline (const juce::MidiBuffer& injectedMidi, int numSamples)
+{
+    if (! plugin)
+        return;
+    static_cast<InternalCallback*> (callback.get())->render (2, numSamples, &injectedMidi);
+    // nothing streams offline; keep the ring buffer from wrapping over itself
+    ringBuffer->read (offlineScratch.data(), (int) offlineScratch.size());
+}
+
+void HeadlessAudioEngine::setControllerForwardRate(int rateHz) {
+    this->midiInputCollector.setControllerForwardRate(rateHz);
+}
+
+void HeadlessAudioEngine::setNoteListener(MidiInputCollector::NoteListener listener) {
+    this->midiInputCollector.setNoteListener(std::move(listener));
+}
+
+std::unique_ptr<juce::AudioPluginInstance> HeadlessAudioEngine::releasePlugin()
+{
+    // the renderer holds on to the plugin; setPlugin() brings it back
+    lookAhead.reset();
+    return std::move (plugin);
+}
+
 void HeadlessAudioEngine::setPlugin (std::unique_ptr<juce::AudioPluginInstance> p)
 {
     plugin = std::move (p);
     plugin->prepareToPlay (sampleRate, blockSize);
+    idleDetector.setTailSeconds (plugin->getTailLengthSeconds());
+    if (lookAheadSamples > 0)
+        enableLookAhead (lookAheadSamples);
+    std::lock_guard<std::mutex> lock (parameterIdsMutex);
+    parameterIds.clear();
 }
 
 void HeadlessAudioEngine::setPreset (Preset preset)
 {
+    if (captureId >= 0)
+        SessionRecorder::instance().recordPreset (captureId, preset);
+    if (plugin)
+        plugin->suspendProcessing (true);
     SerumEditor::loadSerumPreset (preset, plugin.get());
+    {
+        std::lock_guard<std::mutex> lock (parameterIdsMutex);
+        parameterOverrides.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock (presetMutex);
+        currentPreset = preset;
+    }
+    // the new preset's wavetables are paged in here rather than under the first notes
+    warmUp();
+    if (plugin)
+    {
+        idleDetector.setTailSeconds (plugin->getTailLengthSeconds());
+        plugin->suspendProcessing (false);
+    }
     setMidiRole(preset.type);
 }
 
-void HeadlessAudioEngine::start()
+void HeadlessAudioEngine::warmUp (int silentBlocks, int noteBlocks)
 {
     if (! plugin)
         return;
 
-    deviceManager.initialise (0, 2, nullptr, true);
+    static constexpr int testNotes[] = { 36, 60, 84 };
+    const juce::ScopedLock pluginLock (plugin->getCallbackLock());
+    juce::AudioBuffer<float> buffer (juce::jmax (2, plugin->getTotalNumInputChannels(),
+                                                 plugin->getTotalNumOutputChannels()), blockSize);
+    juce::MidiBuffer midi;
 
-    if (!shouldInjectAI) {
-        for (auto& dev : juce::MidiInput::getAvailableDevices())
+    for (int i = 0; i < silentBlocks + noteBlocks; ++i)
+    {
+        buffer.clear();
+        midi.clear();
+        int noteBlock = i - silentBlocks;
+        for (int note : testNotes)
         {
-            if (dev.name.containsIgnoreCase ("Minilab3 MIDI"))
-            {
-                deviceManager.setMidiInputDeviceEnabled (dev.identifier, true);
-                deviceManager.addMidiInputDeviceCallback (dev.identifier,
-                                                          &midiInputCollector);
-                break;
-            }
+            if (noteBlock == 0)
+                midi.addEvent (juce::MidiMessage::noteOn (1, note, (juce::uint8) 20), 0);
+            else if (noteBlock == noteBlocks - 1)
+                midi.addEvent (juce::MidiMessage::noteOff (1, note), 0);
         }
+        plugin->processBlock (buffer, midi);
     }
+    // drop the test notes' tails
+    plugin->reset();
+}
+
+void HeadlessAudioEngine::start()
+{
+    if (! plugin)
+        return;
+
+    // device types enumerate and open the driver through process-wide state; streams starting
+    // together take turns here
+    static std::mutex deviceMutex;
+    std::lock_guard<std::mutex> deviceLock (deviceMutex);
+    deviceManager.initialise (0, 2, nullptr, true);
+
+    if (! shouldInjectAI)
+        claimMidiInput();
 
     deviceManager.addAudioCallback (callback.get());
+    if (lookAhead != nullptr)
+        lookAhead->start();
 
     if (auto* device = deviceManager.getCurrentAudioDevice())
     {
@@ -131,15 +353,62 @@ void HeadlessAudioEngine::stop()
 {
     deviceManager.removeAudioCallback (callback.get());
     deviceManager.closeAudioDevice();
+    if (lookAhead != nullptr)
+        lookAhead->stop();
 
-    for (auto& dev : juce::MidiInput::getAvailableDevices())
-        deviceManager.removeMidiInputDeviceCallback (dev.identifier,
-                                                   &midiInputCollector);
+    releaseMidiInput();
 
     if (plugin)
         plugin->releaseResources();
 }
 
+bool HeadlessAudioEngine::setMidiInput (juce::String name)
+{
+    releaseMidiInput();
+    midiInputName = std::move (name);
+    return shouldInjectAI || claimMidiInput();
+}
+
+bool HeadlessAudioEngine::isMidiInputAvailable (const juce::String& name)
+{
+    std::lock_guard<std::mutex> lock (midiInputsMutex);
+    for (auto& dev : juce::MidiInput::getAvailableDevices())
+        if (dev.name.containsIgnoreCase (name) && midiInputOwners.count (dev.identifier) == 0)
+            return true;
+    return false;
+}
+
+bool HeadlessAudioEngine::claimMidiInput()
+{
+    std::lock_guard<std::mutex> lock (midiInputsMutex);
+    if (midiInputId.isNotEmpty())
+        return true;
+    for (auto& dev : juce::MidiInput::getAvailableDevices())
+    {
+        if (dev.name.containsIgnoreCase (midiInputName) && midiInputOwners.count (dev.identifier) == 0)
+        {
+            midiInputOwners[dev.identifier] = this;
+            midiInputId = dev.identifier;
+            deviceManager.setMidiInputDeviceEnabled (dev.identifier, true);
+            deviceManager.addMidiInputDeviceCallback (dev.identifier, &midiInputCollector);
+            std::cout << "MIDI input: " << dev.name << std::endl;
+            return true;
+        }
+    }
+    return false;
+}
+
+void HeadlessAudioEngine::releaseMidiInput()
+{
+    std::lock_guard<std::mutex> lock (midiInputsMutex);
+    if (midiInputId.isEmpty())
+        return;
+    deviceManager.removeMidiInputDeviceCallback (midiInputId, &midiInputCollector);
+    deviceManager.setMidiInputDeviceEnabled (midiInputId, false);
+    midiInputOwners.erase (midiInputId);
+    midiInputId.clear();
+}
+
 void HeadlessAudioEngine::setMidiSenderClient(std::shared_ptr<WebSocketClient> sender)
 {
     this->midiInputCollector.setMidiSenderClient(sender);
@@ -149,14 +418,217 @@ void HeadlessAudioEngine::enableAIMidiInjection(bool e) {
     shouldInjectAI = e;
 }
 
-void HeadlessAudioEngine::enqueueMidi(const juce::MidiMessage &m, int delaySamples) {
-    std::lock_guard<std::mutex> lock(pendingMutex);
-    pendingMidi.emplace_back(delaySamples, m);
+void HeadlessAudioEngine::printStats() const {
+    midiInputCollector.printStats();
+    if (lookAhead != nullptr) {
+        lookAhead->printStats();
+        midiGovernor.printStats();
+    } else if (shouldInjectAI) {
+        midiScheduler.printStats();
+        midiGovernor.printStats();
+    }
+    parameterAutomation.printStats();
+    idleDetector.printStats();
+}
+
+bool HeadlessAudioEngine::automateParameter(const std::string &parameterId, float value, int delaySamples,
+                                            int rampSamples) {
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    if (hibernating) {
+        heldEvents.push_back({HeldEvent::Type::AUTOMATION, {}, 0, parameterId, value, rampSamples, dueIn(delaySamples)});
+        return true;
+    }
+    if (scheduleAutomation(parameterId, value, delaySamples, rampSamples)) {
+        pendingUntil = std::max(pendingUntil, dueIn(delaySamples + rampSamples));
+        return true;
+    }
+    return false;
+}
+
+bool HeadlessAudioEngine::scheduleAutomation(const std::string &parameterId, float value, int delaySamples,
+                                             int rampSamples) {
+    if (!plugin)
+        return false;
+    auto *direct = dynamic_cast<Vst3DirectInstance *>(plugin.get());
+    uint32_t parameter = 0;
+    {
+        std::lock_guard<std::mutex> lock(parameterIdsMutex);
+        auto it = parameterIds.find(parameterId);
+        if (it != parameterIds.end()) {
+            parameter = it->second;
+        } else {
+            bool found = false;
+            if (direct != nullptr) {
+                Steinberg::Vst::ParamID id = 0;
+                found = direct->findParameter(parameterId, id);
+                parameter = id;
+            } else {
+                juce::String wanted(parameterId);
+                for (auto *p: plugin->getParameters()) {
+                    auto *hosted = dynamic_cast<juce::HostedAudioProcessorParameter *>(p);
+                    if ((hosted != nullptr && hosted->getParameterID() == wanted) || p->getName(256).equalsIgnoreCase(wanted)) {
+                        parameter = (uint32_t) p->getParameterIndex();
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (!found)
+                return false;
+            parameterIds.emplace(parameterId, parameter);
+        }
+        parameterOverrides[parameterId] = juce::jlimit(0.0f, 1.0f, value);
+    }
+    // with look-ahead the plugin may hold a value from further on; the timeline corrects for that
+    float startValue = direct != nullptr
+                           ? (float) direct->getParameterValue(parameter)
+                           : plugin->getParameters()[(int) parameter]->getValue();
+    if (lookAhead != nullptr) {
+        lookAhead->automate(parameter, value, startValue, delaySamples, rampSamples);
+        return true;
+    }
+    return parameterAutomation.automate(parameter, value, startValue, delaySamples, rampSamples);
+}
+
+void HeadlessAudioEngine::setGovernorConfig(const MidiGovernor::Config &config) {
+    if (captureId >= 0)
+        SessionRecorder::instance().recordGovernor(captureId, config.maxNoteMillis, config.maxVoices,
+                                                   config.maxNotesPerSecond);
+    midiGovernor.setConfig(config);
 }
 
+void HeadlessAudioEngine::enqueueMidi(const juce::MidiMessage &m, int delaySamples, uint64_t phraseId) {
+    if (captureId >= 0)
+        SessionRecorder::instance().recordAiMidi(captureId, m, delaySamples, phraseId);
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    if (hibernating) {
+        heldEvents.push_back({HeldEvent::Type::MIDI, m, phraseId, {}, 0.0f, 0, dueIn(delaySamples)});
+        if (wakeHandler)
+            wakeHandler();
+        return;
+    }
+    scheduleMidi(m, delaySamples, phraseId);
+    pendingUntil = std::max(pendingUntil, dueIn(delaySamples));
+}
+
+void HeadlessAudioEngine::scheduleMidi(const juce::MidiMessage &m, int delaySamples, uint64_t phraseId) {
+    if (lookAhead != nullptr)
+        lookAhead->enqueueMidi(m, delaySamples, phraseId);
+    else
+        midiScheduler.schedule(m, delaySamples, phraseId);
+}
 
+void HeadlessAudioEngine::cancelPhrase(uint64_t phraseId) {
+    if (captureId >= 0)
+        SessionRecorder::instance().recordCancel(captureId, phraseId);
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    if (hibernating)
+        heldEvents.push_back({HeldEvent::Type::CANCEL, {}, phraseId, {}, 0.0f, 0, std::chrono::steady_clock::now()});
+    else
+        scheduleCancel(phraseId);
+}
 
+void HeadlessAudioEngine::scheduleCancel(uint64_t phraseId) {
+    if (lookAhead != nullptr)
+        lookAhead->cancelPhrase(phraseId);
+    else
+        midiScheduler.cancelPhrase(phraseId);
+}
 
+std::chrono::steady_clock::time_point HeadlessAudioEngine::dueIn(int delaySamples) const {
+    return std::chrono::steady_clock::now()
+           + std::chrono::microseconds(int64_t(1'000'000.0 * std::max(0, delaySamples) / sampleRate));
+}
 
+bool HeadlessAudioEngine::beginHibernation(double minIdleSeconds) {
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    if (hibernating || !plugin || !shouldInjectAI || !idleDetector.isIdle()
+        || idleDetector.getIdleSeconds() < minIdleSeconds || std::chrono::steady_clock::now() < pendingUntil)
+        return false;
+    hibernating = true;
+    return true;
+}
 
+int HeadlessAudioEngine::endHibernation() {
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    if (!hibernating)
+        return 0;
+    hibernating = false;
+    int late = 0;
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &event: heldEvents) {
+        int delaySamples = event.due > now
+                               ? int(std::chrono::duration<double>(event.due - now).count() * sampleRate + 0.5)
+                               : 0;
+        switch (event.type) {
+            case HeldEvent::Type::MIDI:
+                if (event.due < now && event.message.isNoteOn())
+                    ++late;
+                scheduleMidi(event.message, delaySamples, event.phraseId);
+                break;
+            case HeldEvent::Type::CANCEL:
+                scheduleCancel(event.phraseId);
+                break;
+            case HeldEvent::Type::AUTOMATION:
+                scheduleAutomation(event.parameterId, event.value, delaySamples, event.rampSamples);
+                break;
+        }
+        pendingUntil = std::max(pendingUntil, event.due);
+    }
+    heldEvents.clear();
+    return late;
+}
 
+bool HeadlessAudioEngine::isHibernating() const {
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    return hibernating;
+}
+
+void HeadlessAudioEngine::setWakeHandler(std::function<void()> handler) {
+    std::lock_guard<std::mutex> lock(hibernationMutex);
+    wakeHandler = std::move(handler);
+}
+
+void HeadlessAudioEngine::getPluginState(juce::MemoryBlock &state) {
+    state.reset();
+    // VST3 state calls belong on the message thread
+    if (plugin)
+        MessageThread::instance().call([&]() { plugin->getStateInformation(state); });
+}
+
+void HeadlessAudioEngine::restorePluginState(const juce::MemoryBlock &state) {
+    if (plugin && state.getSize() > 0) {
+        MessageThread::instance().call([&]() {
+            plugin->setStateInformation(state.getData(), (int) state.getSize());
+        });
+        idleDetector.setTailSeconds(plugin->getTailLengthSeconds());
+    }
+}
+
+std::optional<Preset> HeadlessAudioEngine::getCurrentPreset() const {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    return currentPreset;
+}
+
+void HeadlessAudioEngine::restorePreset(const Preset &preset) {
+    // the built-in synth has no preset files but approximates each one with a patch of its own
+    if (auto *native = dynamic_cast<NativeSynthInstance *>(plugin.get())) {
+        native->setPatch(NativeSynthPatch::forPreset(preset));
+        idleDetector.setTailSeconds(native->getTailLengthSeconds());
+        // what is already rendered ahead was played with the old patch
+        if (lookAhead != nullptr)
+            lookAhead->patchChanged();
+        std::lock_guard<std::mutex> lock(parameterIdsMutex);
+        parameterOverrides.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(presetMutex);
+        currentPreset = preset;
+    }
+    setMidiRole(preset.type);
+}
+
+std::vector<std::pair<std::string, float>> HeadlessAudioEngine::getParameterOverrides() const {
+    std::lock_guard<std::mutex> lock(parameterIdsMutex);
+    return {parameterOverrides.begin(), parameterOverrides.end()};
+}
@@ -2,13 +2,26 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_devices/juce_audio_devices.h>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "../utils/serum/Presets.h"
 #include "../midi/MidiInputCollector.h"
 #include "utils/AudioRingBuffer.h"
+#include "utils/IdleDetector.h"
+#include "utils/MidiGovernor.h"
+#include "utils/MidiScheduler.h"
+#include "utils/ParameterAutomation.h"
 
 // Forward declare the callback class
 class InternalCallback;
+class LookAheadRenderer;
 
 class HeadlessAudioEngine {
 public:
@@ -24,19 +37,138 @@ public:
 
     void setMidiRole(std::string role);
 
+    void setSessionID(std::string sessionID);
+
+    void setControllerForwardRate(int rateHz);
+
+    void setNoteListener(MidiInputCollector::NoteListener listener);
+
+    // The controller a USER engine plays from: the first connected MIDI input whose name contains
+    // name and that no other engine has claimed, so each session gets a controller of its own.
+    // Claimed on start() (or here, for a running engine) and given up on stop(); returns whether
+    // the engine has an input. Always true for an AI engine, which needs none.
+    bool setMidiInput(juce::String name);
+
+    // Whether a connected MIDI input matching name is still unclaimed.
+    static bool isMidiInputAvailable(const juce::String& name);
+
     void start();
 
     void stop();
 
     void enableAIMidiInjection(bool e);
 
-    void enqueueMidi(const juce::MidiMessage& m, int delaySamples);
+    // Renders an AI engine up to horizonSamples ahead of the device on a worker thread, rolling
+    // back and rendering again when an event lands in what is already rendered (LookAheadRenderer).
+    // Only the built-in synth can be rolled back; returns false and keeps rendering in lock-step
+    // for any other plugin or for the user stream.
+    bool enableLookAhead(int horizonSamples);
+
+    bool isLookingAhead() const { return lookAhead != nullptr; }
+
+    // AI events; phraseId groups the events of one generated phrase so it can be cancelled.
+    // Both must be called from a single thread (the controller's MIDI executor).
+    void enqueueMidi(const juce::MidiMessage& m, int delaySamples, uint64_t phraseId = 0);
+
+    void cancelPhrase(uint64_t phraseId);
+
+    // Limits applied to AI MIDI before it reaches the plugin.
+    void setGovernorConfig(const MidiGovernor::Config& config);
+
+    MidiGovernor::Config getGovernorConfig() const { return midiGovernor.getConfig(); }
+
+    // Moves a plugin parameter, addressed by its id (or name), to a normalized value over rampSamples,
+    // starting delaySamples from now. Returns false if the plugin has no such parameter or the
+    // automation queue is full. Safe from any thread.
+    bool automateParameter(const std::string& parameterId, float value, int delaySamples, int rampSamples);
+
+    // Automation points applied in the last block.
+    int getLastBlockAutomationPoints() const { return parameterAutomation.getLastBlockPoints(); }
+
+    // Snapshot support (see EngineSnapshot): the plugin's state blob, the preset last loaded and
+    // the latest value automated per parameter since then.
+    void getPluginState(juce::MemoryBlock& state);
+    // Before the engine starts: loads a state blob into the plugin.
+    void restorePluginState(const juce::MemoryBlock& state);
+    std::optional<Preset> getCurrentPreset() const;
+    // Takes over a restored preset's identity without loading the preset file again (the
+    // native synth switches to its approximation of the preset).
+    void restorePreset(const Preset& preset);
+    std::vector<std::pair<std::string, float>> getParameterOverrides() const;
 
     std::shared_ptr<AudioRingBuffer> getRingBuffer() const { return ringBuffer; }
 
+    // Runs silent blocks and a few quiet test notes through the plugin so it pages in wavetables and
+    // allocates voices before the first real note; the output is discarded and the plugin reset.
+    // Holds the plugin's callback lock, so a running device renders silence meanwhile.
+    void warmUp(int silentBlocks = 4, int noteBlocks = 8);
+
+    // Hands the plugin back (e.g. to the instance pool); the engine must be stopped. A look-ahead
+    // engine renders ahead again once it is given a plugin.
+    std::unique_ptr<juce::AudioPluginInstance> releasePlugin();
+
+    // Hibernation (see StreamManager::hibernate). beginHibernation() succeeds only for an AI engine
+    // whose plugin has been idle for minIdleSeconds with nothing scheduled still to play; from then
+    // on MIDI, cancels and automation are held with the time they are due, and each held MIDI event
+    // calls the wake handler. endHibernation(), once a plugin is back and the device started, hands
+    // the held events on with what is left of their delay and returns how many note-ons were
+    // already due, i.e. the wake came too late for them.
+    bool beginHibernation(double minIdleSeconds);
+    int endHibernation();
+    bool isHibernating() const;
+    void setWakeHandler(std::function<void()> handler);
+
+    // Smoothed audio-callback time as a proportion of the block duration.
+    double getCpuLoad() const { return loadMeasurer.getLoadAsProportion(); }
+
+    // Whether the plugin has gone quiet and is being skipped (see IdleDetector).
+    bool isIdle() const { return idleDetector.isIdle(); }
+
+    // Tags everything fed to this engine in the session capture (see SessionRecorder).
+    void setCaptureId(int id);
+
+    // Picks the core the engine's render threads are pinned to (see ThreadPolicy); before start().
+    void setThreadSlot(int slot) { threadSlot = slot; }
+
+    int getThreadSlot() const { return threadSlot; }
+
+    // Offline rendering for replay and benchmarks: no audio device is opened and the caller
+    // drives every block; injectedMidi takes the place of the controller input.
+    void prepareOffline();
+
+    void renderOffline(const juce::MidiBuffer& injectedMidi, int numSamples);
+
+    int getBlockSize() const { return blockSize; }
+
+    void printStats() const;
+
     friend class InternalCallback;
+    friend class LookAheadRenderer;
 
 private:
+    // Runs one block through the plugin, with the block's automation points.
+    void processPlugin(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                       const std::vector<ParameterAutomation::Point>& automation);
+
+    struct HeldEvent {
+        enum class Type { MIDI, CANCEL, AUTOMATION } type;
+        juce::MidiMessage message;
+        uint64_t phraseId = 0;
+        std::string parameterId;
+        float value = 0.0f;
+        int rampSamples = 0;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    // The paths taken when not hibernating; hibernationMutex is held.
+    void scheduleMidi(const juce::MidiMessage& m, int delaySamples, uint64_t phraseId);
+    void scheduleCancel(uint64_t phraseId);
+    bool scheduleAutomation(const std::string& parameterId, float value, int delaySamples, int rampSamples);
+    std::chrono::steady_clock::time_point dueIn(int delaySamples) const;
+
+    bool claimMidiInput();
+    void releaseMidiInput();
+
     double sampleRate;
     int blockSize;
 
@@ -46,7 +178,33 @@ private:
     std::unique_ptr<juce::AudioIODeviceCallback> callback;
     std::shared_ptr<AudioRingBuffer> ringBuffer;
 
-    std::mutex pendingMutex;
-    std::vector<std::pair<int, juce::MidiMessage> > pendingMidi;
+    MidiScheduler midiScheduler;
+    MidiGovernor midiGovernor;
+    ParameterAutomation parameterAutomation;
+    IdleDetector idleDetector;
+    // parameter id/name -> number used by parameterAutomation, filled as ids are first used
+    mutable std::mutex parameterIdsMutex;
+    std::unordered_map<std::string, uint32_t> parameterIds;
+    std::map<std::string, float> parameterOverrides;
+    mutable std::mutex presetMutex;
+    std::optional<Preset> currentPreset;
     bool shouldInjectAI = false;
+    // MIDI input identifier -> the USER engine it feeds; an input feeds one engine at most
+    static std::mutex midiInputsMutex;
+    static std::map<juce::String, HeadlessAudioEngine*> midiInputOwners;
+    juce::String midiInputName { "Minilab3 MIDI" };
+    juce::String midiInputId;
+    juce::AudioProcessLoadMeasurer loadMeasurer;
+    int captureId = -1;
+    std::vector<float> offlineScratch;
+    std::unique_ptr<LookAheadRenderer> lookAhead;
+    int lookAheadSamples = 0;
+    int threadSlot = 0;
+    // guards the plugin against hibernation while events are handed to it
+    mutable std::mutex hibernationMutex;
+    bool hibernating = false;
+    std::vector<HeldEvent> heldEvents;
+    std::function<void()> wakeHandler;
+    // when the last event handed on so far is due; the engine doesn't hibernate before
+    std::chrono::steady_clock::time_point pendingUntil;
 };
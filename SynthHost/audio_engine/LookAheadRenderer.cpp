@@ -0,0 +1,248 @@
+#include "LookAheadRenderer.h"
+#include "HeadlessAudioEngine.h"
+#include "../vst_hosting/NativeSynthInstance.h"
+#include "../executor/ThreadPolicy.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+LookAheadRenderer::LookAheadRenderer (HeadlessAudioEngine& engine, NativeSynthInstance& synth, int horizonSamples,
+                                      int renderBlockSize)
+    : engine (engine),
+      synth (synth),
+      horizon (std::max (horizonSamples, renderBlockSize)),
+      renderBlockSize (renderBlockSize),
+      guard (engine.getBlockSize()),
+      blockAudio (2, renderBlockSize),
+      queue (2, horizon + renderBlockSize + guard)
+{
+    blockMidi.ensureSize ((size_t) renderBlockSize * 4);
+    queue.clear();
+}
+
+LookAheadRenderer::~LookAheadRenderer()
+{
+    stop();
+}
+
+void LookAheadRenderer::start()
+{
+    if (running.exchange (true))
+        return;
+    worker = std::thread ([this] { workLoop(); });
+}
+
+void LookAheadRenderer::stop()
+{
+    running.store (false);
+    wake.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+int64_t LookAheadRenderer::eventTime (int delaySamples) const
+{
+    return playhead.load (std::memory_order_acquire) + std::max (delaySamples, LEAD_BLOCKS * guard);
+}
+
+void LookAheadRenderer::enqueueMidi (const juce::MidiMessage& message, int delaySamples, uint64_t phraseId)
+{
+    const auto time = eventTime (delaySamples);
+    if (timeline.addMidi (message, time, phraseId))
+        requestRollback (time);
+}
+
+void LookAheadRenderer::cancelPhrase (uint64_t phraseId)
+{
+    const auto time = eventTime (0);
+    if (timeline.cancelPhrase (phraseId, time))
+        requestRollback (time);
+}
+
+void LookAheadRenderer::automate (uint32_t parameter, float value, float startValue, int delaySamples,
+                                  int rampSamples)
+{
+    const auto time = eventTime (delaySamples);
+    if (timeline.addAutomation (parameter, value, startValue, time, rampSamples))
+        requestRollback (time);
+}
+
+void LookAheadRenderer::patchChanged()
+{
+    rebase.store (true);
+    requestRollback (0);
+}
+
+void LookAheadRenderer::requestRollback (int64_t time)
+{
+    auto pending = rollbackTo.load();
+    while (time < pending && ! rollbackTo.compare_exchange_weak (pending, time)) {}
+    wake.notify_one();
+}
+
+void LookAheadRenderer::release (juce::AudioBuffer<float>& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+    const int length = queue.getNumSamples();
+    const int64_t start = playhead.load (std::memory_order_relaxed);
+    const int ready = (int) std::clamp<int64_t> (renderedEnd.load (std::memory_order_acquire) - start, 0, numSamples);
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        const int source = std::min (ch, queue.getNumChannels() - 1);
+        int copied = 0;
+        while (copied < ready)
+        {
+            const int index = (int) ((start + copied) % length);
+            const int chunk = std::min (ready - copied, length - index);
+            buffer.copyFrom (ch, copied, queue, source, index, chunk);
+            copied += chunk;
+        }
+        if (ready < numSamples)
+            buffer.clear (ch, ready, numSamples - ready);
+    }
+    if (ready < numSamples)
+        underruns_.fetch_add (1, std::memory_order_relaxed);
+
+    playhead.store (start + numSamples, std::memory_order_release);
+}
+
+void LookAheadRenderer::workLoop()
+{
+    // the device releases a block per period; look again twice per render block meanwhile
+    const auto idle = std::chrono::microseconds ((int64_t) (500000.0 * renderBlockSize / engine.sampleRate));
+    ThreadPolicy::instance().applyToCurrentThread (ThreadPolicy::Role::LOOKAHEAD, engine.threadSlot);
+    while (running.load())
+    {
+        auto time = rollbackTo.exchange (NO_ROLLBACK);
+        const bool rebasePatch = rebase.exchange (false);
+        if (rebasePatch)
+            time = 0;
+        if (time != NO_ROLLBACK)
+            rollBack (time, rebasePatch);
+
+        if (renderPosition < playhead.load (std::memory_order_acquire) + horizon)
+        {
+            renderNext();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock (wakeMutex);
+        wake.wait_for (lock, idle, [this] { return ! running.load() || rollbackTo.load() != NO_ROLLBACK; });
+    }
+}
+
+void LookAheadRenderer::renderNext()
+{
+    // keep the latest checkpoint at or before the playhead and every one after it
+    const int64_t released = playhead.load (std::memory_order_acquire);
+    while (checkpoints.size() > 1 && checkpoints[1].position <= released)
+        checkpoints.pop_front();
+    if (! checkpoints.empty())
+        timeline.forget (checkpoints.front().position);
+
+    auto& checkpoint = checkpoints.emplace_back();
+    checkpoint.position = renderPosition;
+    synth.saveRenderState (checkpoint.synth);
+    engine.midiGovernor.saveSnapshot (checkpoint.governor);
+    engine.parameterAutomation.saveSnapshot (checkpoint.automation);
+    engine.idleDetector.saveSnapshot (checkpoint.idle);
+    checkpoint.phrases = phrases;
+
+    const auto started = std::chrono::steady_clock::now();
+    {
+        juce::AudioProcessLoadMeasurer::ScopedTimer loadTimer (engine.loadMeasurer, renderBlockSize);
+
+        blockMidi.clear();
+        blockAutomation.clear();
+        timeline.collect (renderPosition, renderPosition + renderBlockSize, phrases, blockMidi, blockAutomation);
+        for (const auto& point : blockAutomation)
+            engine.parameterAutomation.automate (point.parameter, point.value, point.startValue,
+                                                 point.sampleOffset, point.rampSamples);
+        engine.midiGovernor.process (blockMidi, renderBlockSize);
+        const auto& automation = engine.parameterAutomation.renderNextBlock (renderBlockSize);
+
+        blockAudio.clear();
+        engine.processPlugin (blockAudio, blockMidi, automation);
+    }
+    const auto micros = (int64_t) std::chrono::duration_cast<std::chrono::microseconds> (
+        std::chrono::steady_clock::now() - started).count();
+    renderedBlocks_.fetch_add (1, std::memory_order_relaxed);
+    renderMicros_.fetch_add (micros, std::memory_order_relaxed);
+    if (micros > maxRenderMicros_.load (std::memory_order_relaxed))
+        maxRenderMicros_.store (micros, std::memory_order_relaxed);
+
+    // after a rollback, the samples before writeFrom are still in the queue and may be playing
+    const int length = queue.getNumSamples();
+    int offset = (int) std::clamp<int64_t> (writeFrom - renderPosition, 0, renderBlockSize);
+    while (offset < renderBlockSize)
+    {
+        const int index = (int) ((renderPosition + offset) % length);
+        const int chunk = std::min (renderBlockSize - offset, length - index);
+        for (int ch = 0; ch < queue.getNumChannels(); ++ch)
+            queue.copyFrom (ch, index, blockAudio, ch, offset, chunk);
+        offset += chunk;
+    }
+
+    renderPosition += renderBlockSize;
+    if (renderPosition > renderedEnd.load (std::memory_order_relaxed))
+        renderedEnd.store (renderPosition, std::memory_order_release);
+}
+
+void LookAheadRenderer::rollBack (int64_t time, bool rebasePatch)
+{
+    // a new patch applies to the stretch rendered again too
+    if (rebasePatch)
+        for (auto& checkpoint : checkpoints)
+            checkpoint.synth.patch = synth.getPatch();
+
+    // Nothing at or past renderedEnd has been released, so it is free to rewrite; it is below
+    // renderPosition while an earlier rollback is still being rendered again.
+    const int64_t rendered = renderedEnd.load (std::memory_order_relaxed);
+    int64_t from = std::min (std::max (time, playhead.load (std::memory_order_acquire) + guard), rendered);
+    if (from >= rendered)
+        return;
+
+    // hold the device back from what is about to be rewritten; a callback that read renderedEnd
+    // before this may still copy up to guard samples past its playhead, so stay clear of that
+    renderedEnd.store (from, std::memory_order_release);
+    from = std::max (from, std::min (playhead.load (std::memory_order_acquire) + guard, rendered));
+    rollbacks_.fetch_add (1, std::memory_order_relaxed);
+    rerenderedSamples_.fetch_add (rendered - from, std::memory_order_relaxed);
+    if (from >= renderPosition)
+    {
+        // the rollback being rendered hasn't got there yet; it only has to write from earlier on
+        writeFrom = from;
+        return;
+    }
+
+    while (checkpoints.size() > 1 && checkpoints.back().position > from)
+        checkpoints.pop_back();
+    const auto& checkpoint = checkpoints.back();
+    {
+        const juce::ScopedLock pluginLock (synth.getCallbackLock());
+        synth.restoreRenderState (checkpoint.synth);
+    }
+    engine.midiGovernor.restoreSnapshot (checkpoint.governor);
+    engine.parameterAutomation.restoreSnapshot (checkpoint.automation);
+    engine.idleDetector.restoreSnapshot (checkpoint.idle);
+    phrases = checkpoint.phrases;
+
+    renderPosition = checkpoint.position;
+    writeFrom = from;
+    // renderNext() takes it again
+    checkpoints.pop_back();
+}
+
+void LookAheadRenderer::printStats() const
+{
+    const auto blocks = renderedBlocks_.load();
+    std::cout << "[lookahead] horizon " << horizon << " samples in " << renderBlockSize << "-sample blocks"
+              << " | ahead " << std::max<int64_t> (0, renderedEnd.load() - playhead.load())
+              << " | rendered " << blocks << " blocks, avg "
+              << (blocks > 0 ? renderMicros_.load() / blocks : 0) << " us, max " << maxRenderMicros_.load() << " us"
+              << " | rollbacks " << rollbacks_.load() << " (" << rerenderedSamples_.load() << " samples again)"
+              << " | underruns " << underruns_.load()
+              << " | timeline " << timeline.size() << " events"
+              << std::endl;
+}
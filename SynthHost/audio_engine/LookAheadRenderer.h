@@ -0,0 +1,118 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "synth/NativeSynth.h"
+#include "utils/IdleDetector.h"
+#include "utils/LookAheadTimeline.h"
+#include "utils/MidiGovernor.h"
+#include "utils/ParameterAutomation.h"
+
+class HeadlessAudioEngine;
+class NativeSynthInstance;
+
+// Look-ahead rendering for an AI engine. AI streams have no live input: their MIDI arrives from
+// the composer ahead of its play time. So instead of rendering in lock-step with the device
+// callback, a worker thread renders up to horizonSamples ahead of the playhead, in blocks of
+// renderBlockSize, into a queue the device callback only copies from (release()).
+//
+// Before each block the worker checkpoints everything the rest depends on: the synth's voice bank
+// (NativeSynth::Snapshot), the MIDI governor, the parameter automation, the idle detector and the
+// phrases' sounding notes. When an event or a cancel lands inside the stretch already rendered, it restores the
+// last checkpoint before it and renders from there again, overwriting the queue from the event on.
+//
+// The device may be copying up to a block past the playhead at any moment, so nothing closer is
+// ever rewritten; events are placed at least LEAD_BLOCKS blocks past the playhead, which leaves
+// the worker a block to roll back before the device gets there.
+//
+// Only the built-in synth can be checkpointed mid-note, so only engines hosting a
+// NativeSynthInstance render ahead (HeadlessAudioEngine::enableLookAhead).
+class LookAheadRenderer
+{
+public:
+    LookAheadRenderer (HeadlessAudioEngine& engine, NativeSynthInstance& synth, int horizonSamples,
+                       int renderBlockSize);
+
+    ~LookAheadRenderer();
+
+    void start();
+
+    void stop();
+
+    // Producer side (the controller's MIDI executor); delays count from the playhead.
+    void enqueueMidi (const juce::MidiMessage& message, int delaySamples, uint64_t phraseId);
+    void cancelPhrase (uint64_t phraseId);
+    void automate (uint32_t parameter, float value, float startValue, int delaySamples, int rampSamples);
+
+    // The synth's patch was replaced (preset change): renders what hasn't been released yet again,
+    // with the new patch.
+    void patchChanged();
+
+    // Audio thread: the next block of rendered audio; silence where the worker fell behind.
+    void release (juce::AudioBuffer<float>& buffer);
+
+    void printStats() const;
+
+private:
+    struct Checkpoint
+    {
+        int64_t position = 0;
+        NativeSynth::Snapshot synth;
+        MidiGovernor::Snapshot governor;
+        ParameterAutomation::Snapshot automation;
+        IdleDetector::Snapshot idle;
+        LookAheadTimeline::Phrases phrases;
+    };
+
+    static constexpr int LEAD_BLOCKS = 2;
+    static constexpr int64_t NO_ROLLBACK = INT64_MAX;
+
+    void workLoop();
+    void renderNext();
+    void rollBack (int64_t time, bool rebasePatch);
+    void requestRollback (int64_t time);
+    int64_t eventTime (int delaySamples) const;
+
+    HeadlessAudioEngine& engine;
+    NativeSynthInstance& synth;
+    const int horizon;
+    const int renderBlockSize;
+    // one engine block, the most a device callback copies
+    const int guard;
+
+    LookAheadTimeline timeline;
+    LookAheadTimeline::Phrases phrases;
+    std::deque<Checkpoint> checkpoints;
+    std::vector<LookAheadTimeline::Automation> blockAutomation;
+    juce::MidiBuffer blockMidi;
+    juce::AudioBuffer<float> blockAudio;
+
+    // rendered audio, indexed by absolute sample position modulo its length
+    juce::AudioBuffer<float> queue;
+    // samples released to the device / rendered and ready / where the worker renders next
+    std::atomic<int64_t> playhead { 0 };
+    std::atomic<int64_t> renderedEnd { 0 };
+    int64_t renderPosition = 0;
+    // after a rollback the worker renders again from a checkpoint but writes only from here on
+    int64_t writeFrom = 0;
+
+    std::atomic<int64_t> rollbackTo { NO_ROLLBACK };
+    std::atomic<bool> rebase { false };
+    std::atomic<bool> running { false };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread worker;
+
+    std::atomic<int64_t> renderedBlocks_ { 0 };
+    std::atomic<int64_t> renderMicros_ { 0 };
+    std::atomic<int64_t> maxRenderMicros_ { 0 };
+    std::atomic<int64_t> rollbacks_ { 0 };
+    std::atomic<int64_t> rerenderedSamples_ { 0 };
+    std::atomic<int64_t> underruns_ { 0 };
+};
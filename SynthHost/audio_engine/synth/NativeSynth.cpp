@@ -0,0 +1,418 @@
+#include "NativeSynth.h"
+
+#include <algorithm>
+#include <cmath>
+#include <juce_dsp/juce_dsp.h>
+
+namespace
+{
+    using Waveform = NativeSynthPatch::Waveform;
+
+    enum Stage : int { IDLE, ATTACK, DECAY, SUSTAIN, RELEASE };
+
+    struct Envelope
+    {
+        float attack, decay, sustain, release;
+    };
+
+    // exponential segments get within 1% of their target after their time
+    float decayFactor (float seconds, float numSamples, float sampleRate)
+    {
+        return std::exp (-4.6f * numSamples / std::max (1.0f, seconds * sampleRate));
+    }
+
+    // Level after numSamples more samples; moves stage on where a segment ends inside them.
+    float advanceEnvelope (int& stage, float level, const Envelope& envelope, float numSamples, float sampleRate)
+    {
+        switch (stage)
+        {
+            case ATTACK:
+                level += numSamples / std::max (1.0f, envelope.attack * sampleRate);
+                if (level >= 1.0f)
+                {
+                    level = 1.0f;
+                    stage = DECAY;
+                }
+                return level;
+            case DECAY:
+                level = envelope.sustain + (level - envelope.sustain) * decayFactor (envelope.decay, numSamples, sampleRate);
+                if (level - envelope.sustain < 1.0e-3f)
+                {
+                    level = envelope.sustain;
+                    // nothing left to hear until the note-off; free the voice now
+                    stage = envelope.sustain > 0.0f ? SUSTAIN : IDLE;
+                }
+                return level;
+            case SUSTAIN:
+                return envelope.sustain;
+            case RELEASE:
+                level *= decayFactor (envelope.release, numSamples, sampleRate);
+                if (level < 1.0e-4f)
+                {
+                    level = 0.0f;
+                    stage = IDLE;
+                }
+                return level;
+            default:
+                return 0.0f;
+        }
+    }
+
+    // 2-sample polynomial band-limited step. Both halves are always computed and then selected
+    // (they can't overlap while the increment stays below 0.5), so the lane loop stays branch-free.
+    inline float polyBlep (float t, float dt, float inverseDt)
+    {
+        const float before = t * inverseDt;
+        const float after = (t - 1.0f) * inverseDt;
+        const float rising = before + before - before * before - 1.0f;
+        const float falling = after * after + after + after + 1.0f;
+        return (t < dt ? rising : 0.0f) + (t > 1.0f - dt ? falling : 0.0f);
+    }
+
+    template <Waveform W>
+    inline float oscillator (float phase, float increment, float inverseIncrement)
+    {
+        if constexpr (W == Waveform::SAW)
+        {
+            return 2.0f * phase - 1.0f - polyBlep (phase, increment, inverseIncrement);
+        }
+        else if constexpr (W == Waveform::SQUARE)
+        {
+            float half = phase + 0.5f;
+            half -= half >= 1.0f ? 1.0f : 0.0f;
+            return (phase < 0.5f ? 1.0f : -1.0f) + polyBlep (phase, increment, inverseIncrement)
+                   - polyBlep (half, increment, inverseIncrement);
+        }
+        else
+        {
+            return -juce::dsp::FastMathApproximations::sin (juce::MathConstants<float>::twoPi * phase
+                                                            - juce::MathConstants<float>::pi);
+        }
+    }
+}
+
+//==============================================================================
+struct NativeSynth::Sound : public juce::SynthesiserSound
+{
+    bool appliesToNote (int) override { return true; }
+    bool appliesToChannel (int) override { return true; }
+};
+
+// Only routes note on/off into its lane of the voice bank; the bank renders all lanes at once.
+class NativeSynth::Voice : public juce::SynthesiserVoice
+{
+public:
+    Voice (NativeSynth& owner, int lane) : owner (owner), lane (lane) {}
+
+    bool canPlaySound (juce::SynthesiserSound*) override { return true; }
+
+    void startNote (int midiNote, float velocity, juce::SynthesiserSound*, int pitchWheel) override
+    {
+        owner.startVoice (lane, midiNote, velocity, pitchWheel);
+    }
+
+    void stopNote (float, bool allowTailOff) override
+    {
+        if (allowTailOff)
+        {
+            owner.releaseVoice (lane);
+        }
+        else
+        {
+            owner.killVoice (lane);
+            clearCurrentNote();
+        }
+    }
+
+    void pitchWheelMoved (int value) override { owner.bendVoice (lane, value); }
+    void controllerMoved (int, int) override {}
+    void renderNextBlock (juce::AudioBuffer<float>&, int, int) override {}
+
+    void finish() { clearCurrentNote(); }
+
+private:
+    NativeSynth& owner;
+    const int lane;
+};
+
+//==============================================================================
+NativeSynth::NativeSynth()
+{
+    for (int lane = 0; lane < MAX_VOICES; ++lane)
+        laneVoices[(size_t) lane] = static_cast<Voice*> (addVoice (new Voice (*this, lane)));
+    addSound (new Sound());
+    // idle lanes keep running; give them a sane pitch
+    increment1.fill (0.01f);
+    increment2.fill (0.01f);
+    inverseIncrement1.fill (100.0f);
+    inverseIncrement2.fill (100.0f);
+    // sub-blocks this short keep note starts within a few samples of their MIDI time
+    setMinimumRenderingSubdivisionSize (8, false);
+}
+
+void NativeSynth::setPatch (const NativeSynthPatch& newPatch)
+{
+    const juce::ScopedLock sl (lock);
+    patch = newPatch;
+    controlCountdown = 0;
+}
+
+void NativeSynth::setCurrentPlaybackSampleRate (double newRate)
+{
+    juce::Synthesiser::setCurrentPlaybackSampleRate (newRate);
+    const juce::ScopedLock sl (lock);
+    sampleRate = newRate;
+    controlCountdown = 0;
+}
+
+int NativeSynth::getActiveVoiceCount() const
+{
+    return (int) std::count_if (ampStage.begin(), ampStage.end(), [] (int stage) { return stage != IDLE; });
+}
+
+const std::array<NativeSynth::FloatLane, NativeSynth::NUM_FLOAT_LANES>& NativeSynth::floatLaneMembers()
+{
+    static const std::array<FloatLane, NUM_FLOAT_LANES> members = {
+        &NativeSynth::phase1, &NativeSynth::phase2, &NativeSynth::increment1, &NativeSynth::increment2,
+        &NativeSynth::inverseIncrement1, &NativeSynth::inverseIncrement2, &NativeSynth::ampLevel,
+        &NativeSynth::ampStep, &NativeSynth::ic1, &NativeSynth::ic2, &NativeSynth::a1, &NativeSynth::a2,
+        &NativeSynth::a3, &NativeSynth::gainLeft, &NativeSynth::gainRight, &NativeSynth::filterLevel,
+        &NativeSynth::note, &NativeSynth::bend, &NativeSynth::velocity,
+    };
+    return members;
+}
+
+void NativeSynth::saveSnapshot (Snapshot& snapshot) const
+{
+    const juce::ScopedLock sl (lock);
+    snapshot.patch = patch;
+    for (size_t k = 0; k < floatLaneMembers().size(); ++k)
+        snapshot.floatLanes[k] = this->*floatLaneMembers()[k];
+    snapshot.intLanes = { ampStage, filterStage };
+    snapshot.controlCountdown = controlCountdown;
+
+    snapshot.numHeld = 0;
+    for (size_t i = 0; i < (size_t) MAX_VOICES; ++i)
+    {
+        const auto* voice = laneVoices[i];
+        if (voice->getCurrentlyPlayingNote() < 0)
+            continue;
+        int channel = 1;
+        while (channel < 16 && ! voice->isPlayingChannel (channel))
+            ++channel;
+        snapshot.held[(size_t) snapshot.numHeld++] = { (int) i, channel, voice->getCurrentlyPlayingNote(),
+                                                       voice->isKeyDown(), voice->isSustainPedalDown() };
+    }
+    std::sort (snapshot.held.begin(), snapshot.held.begin() + snapshot.numHeld,
+               [this] (const Snapshot::Held& a, const Snapshot::Held& b)
+               { return laneVoices[(size_t) a.lane]->wasStartedBefore (*laneVoices[(size_t) b.lane]); });
+}
+
+void NativeSynth::restoreSnapshot (const Snapshot& snapshot)
+{
+    const juce::ScopedLock sl (lock);
+    for (auto* voice : laneVoices)
+        voice->finish();
+
+    patch = snapshot.patch;
+    for (size_t k = 0; k < floatLaneMembers().size(); ++k)
+        this->*floatLaneMembers()[k] = snapshot.floatLanes[k];
+    ampStage = snapshot.intLanes[0];
+    filterStage = snapshot.intLanes[1];
+    controlCountdown = snapshot.controlCountdown;
+
+    // hand the notes back to the Synthesiser in their original order; the voices' startNote()
+    // leaves the restored lanes alone
+    restoringVoices = true;
+    for (int h = 0; h < snapshot.numHeld; ++h)
+    {
+        const auto& held = snapshot.held[(size_t) h];
+        auto* voice = laneVoices[(size_t) held.lane];
+        juce::Synthesiser::startVoice (voice, getSound (0).get(), held.channel, held.note,
+                                       velocity[(size_t) held.lane]);
+        voice->setKeyDown (held.keyDown);
+        voice->setSustainPedalDown (held.sustained);
+    }
+    restoringVoices = false;
+}
+
+void NativeSynth::startVoice (int lane, int midiNote, float noteVelocity, int pitchWheel)
+{
+    // restoreSnapshot() only rebuilds the Synthesiser's bookkeeping; the lane is already restored
+    if (restoringVoices)
+        return;
+
+    const auto i = (size_t) lane;
+    if (ampStage[i] == IDLE)
+    {
+        ic1[i] = ic2[i] = 0.0f;
+        ampLevel[i] = 0.0f;
+    }
+    phase1[i] = 0.0f;
+    phase2[i] = 0.25f;
+    note[i] = (float) midiNote;
+    velocity[i] = noteVelocity;
+    ampStage[i] = ATTACK;
+    filterStage[i] = ATTACK;
+    filterLevel[i] = 0.0f;
+    bendVoice (lane, pitchWheel);
+    controlCountdown = 0;
+}
+
+void NativeSynth::releaseVoice (int lane)
+{
+    const auto i = (size_t) lane;
+    if (ampStage[i] != IDLE)
+        ampStage[i] = RELEASE;
+    if (filterStage[i] != IDLE)
+        filterStage[i] = RELEASE;
+    controlCountdown = 0;
+}
+
+void NativeSynth::killVoice (int lane)
+{
+    const auto i = (size_t) lane;
+    ampStage[i] = filterStage[i] = IDLE;
+    ampLevel[i] = ampStep[i] = 0.0f;
+}
+
+void NativeSynth::bendVoice (int lane, int pitchWheel)
+{
+    bend[(size_t) lane] = 2.0f * (float) (pitchWheel - 8192) / 8192.0f;
+    controlCountdown = 0;
+}
+
+void NativeSynth::updateControl()
+{
+    const auto rate = (float) sampleRate;
+    const auto blockLength = (float) CONTROL_BLOCK;
+    const Envelope ampEnvelope { patch.ampAttack, patch.ampDecay, patch.ampSustain, patch.ampRelease };
+    const Envelope filterEnvelope { patch.filterAttack, patch.filterDecay, patch.filterSustain, patch.filterRelease };
+    const float osc2Ratio = std::exp2 ((patch.osc2Semitones + patch.detuneCents / 100.0f) / 12.0f);
+    const float k = 2.0f - 1.95f * juce::jlimit (0.0f, 1.0f, patch.resonance);
+    const float spread = 0.3f * juce::jmin (1.0f, patch.detuneCents / 20.0f);
+
+    for (size_t i = 0; i < (size_t) MAX_VOICES; ++i)
+    {
+        if (ampStage[i] == IDLE)
+        {
+            ampLevel[i] = ampStep[i] = 0.0f;
+            continue;
+        }
+
+        const float target = advanceEnvelope (ampStage[i], ampLevel[i], ampEnvelope, blockLength, rate);
+        ampStep[i] = (target - ampLevel[i]) / blockLength;
+        filterLevel[i] = advanceEnvelope (filterStage[i], filterLevel[i], filterEnvelope, blockLength, rate);
+
+        const float frequency = 440.0f * std::exp2 ((note[i] + bend[i] - 69.0f) / 12.0f);
+        increment1[i] = juce::jlimit (1.0e-4f, 0.45f, frequency / rate);
+        increment2[i] = juce::jlimit (1.0e-4f, 0.45f, frequency * osc2Ratio / rate);
+        inverseIncrement1[i] = 1.0f / increment1[i];
+        inverseIncrement2[i] = 1.0f / increment2[i];
+
+        // TPT state-variable filter (Zavalishin), low-pass output
+        const float octaves = patch.filterEnvOctaves * filterLevel[i] + patch.keyTrack * (note[i] - 60.0f) / 12.0f;
+        const float cutoff = juce::jlimit (20.0f, 0.45f * rate, patch.cutoff * std::exp2 (octaves));
+        const float g = std::tan (juce::MathConstants<float>::pi * cutoff / rate);
+        a1[i] = 1.0f / (1.0f + g * (g + k));
+        a2[i] = g * a1[i];
+        a3[i] = g * a2[i];
+
+        // equal-power pan, alternating sides so detuned voices widen the image
+        const float pan = (i % 2 == 0 ? -spread : spread);
+        const float angle = juce::MathConstants<float>::pi * 0.25f * (1.0f + pan);
+        const float level = patch.gain * velocity[i];
+        gainLeft[i] = level * std::cos (angle);
+        gainRight[i] = level * std::sin (angle);
+    }
+}
+
+void NativeSynth::finishIdleVoices()
+{
+    for (size_t i = 0; i < (size_t) MAX_VOICES; ++i)
+        if (ampStage[i] == IDLE && laneVoices[i]->getCurrentlyPlayingNote() >= 0)
+            laneVoices[i]->finish();
+}
+
+template <Waveform W1, Waveform W2>
+void NativeSynth::renderLanes (float* left, float* right, int numSamples)
+{
+    const float osc2Level = patch.osc2Level;
+    alignas (32) Lanes<float> out;
+    for (int s = 0; s < numSamples; ++s)
+    {
+        // one sample of every lane; no cross-lane dependency, so this is the loop that vectorises
+        for (int v = 0; v < MAX_VOICES; ++v)
+        {
+            const float p1 = phase1[v], p2 = phase2[v];
+            const float x = oscillator<W1> (p1, increment1[v], inverseIncrement1[v])
+                          + osc2Level * oscillator<W2> (p2, increment2[v], inverseIncrement2[v]);
+            const float n1 = p1 + increment1[v];
+            const float n2 = p2 + increment2[v];
+            phase1[v] = n1 - (n1 >= 1.0f ? 1.0f : 0.0f);
+            phase2[v] = n2 - (n2 >= 1.0f ? 1.0f : 0.0f);
+
+            const float v3 = x - ic2[v];
+            const float v1 = a1[v] * ic1[v] + a2[v] * v3;
+            const float v2 = ic2[v] + a2[v] * ic1[v] + a3[v] * v3;
+            ic1[v] = 2.0f * v1 - ic1[v];
+            ic2[v] = 2.0f * v2 - ic2[v];
+
+            const float amp = ampLevel[v] + ampStep[v];
+            ampLevel[v] = amp;
+            out[v] = v2 * amp;
+        }
+        float sumLeft = 0.0f, sumRight = 0.0f;
+        for (int v = 0; v < MAX_VOICES; ++v)
+        {
+            sumLeft += out[v] * gainLeft[v];
+            sumRight += out[v] * gainRight[v];
+        }
+        left[s] += sumLeft;
+        right[s] += sumRight;
+    }
+}
+
+NativeSynth::LaneRenderer NativeSynth::rendererFor (Waveform osc1, Waveform osc2)
+{
+    static const LaneRenderer renderers[3][3] = {
+        { &NativeSynth::renderLanes<Waveform::SAW, Waveform::SAW>,
+          &NativeSynth::renderLanes<Waveform::SAW, Waveform::SQUARE>,
+          &NativeSynth::renderLanes<Waveform::SAW, Waveform::SINE> },
+        { &NativeSynth::renderLanes<Waveform::SQUARE, Waveform::SAW>,
+          &NativeSynth::renderLanes<Waveform::SQUARE, Waveform::SQUARE>,
+          &NativeSynth::renderLanes<Waveform::SQUARE, Waveform::SINE> },
+        { &NativeSynth::renderLanes<Waveform::SINE, Waveform::SAW>,
+          &NativeSynth::renderLanes<Waveform::SINE, Waveform::SQUARE>,
+          &NativeSynth::renderLanes<Waveform::SINE, Waveform::SINE> },
+    };
+    return renderers[(int) osc1][(int) osc2];
+}
+
+void NativeSynth::renderVoices (juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+{
+    if (getActiveVoiceCount() == 0 || outputAudio.getNumChannels() == 0)
+        return;
+
+    juce::ScopedNoDenormals noDenormals;
+    float* left = outputAudio.getWritePointer (0, startSample);
+    float* right = outputAudio.getNumChannels() > 1 ? outputAudio.getWritePointer (1, startSample) : left;
+    const auto render = rendererFor (patch.osc1, patch.osc2);
+
+    while (numSamples > 0)
+    {
+        if (controlCountdown == 0)
+        {
+            updateControl();
+            controlCountdown = CONTROL_BLOCK;
+        }
+        const int chunk = juce::jmin (numSamples, controlCountdown);
+        (this->*render) (left, right, chunk);
+        left += chunk;
+        right += chunk;
+        numSamples -= chunk;
+        controlCountdown -= chunk;
+        if (controlCountdown == 0)
+            finishIdleVoices();
+    }
+}
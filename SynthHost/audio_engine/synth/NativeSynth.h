@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "NativeSynthPatch.h"
+
+// Subtractive synth built for many cheap AI streams per core. juce::Synthesiser does the MIDI
+// handling, voice allocation and stealing; the voices themselves only forward note on/off into a
+// voice bank that keeps every per-voice value (oscillator phases, envelope levels, filter state
+// and coefficients) in structure-of-arrays form. renderVoices() then renders all MAX_VOICES lanes
+// together, sample by sample across the arrays, so the inner loop is branch-free and vectorises.
+//
+// Per-voice work that can't vectorise (envelope stage changes, filter coefficients) runs at
+// control rate, every CONTROL_BLOCK samples; envelopes ramp linearly in between.
+class NativeSynth : public juce::Synthesiser
+{
+public:
+    static constexpr int MAX_VOICES = 16;
+    static constexpr int CONTROL_BLOCK = 16;
+
+    NativeSynth();
+
+    // Takes effect from the next control block, for the notes already sounding too.
+    void setPatch (const NativeSynthPatch& patch);
+    const NativeSynthPatch& getPatch() const { return patch; }
+    // For parameter automation, with getLock() held; changes are picked up like setPatch()'s.
+    NativeSynthPatch& getPatchForEditing() { return patch; }
+    // The Synthesiser's lock, which rendering, setPatch() and the snapshots hold.
+    const juce::CriticalSection& getLock() const noexcept { return lock; }
+
+    void setCurrentPlaybackSampleRate (double sampleRate) override;
+
+    // Voices still sounding, release tails included.
+    int getActiveVoiceCount() const;
+
+    // Everything the next sample depends on: the patch, the whole voice bank and which note each
+    // voice is playing, so rendering can be rolled back to this point and repeated (look-ahead
+    // rendering). Pitch wheel and pedal positions are not included.
+    struct Snapshot;
+    void saveSnapshot (Snapshot& snapshot) const;
+    void restoreSnapshot (const Snapshot& snapshot);
+
+protected:
+    using juce::Synthesiser::renderVoices;
+    void renderVoices (juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override;
+
+private:
+    class Voice;
+    struct Sound;
+
+    void startVoice (int lane, int midiNote, float velocity, int pitchWheel);
+    void releaseVoice (int lane);
+    void killVoice (int lane);
+    void bendVoice (int lane, int pitchWheel);
+    void updateControl();
+    void finishIdleVoices();
+    template <NativeSynthPatch::Waveform W1, NativeSynthPatch::Waveform W2>
+    void renderLanes (float* left, float* right, int numSamples);
+
+    using LaneRenderer = void (NativeSynth::*) (float*, float*, int);
+    static LaneRenderer rendererFor (NativeSynthPatch::Waveform osc1, NativeSynthPatch::Waveform osc2);
+
+    template <typename T>
+    using Lanes = std::array<T, MAX_VOICES>;
+
+    // the float lanes below, for snapshots
+    static constexpr int NUM_FLOAT_LANES = 19;
+    static constexpr int NUM_INT_LANES = 2;
+    using FloatLane = Lanes<float> NativeSynth::*;
+    static const std::array<FloatLane, NUM_FLOAT_LANES>& floatLaneMembers();
+
+    NativeSynthPatch patch;
+    double sampleRate = 48000.0;
+    std::array<Voice*, MAX_VOICES> laneVoices {};
+
+    // hot, per sample
+    alignas (32) Lanes<float> phase1 {}, phase2 {}, increment1 {}, increment2 {};
+    alignas (32) Lanes<float> inverseIncrement1 {}, inverseIncrement2 {};
+    alignas (32) Lanes<float> ampLevel {}, ampStep {};
+    alignas (32) Lanes<float> ic1 {}, ic2 {}, a1 {}, a2 {}, a3 {};
+    alignas (32) Lanes<float> gainLeft {}, gainRight {};
+    // control rate
+    Lanes<int> ampStage {}, filterStage {};
+    Lanes<float> filterLevel {}, note {}, bend {}, velocity {};
+    int controlCountdown = 0;
+    bool restoringVoices = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NativeSynth)
+};
+
+struct NativeSynth::Snapshot
+{
+    // a voice juce::Synthesiser has assigned a note to
+    struct Held
+    {
+        int lane;
+        int channel;
+        int note;
+        bool keyDown;
+        bool sustained;
+    };
+
+    NativeSynthPatch patch;
+    std::array<Lanes<float>, NUM_FLOAT_LANES> floatLanes {};
+    std::array<Lanes<int>, NUM_INT_LANES> intLanes {};
+    int controlCountdown = 0;
+    // oldest note first, so voice stealing picks the same victims after a restore
+    std::array<Held, MAX_VOICES> held {};
+    int numHeld = 0;
+};
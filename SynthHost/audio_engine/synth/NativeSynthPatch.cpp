@@ -0,0 +1,123 @@
+#include "NativeSynthPatch.h"
+
+#include <juce_core/juce_core.h>
+
+namespace
+{
+    using Waveform = NativeSynthPatch::Waveform;
+
+    NativeSynthPatch basePatch (const std::string& type)
+    {
+        NativeSynthPatch patch;
+        if (type == "bass")
+        {
+            patch.osc1 = Waveform::SAW;
+            patch.osc2 = Waveform::SQUARE;
+            patch.osc2Semitones = -12.0f;
+            patch.detuneCents = 4.0f;
+            patch.osc2Level = 0.6f;
+            patch.cutoff = 350.0f;
+            patch.resonance = 0.25f;
+            patch.filterEnvOctaves = 2.5f;
+            patch.keyTrack = 0.3f;
+            patch.ampAttack = 0.002f; patch.ampDecay = 0.2f; patch.ampSustain = 0.9f; patch.ampRelease = 0.08f;
+            patch.filterAttack = 0.001f; patch.filterDecay = 0.25f; patch.filterSustain = 0.2f; patch.filterRelease = 0.1f;
+            patch.gain = 0.25f;
+        }
+        else if (type == "lead")
+        {
+            patch.osc1 = Waveform::SAW;
+            patch.osc2 = Waveform::SAW;
+            patch.detuneCents = 9.0f;
+            patch.osc2Level = 0.7f;
+            patch.cutoff = 1800.0f;
+            patch.resonance = 0.3f;
+            patch.filterEnvOctaves = 1.5f;
+            patch.keyTrack = 0.6f;
+            patch.ampAttack = 0.005f; patch.ampDecay = 0.3f; patch.ampSustain = 0.85f; patch.ampRelease = 0.15f;
+            patch.filterAttack = 0.01f; patch.filterDecay = 0.5f; patch.filterSustain = 0.4f; patch.filterRelease = 0.2f;
+            patch.gain = 0.25f;
+        }
+        else if (type == "pad")
+        {
+            patch.osc1 = Waveform::SAW;
+            patch.osc2 = Waveform::SAW;
+            patch.osc2Semitones = 12.0f;
+            patch.detuneCents = 14.0f;
+            patch.osc2Level = 0.4f;
+            patch.cutoff = 1200.0f;
+            patch.resonance = 0.1f;
+            patch.filterEnvOctaves = 1.0f;
+            patch.keyTrack = 0.4f;
+            patch.ampAttack = 0.6f; patch.ampDecay = 1.0f; patch.ampSustain = 0.8f; patch.ampRelease = 1.2f;
+            patch.filterAttack = 1.2f; patch.filterDecay = 2.0f; patch.filterSustain = 0.6f; patch.filterRelease = 1.5f;
+            patch.gain = 0.15f;
+        }
+        else if (type == "pluck")
+        {
+            patch.osc1 = Waveform::SQUARE;
+            patch.osc2 = Waveform::SAW;
+            patch.osc2Semitones = 12.0f;
+            patch.detuneCents = 5.0f;
+            patch.osc2Level = 0.3f;
+            patch.cutoff = 600.0f;
+            patch.resonance = 0.35f;
+            patch.filterEnvOctaves = 4.0f;
+            patch.keyTrack = 0.7f;
+            patch.ampAttack = 0.001f; patch.ampDecay = 0.35f; patch.ampSustain = 0.0f; patch.ampRelease = 0.25f;
+            patch.filterAttack = 0.001f; patch.filterDecay = 0.18f; patch.filterSustain = 0.0f; patch.filterRelease = 0.2f;
+            patch.gain = 0.2f;
+        }
+        return patch;
+    }
+}
+
+NativeSynthPatch NativeSynthPatch::forPreset (const Preset& preset)
+{
+    auto patch = basePatch (preset.type);
+    patch.name = preset.name;
+    auto name = juce::String (preset.name).toLowerCase();
+
+    if (name.contains ("reese"))
+    {
+        // two detuned saws, slowly beating
+        patch.osc2 = Waveform::SAW;
+        patch.osc2Semitones = 0.0f;
+        patch.detuneCents = 22.0f;
+        patch.osc2Level = 1.0f;
+        patch.cutoff = 500.0f;
+    }
+    if (name.contains ("sub"))
+    {
+        patch.osc1 = Waveform::SINE;
+        patch.osc2 = Waveform::SINE;
+        patch.osc2Level = 0.2f;
+        patch.cutoff = 250.0f;
+        patch.filterEnvOctaves = 0.5f;
+    }
+    if (name.contains ("brass"))
+    {
+        patch.filterAttack = 0.06f;
+        patch.filterEnvOctaves = 2.5f;
+        patch.filterSustain = 0.5f;
+    }
+    if (name.contains ("mini") || name.contains ("retro") || name.contains ("bit") || name.contains ("1984"))
+    {
+        patch.osc1 = Waveform::SQUARE;
+        patch.detuneCents = 3.0f;
+    }
+    if (name.contains ("saw") || name.contains ("legato"))
+    {
+        patch.osc1 = Waveform::SAW;
+        patch.osc2 = Waveform::SAW;
+        patch.detuneCents = 12.0f;
+    }
+    if (name.contains ("bless") || name.contains ("lala") || name.contains ("visions"))
+    {
+        // softer, airier pads
+        patch.osc2 = Waveform::SINE;
+        patch.osc2Semitones = 12.0f;
+        patch.resonance = 0.05f;
+    }
+    return patch;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+#include "../../utils/serum/Presets.h"
+
+// Sound of the native synth: two band-limited oscillators into a state-variable low-pass, an amp
+// and a filter envelope. Times are in seconds, levels 0..1, the cutoff in Hz.
+struct NativeSynthPatch
+{
+    enum class Waveform { SAW, SQUARE, SINE };
+
+    std::string name = "Init";
+    Waveform osc1 = Waveform::SAW;
+    Waveform osc2 = Waveform::SAW;
+    float osc2Semitones = 0.0f;
+    float detuneCents = 7.0f;     // osc2 against osc1, and the stereo spread between voices
+    float osc2Level = 0.5f;
+    float cutoff = 2000.0f;
+    float resonance = 0.2f;       // 0 (k = 2) .. 1 (self-oscillation)
+    float filterEnvOctaves = 2.0f;
+    float keyTrack = 0.5f;        // cutoff follows the note by this many octaves per octave
+    float ampAttack = 0.005f, ampDecay = 0.3f, ampSustain = 0.8f, ampRelease = 0.2f;
+    float filterAttack = 0.005f, filterDecay = 0.4f, filterSustain = 0.3f, filterRelease = 0.3f;
+    float gain = 0.25f;
+
+    // Approximates a Serum preset from its type (bass, lead, pad, pluck) and a few words of its
+    // name, so a role switched to the native synth keeps roughly the character it had.
+    static NativeSynthPatch forPreset (const Preset& preset);
+};
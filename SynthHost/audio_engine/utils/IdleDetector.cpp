@@ -0,0 +1,126 @@
+#include "IdleDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void IdleDetector::setTailSeconds (double seconds)
+{
+    tailSeconds_.store (std::isfinite (seconds) && seconds <= MAX_TAIL_SECONDS ? std::max (0.0, seconds) : 0.0);
+}
+
+void IdleDetector::prepare (double sampleRate)
+{
+    sampleRate_ = sampleRate;
+    state_ = {};
+    idle_.store (false);
+    idleSamples_.store (0);
+}
+
+bool IdleDetector::shouldRender (const juce::MidiBuffer& midi, bool automated, int numSamples)
+{
+    if (! state_.idle)
+        return true;
+
+    if (midi.isEmpty() && ! automated)
+    {
+        skippedBlocks_.fetch_add (1, std::memory_order_relaxed);
+        skippedSamples_.fetch_add (numSamples, std::memory_order_relaxed);
+        idleSamples_.fetch_add (numSamples, std::memory_order_relaxed);
+        return false;
+    }
+
+    // the plugin hears what woke it, so its output has to be measured again before sleeping
+    state_.idle = false;
+    state_.quietSamples = 0;
+    idle_.store (false, std::memory_order_relaxed);
+    idleSamples_.store (0, std::memory_order_relaxed);
+    wakes_.fetch_add (1, std::memory_order_relaxed);
+    return true;
+}
+
+void IdleDetector::rendered (const juce::MidiBuffer& midi, const juce::AudioBuffer<float>& output, int64_t micros)
+{
+    renderedBlocks_.fetch_add (1, std::memory_order_relaxed);
+    renderMicros_.fetch_add (micros, std::memory_order_relaxed);
+
+    bool notesChanged = false;
+    for (const auto metadata : midi)
+    {
+        const auto message = metadata.getMessage();
+        notesChanged |= message.isNoteOnOrOff() || message.isSustainPedalOff()
+                        || message.isAllNotesOff() || message.isAllSoundOff();
+        track (message);
+    }
+
+    const int numSamples = output.getNumSamples();
+    // a release restarts the tail; it only counts down once nothing is held
+    if (notesChanged || notesHeld())
+        state_.tailRemaining = (int64_t) (tailSeconds_.load (std::memory_order_relaxed) * sampleRate_);
+    else
+        state_.tailRemaining = std::max<int64_t> (0, state_.tailRemaining - numSamples);
+
+    float rms = 0.0f;
+    for (int ch = 0; ch < output.getNumChannels(); ++ch)
+        rms = std::max (rms, output.getRMSLevel (ch, 0, numSamples));
+    if (rms > juce::Decibels::decibelsToGain (SILENCE_DB))
+        state_.quietSamples = 0;
+    else
+        state_.quietSamples += numSamples;
+
+    state_.idle = ! notesHeld() && state_.tailRemaining == 0
+                  && state_.quietSamples >= (int64_t) (QUIET_SECONDS * sampleRate_);
+    idle_.store (state_.idle, std::memory_order_relaxed);
+}
+
+void IdleDetector::track (const juce::MidiMessage& message)
+{
+    const auto channel = (size_t) juce::jlimit (1, 16, message.getChannel()) - 1;
+    if (message.isNoteOn())
+        state_.keysDown[channel].set ((size_t) message.getNoteNumber());
+    else if (message.isNoteOff())
+    {
+        state_.keysDown[channel].reset ((size_t) message.getNoteNumber());
+        if (state_.pedalDown[channel])
+            state_.pedalled[channel].set ((size_t) message.getNoteNumber());
+    }
+    else if (message.isSustainPedalOn())
+        state_.pedalDown.set (channel);
+    else if (message.isSustainPedalOff())
+    {
+        state_.pedalDown.reset (channel);
+        state_.pedalled[channel].reset();
+    }
+    else if (message.isAllNotesOff() || message.isAllSoundOff())
+    {
+        state_.keysDown[channel].reset();
+        state_.pedalled[channel].reset();
+    }
+}
+
+bool IdleDetector::notesHeld() const
+{
+    for (size_t channel = 0; channel < 16; ++channel)
+        if (state_.keysDown[channel].any() || state_.pedalled[channel].any())
+            return true;
+    return false;
+}
+
+void IdleDetector::restoreSnapshot (const Snapshot& snapshot)
+{
+    state_ = snapshot;
+    idle_.store (state_.idle, std::memory_order_relaxed);
+}
+
+void IdleDetector::printStats() const
+{
+    const auto rendered = renderedBlocks_.load();
+    const auto skipped = skippedBlocks_.load();
+    const auto averageMicros = rendered > 0 ? renderMicros_.load() / rendered : 0;
+    std::cout << "[idle] " << (isIdle() ? "idle" : "rendering")
+              << " | tail " << tailSeconds_.load() << " s"
+              << " | skipped " << skipped << " of " << rendered + skipped << " blocks ("
+              << skippedSamples_.load() / sampleRate_ << " s idle)"
+              << " | cpu saved ~" << skipped * averageMicros / 1000 << " ms"
+              << " | wakes " << wakes_.load()
+              << std::endl;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// Decides when an engine's plugin can stop being rendered. The plugin is idle once no note is
+// held (by key or sustain pedal), its reported tail has run out since the last note was released
+// and its output has stayed below SILENCE_DB for QUIET_SECONDS; a tail reported as longer than
+// MAX_TAIL_SECONDS (or infinite) is left to that measurement.
+//
+// While idle the engine skips processBlock and passes on silence. Any MIDI or automation in a
+// block wakes it for that very block, so nothing is delayed.
+//
+// shouldRender()/rendered() run on the audio thread (or the look-ahead worker) and neither lock
+// nor allocate; setTailSeconds() may be called from any thread.
+class IdleDetector
+{
+public:
+    static constexpr float SILENCE_DB = -90.0f;
+    static constexpr double QUIET_SECONDS = 0.1;
+    static constexpr double MAX_TAIL_SECONDS = 30.0;
+
+    // The notes held and how far the tail has decayed, so look-ahead rendering can roll them back
+    // along with the plugin.
+    struct Snapshot
+    {
+        std::array<std::bitset<128>, 16> keysDown {};
+        std::array<std::bitset<128>, 16> pedalled {};
+        std::bitset<16> pedalDown {};
+        int64_t tailRemaining = 0;
+        int64_t quietSamples = 0;
+        bool idle = false;
+    };
+
+    void setTailSeconds (double seconds);
+
+    // Audio thread, before the first block.
+    void prepare (double sampleRate);
+
+    // Audio thread: whether the block has to go through the plugin. midi is the block's MIDI as
+    // the plugin would get it; automated whether parameters move in the block.
+    bool shouldRender (const juce::MidiBuffer& midi, bool automated, int numSamples);
+
+    // Audio thread: after a block went through the plugin, with its output and how long it took.
+    void rendered (const juce::MidiBuffer& midi, const juce::AudioBuffer<float>& output, int64_t micros);
+
+    bool isIdle() const { return idle_.load (std::memory_order_relaxed); }
+
+    // How long the plugin has been skipped without a break, in seconds.
+    double getIdleSeconds() const { return idleSamples_.load (std::memory_order_relaxed) / sampleRate_; }
+
+    void saveSnapshot (Snapshot& snapshot) const { snapshot = state_; }
+    void restoreSnapshot (const Snapshot& snapshot);
+
+    void printStats() const;
+
+private:
+    void track (const juce::MidiMessage& message);
+    bool notesHeld() const;
+
+    double sampleRate_ = 48000.0;
+    std::atomic<double> tailSeconds_ { 0.0 };
+    Snapshot state_;
+
+    std::atomic<bool> idle_ { false };
+    std::atomic<int64_t> renderedBlocks_ { 0 };
+    std::atomic<int64_t> renderMicros_ { 0 };
+    std::atomic<int64_t> skippedBlocks_ { 0 };
+    std::atomic<int64_t> skippedSamples_ { 0 };
+    std::atomic<int64_t> idleSamples_ { 0 };
+    std::atomic<int64_t> wakes_ { 0 };
+};
@@ -0,0 +1,130 @@
+#include "LookAheadTimeline.h"
+#include <algorithm>
+
+bool LookAheadTimeline::addMidi (const juce::MidiMessage& message, int64_t time, uint64_t phraseId)
+{
+    const int size = message.getRawDataSize();
+    if (size > 3)
+        return false;
+
+    Event event { Type::MIDI, { 0, 0, 0 }, size, phraseId, {} };
+    std::copy_n (message.getRawData(), size, event.data);
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    if (phraseId != 0 && std::find (cancelled_.begin(), cancelled_.end(), phraseId) != cancelled_.end())
+        return false;
+    events_.emplace (time, event);
+    return time < collected_;
+}
+
+bool LookAheadTimeline::cancelPhrase (uint64_t phraseId, int64_t time)
+{
+    if (phraseId == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    for (auto it = events_.lower_bound (time); it != events_.end();)
+    {
+        if (it->second.type == Type::MIDI && it->second.phraseId == phraseId)
+            it = events_.erase (it);
+        else
+            ++it;
+    }
+    events_.emplace (time, Event { Type::CANCEL, { 0, 0, 0 }, 0, phraseId, {} });
+
+    cancelled_.push_back (phraseId);
+    if (cancelled_.size() > MAX_CANCELLED)
+        cancelled_.pop_front();
+    return time < collected_;
+}
+
+bool LookAheadTimeline::addAutomation (uint32_t parameter, float value, float startValue, int64_t time,
+                                       int rampSamples)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    const auto isMove = [parameter] (const Event& event)
+    {
+        return event.type == Type::AUTOMATION && event.automation.parameter == parameter;
+    };
+    const auto later = events_.upper_bound (time);
+    auto earlier = std::find_if (std::make_reverse_iterator (later), events_.rend(),
+                                 [&isMove] (const auto& entry) { return isMove (entry.second); });
+    if (earlier != events_.rend())
+    {
+        const auto& move = earlier->second.automation;
+        const auto elapsed = time - earlier->first;
+        startValue = elapsed >= move.rampSamples
+                         ? move.value
+                         : move.startValue + (move.value - move.startValue) * (float) elapsed / (float) move.rampSamples;
+    }
+    else
+    {
+        auto next = std::find_if (later, events_.end(), [&isMove] (const auto& entry) { return isMove (entry.second); });
+        if (next != events_.end())
+            startValue = next->second.automation.startValue;
+    }
+    events_.emplace (time, Event { Type::AUTOMATION, { 0, 0, 0 }, 0, 0,
+                                   { parameter, value, startValue, rampSamples, 0 } });
+    return time < collected_;
+}
+
+void LookAheadTimeline::collect (int64_t from, int64_t to, Phrases& phrases, juce::MidiBuffer& midi,
+                                 std::vector<Automation>& automation)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    collected_ = to;
+    for (auto it = events_.lower_bound (from), end = events_.lower_bound (to); it != end; ++it)
+    {
+        const auto& event = it->second;
+        const int offset = (int) (it->first - from);
+
+        if (event.type == Type::AUTOMATION)
+        {
+            automation.push_back (event.automation);
+            automation.back().sampleOffset = offset;
+            continue;
+        }
+
+        if (event.type == Type::CANCEL)
+        {
+            auto phrase = phrases.find (event.phraseId);
+            if (phrase == phrases.end())
+                continue;
+            for (int note = 0; note < 128; ++note)
+                if (phrase->second.sounding[(size_t) note])
+                    midi.addEvent (juce::MidiMessage::noteOff (phrase->second.channel, note), offset);
+            phrases.erase (phrase);
+            continue;
+        }
+
+        const juce::MidiMessage message (event.data, event.size);
+        midi.addEvent (message, offset);
+        if (event.phraseId == 0 || ! (message.isNoteOn() || message.isNoteOff()))
+            continue;
+
+        if (message.isNoteOn())
+        {
+            auto& phrase = phrases[event.phraseId];
+            phrase.channel = message.getChannel();
+            phrase.sounding.set ((size_t) message.getNoteNumber());
+        }
+        else if (auto phrase = phrases.find (event.phraseId); phrase != phrases.end())
+        {
+            phrase->second.sounding.reset ((size_t) message.getNoteNumber());
+            if (phrase->second.sounding.none())
+                phrases.erase (phrase);
+        }
+    }
+}
+
+void LookAheadTimeline::forget (int64_t time)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    events_.erase (events_.begin(), events_.lower_bound (time));
+}
+
+int LookAheadTimeline::size() const
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    return (int) events_.size();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// The AI events of a look-ahead engine (see LookAheadRenderer), kept at absolute sample times.
+//
+// Unlike MidiScheduler, which forgets an event once it has been played, the timeline keeps every
+// event until the renderer says nothing before it will be rendered again, so a stretch that was
+// already rendered can be rendered a second time after a late event or a cancel landed inside it.
+// A cancel is an event too: it drops the phrase's events from its time on and, when rendered,
+// sends note-offs for the phrase's notes still sounding. Which notes those are is part of the
+// render state (Phrases), which the renderer checkpoints together with the plugin.
+//
+// Producers (the MIDI executor) and the render thread share a mutex; neither is the audio thread.
+class LookAheadTimeline
+{
+public:
+    struct Automation
+    {
+        uint32_t parameter;
+        float value;
+        float startValue;
+        int rampSamples;
+        int sampleOffset;
+    };
+
+    struct PhraseNotes
+    {
+        int channel = 1;
+        std::bitset<128> sounding;
+    };
+
+    // phrase id -> the notes it has sounding at the render position
+    using Phrases = std::map<uint64_t, PhraseNotes>;
+
+    // Producer side. Each returns true if time falls inside a block already collected, i.e. the
+    // renderer has to go back and render from time again.
+    bool addMidi (const juce::MidiMessage& message, int64_t time, uint64_t phraseId);
+    bool cancelPhrase (uint64_t phraseId, int64_t time);
+    // The plugin may already have been rendered past time, so a move starts from where the
+    // timeline's last earlier move of the parameter leaves it, or else from where its next later
+    // move starts; startValue (the plugin's value) only when the timeline holds neither.
+    bool addAutomation (uint32_t parameter, float value, float startValue, int64_t time, int rampSamples);
+
+    // Render thread: the events in [from, to), MIDI into midi and parameter moves into automation,
+    // both relative to from; phrases is updated as the block's notes start and stop.
+    void collect (int64_t from, int64_t to, Phrases& phrases, juce::MidiBuffer& midi,
+                  std::vector<Automation>& automation);
+
+    // Render thread: drops the events before time; nothing before it will be rendered again.
+    void forget (int64_t time);
+
+    int size() const;
+
+private:
+    enum class Type : uint8_t { MIDI, CANCEL, AUTOMATION };
+
+    struct Event
+    {
+        Type type;
+        uint8_t data[3];
+        int size;
+        uint64_t phraseId;
+        Automation automation;
+    };
+
+    // cancelled phrases remembered, so their stragglers are dropped
+    static constexpr size_t MAX_CANCELLED = 64;
+
+    mutable std::mutex mutex_;
+    // equal times keep the order the events were added in
+    std::multimap<int64_t, Event> events_;
+    std::deque<uint64_t> cancelled_;
+    // end of the last block collected
+    int64_t collected_ = 0;
+};
@@ -0,0 +1,147 @@
+#include "MidiGovernor.h"
+#include <algorithm>
+#include <iostream>
+
+void MidiGovernor::setConfig (const Config& config)
+{
+    maxNoteMillis_.store (std::max (1, config.maxNoteMillis));
+    maxVoices_.store (juce::jlimit (1, MAX_VOICES, config.maxVoices));
+    maxNotesPerSecond_.store (std::max (1, config.maxNotesPerSecond));
+}
+
+MidiGovernor::Config MidiGovernor::getConfig() const
+{
+    return { maxNoteMillis_.load(), maxVoices_.load(), maxNotesPerSecond_.load() };
+}
+
+void MidiGovernor::prepare (double sampleRate, int maximumBlockSize)
+{
+    sampleRate_ = sampleRate;
+    tokens_ = maxNotesPerSecond_.load();
+    // room for the block's own events plus a note-off per voice
+    governed_.ensureSize ((size_t) (maximumBlockSize + 2 * MAX_VOICES) * 4);
+}
+
+void MidiGovernor::process (juce::MidiBuffer& midi, int numSamples)
+{
+    const int rate = maxNotesPerSecond_.load (std::memory_order_relaxed);
+    // token bucket holding at most one second's worth of note-ons
+    tokens_ = std::min ((double) rate, tokens_ + rate * numSamples / sampleRate_);
+
+    governed_.clear();
+
+    for (const auto metadata : midi)
+    {
+        const auto message = metadata.getMessage();
+        const int position = metadata.samplePosition;
+
+        if (message.isNoteOn())
+            noteOn (message.getChannel(), message.getNoteNumber(), now_ + position, position, message);
+        else if (message.isNoteOff())
+        {
+            noteOff (message.getChannel(), message.getNoteNumber());
+            governed_.addEvent (message, position);
+        }
+        else if (message.isAllNotesOff() || message.isAllSoundOff())
+        {
+            voiceCount_ = 0;
+            governed_.addEvent (message, position);
+        }
+        else
+            governed_.addEvent (message, position);
+    }
+
+    // watchdog: anything held past maxNoteMillis is released where its limit falls in this block
+    const int64_t maxSamples = (int64_t) (maxNoteMillis_.load (std::memory_order_relaxed) * sampleRate_ / 1000.0);
+    for (int i = voiceCount_ - 1; i >= 0; --i)
+    {
+        const int64_t expiry = voices_[(size_t) i].start + maxSamples;
+        if (expiry < now_ + numSamples)
+        {
+            release (i, (int) juce::jlimit<int64_t> (0, numSamples - 1, expiry - now_));
+            ++stuckReleased_;
+        }
+    }
+
+    midi.swapWith (governed_);
+    now_ += numSamples;
+}
+
+void MidiGovernor::noteOn (int channel, int note, int64_t time, int position, const juce::MidiMessage& message)
+{
+    if (tokens_ < 1.0)
+    {
+        ++rateLimited_;
+        return;
+    }
+    tokens_ -= 1.0;
+
+    // a retrigger restarts the voice: it moves to the back as the newest one
+    noteOff (channel, note);
+
+    const int limit = maxVoices_.load (std::memory_order_relaxed);
+    // voices_ is kept in start order, so the oldest is at the front
+    while (voiceCount_ >= limit)
+    {
+        release (0, position);
+        ++voicesStolen_;
+    }
+
+    voices_[(size_t) voiceCount_++] = { channel, note, time };
+    governed_.addEvent (message, position);
+
+    if (voiceCount_ > peakVoices_.load (std::memory_order_relaxed))
+        peakVoices_.store (voiceCount_, std::memory_order_relaxed);
+}
+
+void MidiGovernor::noteOff (int channel, int note)
+{
+    int index = find (channel, note);
+    if (index < 0)
+        return;
+    std::move (voices_.begin() + index + 1, voices_.begin() + voiceCount_, voices_.begin() + index);
+    --voiceCount_;
+}
+
+void MidiGovernor::release (int index, int position)
+{
+    const auto voice = voices_[(size_t) index];
+    governed_.addEvent (juce::MidiMessage::noteOff (voice.channel, voice.note), position);
+    noteOff (voice.channel, voice.note);
+}
+
+int MidiGovernor::find (int channel, int note) const
+{
+    for (int i = 0; i < voiceCount_; ++i)
+        if (voices_[(size_t) i].channel == channel && voices_[(size_t) i].note == note)
+            return i;
+    return -1;
+}
+
+void MidiGovernor::saveSnapshot (Snapshot& snapshot) const
+{
+    snapshot.now = now_;
+    snapshot.tokens = tokens_;
+    snapshot.voices = voices_;
+    snapshot.voiceCount = voiceCount_;
+}
+
+void MidiGovernor::restoreSnapshot (const Snapshot& snapshot)
+{
+    now_ = snapshot.now;
+    tokens_ = snapshot.tokens;
+    voices_ = snapshot.voices;
+    voiceCount_ = snapshot.voiceCount;
+}
+
+void MidiGovernor::printStats() const
+{
+    const auto config = getConfig();
+    std::cout << "[midi governor] limits " << config.maxNoteMillis << " ms / " << config.maxVoices << " voices / "
+              << config.maxNotesPerSecond << " notes/s"
+              << " | stuck released " << stuckReleased_.load()
+              << " | voices stolen " << voicesStolen_.load()
+              << " | rate limited " << rateLimited_.load()
+              << " | peak voices " << peakVoices_.load()
+              << std::endl;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// Sits between an AI stream's MIDI sources and the plugin and bounds what the plugin is asked
+// to render: notes held longer than maxNoteMillis are released, at most maxVoices notes sound at
+// once (the oldest is released to make room) and note-ons beyond maxNotesPerSecond are dropped.
+// process() runs on the audio thread and neither locks nor allocates; the limits may be changed
+// from any thread.
+class MidiGovernor
+{
+public:
+    struct Config
+    {
+        int maxNoteMillis = 8000;
+        int maxVoices = 12;
+        int maxNotesPerSecond = 40;
+    };
+
+    static constexpr int MAX_VOICES = 64;
+
+    void setConfig (const Config& config);
+    Config getConfig() const;
+
+    // Audio thread, before the first block.
+    void prepare (double sampleRate, int maximumBlockSize);
+
+    // Audio thread: rewrites the block's MIDI in place.
+    void process (juce::MidiBuffer& midi, int numSamples);
+
+    // The governor's view of the notes sounding and its rate budget, so look-ahead rendering can
+    // roll it back along with the plugin. Audio thread only.
+    struct Snapshot;
+    void saveSnapshot (Snapshot& snapshot) const;
+    void restoreSnapshot (const Snapshot& snapshot);
+
+    void printStats() const;
+
+private:
+    struct Voice
+    {
+        int channel;
+        int note;
+        int64_t start;
+    };
+
+    void noteOn (int channel, int note, int64_t time, int position, const juce::MidiMessage& message);
+    void noteOff (int channel, int note);
+    void release (int index, int position);
+    int find (int channel, int note) const;
+
+    std::atomic<int> maxNoteMillis_ { 8000 };
+    std::atomic<int> maxVoices_ { 12 };
+    std::atomic<int> maxNotesPerSecond_ { 40 };
+
+    double sampleRate_ = 48000.0;
+    int64_t now_ = 0;
+    double tokens_ = 0.0;
+    std::array<Voice, MAX_VOICES> voices_ {};
+    int voiceCount_ = 0;
+    juce::MidiBuffer governed_;
+
+    std::atomic<int64_t> stuckReleased_ { 0 };
+    std::atomic<int64_t> voicesStolen_ { 0 };
+    std::atomic<int64_t> rateLimited_ { 0 };
+    std::atomic<int> peakVoices_ { 0 };
+};
+
+struct MidiGovernor::Snapshot
+{
+    int64_t now = 0;
+    double tokens = 0.0;
+    std::array<Voice, MAX_VOICES> voices {};
+    int voiceCount = 0;
+};
@@ -0,0 +1,291 @@
+#include "MidiScheduler.h"
+#include <algorithm>
+#include <iostream>
+
+MidiScheduler::MidiScheduler (int capacity)
+    : commandFifo_ (capacity), commands_ ((size_t) capacity), nodes_ ((size_t) capacity)
+{
+    for (int i = 0; i < capacity; ++i)
+        nodes_[(size_t) i].next = i + 1 < capacity ? i + 1 : NONE;
+    freeList_ = 0;
+}
+
+bool MidiScheduler::schedule (const juce::MidiMessage& message, int delaySamples, uint64_t phraseId)
+{
+    Command command { CommandType::SCHEDULE, { 0, 0, 0 }, std::max (0, delaySamples), phraseId };
+    auto size = message.getRawDataSize();
+    if (size > 3)
+    {
+        ++droppedCommands_;
+        return false;
+    }
+    std::copy_n (message.getRawData(), size, command.data);
+    return enqueue (command);
+}
+
+bool MidiScheduler::cancelPhrase (uint64_t phraseId)
+{
+    return phraseId != 0 && enqueue ({ CommandType::CANCEL, { 0, 0, 0 }, 0, phraseId });
+}
+
+bool MidiScheduler::enqueue (const Command& command)
+{
+    const auto scope = commandFifo_.write (1);
+    if (scope.blockSize1 == 0)
+    {
+        ++droppedCommands_;
+        return false;
+    }
+    commands_[(size_t) scope.startIndex1] = command;
+    return true;
+}
+
+void MidiScheduler::renderNextBlock (juce::MidiBuffer& midi, int numSamples)
+{
+    applyCommands (midi);
+
+    const int64_t blockEnd = now_ + numSamples;
+    advanceTo ((blockEnd - 1) >> TICK_SHIFT);
+
+    int previous = NONE;
+    for (int node = due_.head; node != NONE;)
+    {
+        int next = nodes_[(size_t) node].next;
+        if (nodes_[(size_t) node].time < blockEnd)
+        {
+            if (previous == NONE) due_.head = next;
+            else nodes_[(size_t) previous].next = next;
+            if (due_.tail == node) due_.tail = previous;
+            emit (node, midi, now_);
+        }
+        else
+        {
+            previous = node;
+        }
+        node = next;
+    }
+
+    now_ = blockEnd;
+}
+
+void MidiScheduler::applyCommands (juce::MidiBuffer& midi)
+{
+    commandFifo_.read (commandFifo_.getNumReady()).forEach ([this, &midi] (int index)
+    {
+        const auto& command = commands_[(size_t) index];
+
+        if (command.type == CommandType::CANCEL)
+        {
+            int phrase = findPhrase (command.phraseId);
+            if (phrase == NONE)
+                return;
+            auto& p = phrases_[(size_t) phrase];
+            releaseSounding (p, midi);
+            p.cancelled = true;
+            releasePhraseIfDone (phrase);
+            return;
+        }
+
+        int node = freeList_;
+        if (node == NONE)
+        {
+            ++droppedEvents_;
+            return;
+        }
+        freeList_ = nodes_[(size_t) node].next;
+
+        int phrase = NONE;
+        if (command.phraseId != 0)
+        {
+            phrase = acquirePhrase (command.phraseId, midi);
+            if (phrase == NONE)
+                ++untrackedPhrases_;
+            else
+                ++phrases_[(size_t) phrase].pending;
+        }
+
+        auto& n = nodes_[(size_t) node];
+        n.time = now_ + command.delaySamples;
+        std::copy_n (command.data, 3, n.data);
+        n.phrase = phrase;
+        insert (node);
+        ++scheduled_;
+    });
+}
+
+void MidiScheduler::insert (int node)
+{
+    const int64_t tick = nodes_[(size_t) node].time >> TICK_SHIFT;
+    const int64_t delta = tick - currentTick_;
+
+    if (delta < 0)
+        append (due_, node);
+    else if (delta < WHEEL_SIZE)
+        append (inner_[(size_t) (tick & WHEEL_MASK)], node);
+    else if (delta < (int64_t) WHEEL_SIZE * WHEEL_SIZE)
+        append (outer_[(size_t) ((tick >> WHEEL_BITS) & WHEEL_MASK)], node);
+    else
+        append (overflow_, node);
+}
+
+void MidiScheduler::append (List& list, int node)
+{
+    nodes_[(size_t) node].next = NONE;
+    if (list.tail == NONE)
+        list.head = node;
+    else
+        nodes_[(size_t) list.tail].next = node;
+    list.tail = node;
+}
+
+void MidiScheduler::reinsertAll (List& list)
+{
+    int node = list.head;
+    list = {};
+    while (node != NONE)
+    {
+        int next = nodes_[(size_t) node].next;
+        insert (node);
+        node = next;
+    }
+}
+
+void MidiScheduler::advanceTo (int64_t lastTick)
+{
+    for (; currentTick_ <= lastTick; ++currentTick_)
+    {
+        if ((currentTick_ & WHEEL_MASK) == 0)
+        {
+            // entering a new inner revolution: pull its events down from the outer wheel
+            // (and, once per outer revolution, from the overflow list first)
+            if (((currentTick_ >> WHEEL_BITS) & WHEEL_MASK) == 0)
+                reinsertAll (overflow_);
+            reinsertAll (outer_[(size_t) ((currentTick_ >> WHEEL_BITS) & WHEEL_MASK)]);
+        }
+
+        auto& slot = inner_[(size_t) (currentTick_ & WHEEL_MASK)];
+        if (slot.head == NONE)
+            continue;
+        if (due_.tail == NONE)
+            due_.head = slot.head;
+        else
+            nodes_[(size_t) due_.tail].next = slot.head;
+        due_.tail = slot.tail;
+        slot = {};
+    }
+}
+
+void MidiScheduler::emit (int node, juce::MidiBuffer& midi, int64_t blockStart)
+{
+    auto& n = nodes_[(size_t) node];
+    bool play = true;
+
+    if (n.phrase != NONE)
+    {
+        auto& p = phrases_[(size_t) n.phrase];
+        --p.pending;
+        play = ! p.cancelled;
+        const int status = n.data[0] & 0xf0;
+        const int note = n.data[1] & 0x7f;
+        if (play && status == 0x90 && n.data[2] > 0)
+        {
+            p.sounding.set ((size_t) note);
+            p.channel = (n.data[0] & 0x0f) + 1;
+        }
+        else if (play && (status == 0x80 || status == 0x90))
+        {
+            p.sounding.reset ((size_t) note);
+        }
+    }
+
+    if (play)
+    {
+        midi.addEvent (n.data, juce::MidiMessage::getMessageLengthFromFirstByte (n.data[0]),
+                       (int) std::max<int64_t> (0, n.time - blockStart));
+        ++played_;
+    }
+    else
+    {
+        ++cancelled_;
+    }
+
+    const int phrase = n.phrase;
+    n.next = freeList_;
+    freeList_ = node;
+    if (phrase != NONE)
+        releasePhraseIfDone (phrase);
+}
+
+int MidiScheduler::findPhrase (uint64_t id) const
+{
+    for (int i = 0; i < MAX_PHRASES; ++i)
+        if (phrases_[(size_t) i].id == id && ! phrases_[(size_t) i].cancelled)
+            return i;
+    return NONE;
+}
+
+int MidiScheduler::acquirePhrase (uint64_t id, juce::MidiBuffer& midi)
+{
+    int phrase = findPhrase (id);
+    if (phrase != NONE)
+        return phrase;
+
+    // a free slot, or else the oldest phrase with nothing left to play (only held notes)
+    int oldest = NONE;
+    for (int i = 0; i < MAX_PHRASES; ++i)
+    {
+        const auto& p = phrases_[(size_t) i];
+        if (p.id == 0)
+        {
+            oldest = i;
+            break;
+        }
+        if (p.pending == 0 && (oldest == NONE || p.acquired < phrases_[(size_t) oldest].acquired))
+            oldest = i;
+    }
+    if (oldest == NONE)
+        return NONE;
+
+    auto& p = phrases_[(size_t) oldest];
+    if (p.id != 0)
+    {
+        releaseSounding (p, midi);
+        ++recycledPhrases_;
+    }
+    p = {};
+    p.id = id;
+    p.acquired = ++phraseCounter_;
+    return oldest;
+}
+
+void MidiScheduler::releaseSounding (Phrase& phrase, juce::MidiBuffer& midi)
+{
+    for (int note = 0; note < 128; ++note)
+    {
+        if (phrase.sounding[(size_t) note])
+        {
+            midi.addEvent (juce::MidiMessage::noteOff (phrase.channel, note), 0);
+            ++releasedNotes_;
+        }
+    }
+    phrase.sounding.reset();
+}
+
+void MidiScheduler::releasePhraseIfDone (int phrase)
+{
+    auto& p = phrases_[(size_t) phrase];
+    if (p.pending == 0 && (p.cancelled || p.sounding.none()))
+        p = {};
+}
+
+void MidiScheduler::printStats() const
+{
+    std::cout << "[midi scheduler] scheduled " << scheduled_.load()
+              << " | played " << played_.load()
+              << " | cancelled " << cancelled_.load()
+              << " | note-offs on cancel/recycle " << releasedNotes_.load()
+              << " | dropped " << droppedCommands_.load() << " commands, " << droppedEvents_.load() << " events"
+              << " | untracked phrases " << untrackedPhrases_.load()
+              << " | recycled phrases " << recycledPhrases_.load()
+              << std::endl;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// Sample-accurate MIDI scheduler for one engine, built as a two-level hierarchical timing wheel.
+//
+// schedule()/cancelPhrase() are called from a single producer thread (the MIDI executor) and only
+// push a command into a lock-free FIFO; everything else happens on the audio thread inside
+// renderNextBlock(), which never locks or allocates.
+//
+// Time is counted in samples rendered since start and bucketed into ticks of 256 samples. The
+// inner wheel holds the next 256 ticks (~1.4 s at 48 kHz), the outer wheel the next 256 * 256
+// ticks (~6 min); anything further out waits on an overflow list. Insertion is O(1) and each
+// block only visits the ticks it covers, cascading an outer slot down once per 256 ticks.
+//
+// Events may belong to a phrase (phraseId != 0). Cancelling a phrase discards its pending events
+// and sends note-offs for the notes it has started that are still sounding. A phrase whose events
+// have all played but which leaves notes held keeps its slot so a cancel can still release them;
+// when every slot is taken, the oldest such phrase is released and its slot reused.
+class MidiScheduler
+{
+public:
+    explicit MidiScheduler (int capacity = 8192);
+
+    // Producer side. Returns false if the command FIFO is full.
+    bool schedule (const juce::MidiMessage& message, int delaySamples, uint64_t phraseId = 0);
+    bool cancelPhrase (uint64_t phraseId);
+
+    // Audio thread: applies queued commands and adds every event due in the next numSamples.
+    void renderNextBlock (juce::MidiBuffer& midi, int numSamples);
+
+    void printStats() const;
+
+private:
+    static constexpr int TICK_SHIFT = 8;
+    static constexpr int WHEEL_BITS = 8;
+    static constexpr int WHEEL_SIZE = 1 << WHEEL_BITS;
+    static constexpr int WHEEL_MASK = WHEEL_SIZE - 1;
+    static constexpr int MAX_PHRASES = 64;
+    static constexpr int NONE = -1;
+
+    enum class CommandType : uint8_t { SCHEDULE, CANCEL };
+
+    struct Command
+    {
+        CommandType type;
+        uint8_t data[3];
+        int delaySamples;
+        uint64_t phraseId;
+    };
+
+    struct Node
+    {
+        int64_t time;
+        uint8_t data[3];
+        int phrase;
+        int next;
+    };
+
+    // FIFO of nodes, so events due at the same sample keep the order they were scheduled in
+    struct List
+    {
+        int head = NONE;
+        int tail = NONE;
+    };
+
+    struct Phrase
+    {
+        uint64_t id = 0;
+        bool cancelled = false;
+        int pending = 0;
+        int channel = 1;
+        uint64_t acquired = 0;
+        std::bitset<128> sounding;
+    };
+
+    bool enqueue (const Command& command);
+    void applyCommands (juce::MidiBuffer& midi);
+    void insert (int node);
+    void append (List& list, int node);
+    void reinsertAll (List& list);
+    void advanceTo (int64_t lastTick);
+    void emit (int node, juce::MidiBuffer& midi, int64_t blockStart);
+    int findPhrase (uint64_t id) const;
+    int acquirePhrase (uint64_t id, juce::MidiBuffer& midi);
+    void releaseSounding (Phrase& phrase, juce::MidiBuffer& midi);
+    void releasePhraseIfDone (int phrase);
+
+    juce::AbstractFifo commandFifo_;
+    std::vector<Command> commands_;
+
+    std::vector<Node> nodes_;
+    int freeList_ = NONE;
+    std::array<List, WHEEL_SIZE> inner_;
+    std::array<List, WHEEL_SIZE> outer_;
+    List overflow_;
+    // events whose tick has been reached but whose sample lies beyond the current block
+    List due_;
+    int64_t currentTick_ = 0;
+    int64_t now_ = 0;
+
+    std::array<Phrase, MAX_PHRASES> phrases_;
+    uint64_t phraseCounter_ = 0;
+
+    std::atomic<int64_t> scheduled_ { 0 };
+    std::atomic<int64_t> played_ { 0 };
+    std::atomic<int64_t> cancelled_ { 0 };
+    std::atomic<int64_t> releasedNotes_ { 0 };
+    std::atomic<int64_t> droppedCommands_ { 0 };
+    std::atomic<int64_t> droppedEvents_ { 0 };
+    std::atomic<int64_t> untrackedPhrases_ { 0 };
+    std::atomic<int64_t> recycledPhrases_ { 0 };
+};
@@ -0,0 +1,180 @@
+#include "ParameterAutomation.h"
+#include <algorithm>
+#include <iostream>
+
+ParameterAutomation::ParameterAutomation (int capacity)
+    : commandFifo_ (capacity), commands_ ((size_t) capacity)
+{
+    // every lane ramping for a whole block of up to 8192 samples, plus the events themselves
+    points_.reserve ((size_t) (MAX_LANES * (8192 / STEP + 1) + MAX_PENDING));
+}
+
+bool ParameterAutomation::automate (uint32_t parameter, float value, float startValue, int delaySamples, int rampSamples)
+{
+    Command command { parameter, juce::jlimit (0.0f, 1.0f, value), juce::jlimit (0.0f, 1.0f, startValue),
+                      std::max (0, delaySamples), std::max (0, rampSamples) };
+
+    std::lock_guard<std::mutex> lock (producerMutex_);
+    const auto scope = commandFifo_.write (1);
+    if (scope.blockSize1 == 0)
+    {
+        ++droppedCommands_;
+        return false;
+    }
+    commands_[(size_t) scope.startIndex1] = command;
+    return true;
+}
+
+void ParameterAutomation::applyCommands()
+{
+    commandFifo_.read (commandFifo_.getNumReady()).forEach ([this] (int index)
+    {
+        if (pendingCount_ == MAX_PENDING)
+        {
+            ++droppedEvents_;
+            return;
+        }
+        const auto& command = commands_[(size_t) index];
+        pending_[(size_t) pendingCount_++] = { now_ + command.delaySamples, command };
+    });
+}
+
+ParameterAutomation::Lane* ParameterAutomation::laneFor (uint32_t parameter, float startValue)
+{
+    Lane* idle = nullptr;
+    for (auto& lane : lanes_)
+    {
+        if (lane.used && lane.parameter == parameter)
+            return &lane;
+        if (idle == nullptr && (! lane.used || (! lane.value.isSmoothing() && ! lane.dirty)))
+            idle = &lane;
+    }
+    if (idle != nullptr)
+    {
+        idle->used = true;
+        idle->dirty = false;
+        idle->parameter = parameter;
+        idle->value.setCurrentAndTargetValue (startValue);
+    }
+    return idle;
+}
+
+// Starts every pending event due at or before time, in the order they were queued.
+void ParameterAutomation::startDue (int64_t time)
+{
+    int kept = 0;
+    for (int i = 0; i < pendingCount_; ++i)
+    {
+        const auto& pending = pending_[(size_t) i];
+        if (pending.time > time)
+        {
+            pending_[(size_t) kept++] = pending;
+            continue;
+        }
+        const auto& command = pending.command;
+        auto* lane = laneFor (command.parameter, command.startValue);
+        if (lane == nullptr)
+        {
+            ++droppedEvents_;
+            continue;
+        }
+        // reset() snaps to the old target, so carry a ramp in progress over by hand
+        const float current = lane->value.getCurrentValue();
+        lane->value.reset (std::max (1, command.rampSamples));
+        lane->value.setCurrentAndTargetValue (current);
+        if (command.rampSamples == 0)
+            lane->value.setCurrentAndTargetValue (command.value);
+        else
+            lane->value.setTargetValue (command.value);
+        lane->dirty = true;
+        ++events_;
+    }
+    pendingCount_ = kept;
+}
+
+void ParameterAutomation::emit (const Lane& lane, int sampleOffset)
+{
+    if (points_.size() == points_.capacity())
+        return;
+    points_.push_back ({ lane.parameter, sampleOffset, lane.value.getCurrentValue() });
+}
+
+const std::vector<ParameterAutomation::Point>& ParameterAutomation::renderNextBlock (int numSamples)
+{
+    points_.clear();
+    applyCommands();
+
+    int position = 0;
+    while (position < numSamples)
+    {
+        startDue (now_ + position);
+
+        bool ramping = false;
+        for (auto& lane : lanes_)
+        {
+            if (! lane.used)
+                continue;
+            if (lane.dirty || lane.value.isSmoothing())
+                emit (lane, position);
+            lane.dirty = false;
+            ramping = ramping || lane.value.isSmoothing();
+        }
+
+        int next = numSamples;
+        if (ramping)
+            next = std::min (next, position + STEP);
+        for (int i = 0; i < pendingCount_; ++i)
+            next = (int) std::min<int64_t> (next, std::max<int64_t> (position + 1, pending_[(size_t) i].time - now_));
+
+        for (auto& lane : lanes_)
+        {
+            if (lane.used && lane.value.isSmoothing())
+            {
+                lane.value.skip (next - position);
+                // the value it settles on goes out at the next boundary
+                if (! lane.value.isSmoothing())
+                    lane.dirty = true;
+            }
+        }
+        position = next;
+    }
+    now_ += numSamples;
+
+    const int count = (int) points_.size();
+    lastBlockPoints_.store (count, std::memory_order_relaxed);
+    if (count > 0)
+    {
+        ++automatedBlocks_;
+        totalPoints_ += count;
+        if (count > maxBlockPoints_.load (std::memory_order_relaxed))
+            maxBlockPoints_.store (count, std::memory_order_relaxed);
+    }
+    return points_;
+}
+
+void ParameterAutomation::saveSnapshot (Snapshot& snapshot) const
+{
+    snapshot.pending = pending_;
+    snapshot.pendingCount = pendingCount_;
+    snapshot.lanes = lanes_;
+    snapshot.now = now_;
+}
+
+void ParameterAutomation::restoreSnapshot (const Snapshot& snapshot)
+{
+    pending_ = snapshot.pending;
+    pendingCount_ = snapshot.pendingCount;
+    lanes_ = snapshot.lanes;
+    now_ = snapshot.now;
+}
+
+void ParameterAutomation::printStats() const
+{
+    const auto blocks = automatedBlocks_.load();
+    std::cout << "[automation] events " << events_.load()
+              << " | automated blocks " << blocks
+              << " | points/block avg " << (blocks > 0 ? double (totalPoints_.load()) / double (blocks) : 0.0)
+              << " max " << maxBlockPoints_.load()
+              << " | dropped " << droppedCommands_.load() << " commands, " << droppedEvents_.load() << " events"
+              << std::endl;
+}
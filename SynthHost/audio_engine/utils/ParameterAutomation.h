@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// Sample-accurate plugin parameter automation for one engine.
+//
+// automate() may be called from any thread (producers are serialized among themselves) and only
+// pushes a command into a lock-free FIFO. renderNextBlock() runs on the audio thread, never locks
+// or allocates, and turns the pending ramps into a list of (parameter, sample offset, value)
+// points for the block: one where an automation event lands and one every STEP samples while a
+// parameter is ramping (linear juce::SmoothedValue). The engine either hands the points to the
+// plugin as VST3 parameter changes or renders the block in slices between them.
+//
+// Parameters are identified by an opaque number chosen by the engine (a JUCE parameter index or a
+// VST3 ParamID); values are normalized 0..1.
+class ParameterAutomation
+{
+public:
+    struct Point
+    {
+        uint32_t parameter;
+        int sampleOffset;
+        float value;
+    };
+
+    static constexpr int STEP = 64;
+    static constexpr int MAX_LANES = 32;
+
+    explicit ParameterAutomation (int capacity = 1024);
+
+    // Producer side. startValue is the parameter's current value, used only if no lane is
+    // following the parameter yet. Returns false if the command FIFO is full.
+    bool automate (uint32_t parameter, float value, float startValue, int delaySamples, int rampSamples);
+
+    // Audio thread: the points for the next numSamples, ordered by sampleOffset.
+    const std::vector<Point>& renderNextBlock (int numSamples);
+
+    // Points produced by the last block (0 when nothing was automated).
+    int getLastBlockPoints() const { return lastBlockPoints_.load (std::memory_order_relaxed); }
+
+    // Pending events, ramp positions and the sample clock, so look-ahead rendering can roll them
+    // back along with the plugin. Audio thread only; commands still in the FIFO are not included.
+    struct Snapshot;
+    void saveSnapshot (Snapshot& snapshot) const;
+    void restoreSnapshot (const Snapshot& snapshot);
+
+    void printStats() const;
+
+private:
+    static constexpr int MAX_PENDING = 256;
+
+    struct Command
+    {
+        uint32_t parameter;
+        float value;
+        float startValue;
+        int delaySamples;
+        int rampSamples;
+    };
+
+    struct Pending
+    {
+        int64_t time;
+        Command command;
+    };
+
+    struct Lane
+    {
+        bool used = false;
+        bool dirty = false;
+        uint32_t parameter = 0;
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> value;
+    };
+
+    void applyCommands();
+    void startDue (int64_t time);
+    Lane* laneFor (uint32_t parameter, float startValue);
+    void emit (const Lane& lane, int sampleOffset);
+
+    std::mutex producerMutex_;
+    juce::AbstractFifo commandFifo_;
+    std::vector<Command> commands_;
+
+    std::array<Pending, MAX_PENDING> pending_ {};
+    int pendingCount_ = 0;
+    std::array<Lane, MAX_LANES> lanes_ {};
+    std::vector<Point> points_;
+    int64_t now_ = 0;
+
+    std::atomic<int64_t> events_ { 0 };
+    std::atomic<int64_t> totalPoints_ { 0 };
+    std::atomic<int64_t> automatedBlocks_ { 0 };
+    std::atomic<int> maxBlockPoints_ { 0 };
+    std::atomic<int> lastBlockPoints_ { 0 };
+    std::atomic<int64_t> droppedCommands_ { 0 };
+    std::atomic<int64_t> droppedEvents_ { 0 };
+};
+
+struct ParameterAutomation::Snapshot
+{
+    std::array<Pending, MAX_PENDING> pending {};
+    int pendingCount = 0;
+    std::array<Lane, MAX_LANES> lanes {};
+    int64_t now = 0;
+};
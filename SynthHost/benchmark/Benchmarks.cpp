@@ -0,0 +1,35 @@
+#include "Benchmarks.h"
+
+#include <iostream>
+#include <juce_events/juce_events.h>
+
+int Benchmarks::run(const std::string& name, const std::string& arg) {
+    bool all = name.empty() || name == "all";
+    bool ran = false;
+    if (all || name == "json") {
+        jsonDecode(200000);
+        ran = true;
+    }
+    if (all || name == "key") {
+        keyEstimate(1000000);
+        ran = true;
+    }
+    if (all || name == "rnn") {
+        musicRnn(arg);
+        ran = true;
+    }
+    if (all || name == "synth") {
+        nativeSynth(20000);
+        ran = true;
+    }
+    if (name == "vst3") {
+        juce::ScopedJuceInitialiser_GUI juce;
+        pluginBackends(arg);
+        ran = true;
+    }
+    if (!ran) {
+        std::cout << "Unknown benchmark: " << name << std::endl;
+        return 1;
+    }
+    return 0;
+}
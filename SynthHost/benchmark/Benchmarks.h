@@ -0,0 +1,18 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+#include <string>
+
+// Offline microbenchmarks, run with `SynthHost --bench [name] [arg]`. None of them need the bridge; only
+// "vst3" loads a plugin (Serum, or the arg: "test-synth" or a .vst3 path) and is therefore left out of "all".
+class Benchmarks {
+public:
+    static int run(const std::string& name, const std::string& arg = "");
+
+    static void jsonDecode(int iterations);
+    static void musicRnn(const std::string& weightsPath);
+    static void keyEstimate(int notes);
+    static void pluginBackends(const std::string& pluginPath);
+    static void nativeSynth(int blocks);
+};
+
+#endif //BENCHMARKS_H
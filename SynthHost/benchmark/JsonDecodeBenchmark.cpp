@@ -0,0 +1,56 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <boost/beast/core.hpp>
+#include <nlohmann/json.hpp>
+
+#include "../websocket/MidiEvent.h"
+
+namespace beast = boost::beast;
+using json = nlohmann::json;
+
+// Compares the DOM path WebSocketClient::onRead used for every composer note
+// (buffers_to_string + json::parse + .at() lookups) with the typed SAX path.
+void Benchmarks::jsonDecode(int iterations) {
+    const std::string frame =
+            R"({"type":"note_on","role":"lead","note":64,"velocity":100,"timestamp":1747130000123})";
+    beast::flat_buffer buffer;
+    auto dst = buffer.prepare(frame.size());
+    std::memcpy(dst.data(), frame.data(), frame.size());
+    buffer.commit(frame.size());
+
+    using clock = std::chrono::steady_clock;
+    int64_t checksum = 0;
+
+    auto domStart = clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        auto message = beast::buffers_to_string(buffer.data());
+        auto j = json::parse(message);
+        checksum += j.at("note").get<int>() + j.at("velocity").get<int>() + j.at("timestamp").get<int64_t>();
+        checksum += j.at("role").get<std::string>().size() + j.at("type").get<std::string>().size();
+    }
+    auto domNs = std::chrono::duration<double, std::nano>(clock::now() - domStart).count();
+
+    const auto& schema = MidiEvent::schema();
+    auto saxStart = clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        auto data = buffer.data();
+        auto begin = static_cast<const char *>(data.data());
+        MidiEvent event;
+        if (!schema.decode(begin, begin + data.size(), event)) {
+            std::cout << "[bench json] typed decode failed" << std::endl;
+            return;
+        }
+        checksum -= event.note + event.velocity + event.timestamp;
+        checksum -= event.role.size() + event.type.size();
+    }
+    auto saxNs = std::chrono::duration<double, std::nano>(clock::now() - saxStart).count();
+
+    std::cout << "[bench json] " << iterations << " frames"
+              << " | dom: " << domNs / iterations << " ns/msg"
+              << " | typed sax: " << saxNs / iterations << " ns/msg"
+              << " | speedup: " << domNs / saxNs << "x"
+              << (checksum == 0 ? "" : " | MISMATCH") << std::endl;
+}
@@ -0,0 +1,47 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../midi/KeyEstimator.h"
+
+// Update cost per note of the streaming key estimator against correlating the whole histogram
+// again after every note. The input is random A minor scale notes (tonic and fifth twice as likely),
+// 8 notes per second.
+void Benchmarks::keyEstimate(int notes) {
+    const int scale[] = {57, 57, 59, 60, 62, 64, 64, 65, 67};
+    std::mt19937 rng(7);
+    std::vector<int> input(notes);
+    for (auto& note : input)
+        note = scale[rng() % 9] + 12 * int(rng() % 3);
+
+    using clock = std::chrono::steady_clock;
+    KeyEstimator incremental;
+    int mismatches = 0;
+    auto start = clock::now();
+    for (int i = 0; i < notes; ++i)
+        incremental.addNote(input[i], i * 0.125);
+    auto incrementalNs = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    KeyEstimator full;
+    double checksum = 0.0;
+    start = clock::now();
+    for (int i = 0; i < notes; ++i) {
+        full.addNote(input[i], i * 0.125);
+        checksum += full.recompute().confidence;
+    }
+    auto fullNs = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    auto a = incremental.current();
+    auto b = full.recompute();
+    if (a.tonic != b.tonic || a.minor != b.minor)
+        ++mismatches;
+
+    std::cout << "[bench key] " << notes << " notes"
+              << " | incremental: " << incrementalNs / notes << " ns/note"
+              << " | with full re-correlation: " << fullNs / notes << " ns/note"
+              << " | key: " << a.name() << " (" << a.confidence << ")"
+              << (mismatches == 0 && checksum > 0.0 ? "" : " | MISMATCH") << std::endl;
+}
@@ -0,0 +1,73 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../composer/MatVec.h"
+#include "../composer/MusicRNN.h"
+#include "../composer/NativeComposer.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    template <typename F>
+    double microsPerCall(int iterations, F&& f) {
+        auto start = Clock::now();
+        for (int i = 0; i < iterations; ++i)
+            f();
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+    }
+}
+
+// Native MusicRNN inference: the recurrent mat-vec kernel (scalar vs. SIMD), generation
+// throughput, and time to first note through NativeComposer. Uses random weights of the
+// default shape unless an exported model is given (`--bench rnn music_rnn.bin`).
+void Benchmarks::musicRnn(const std::string& weightsPath) {
+    auto model = std::make_shared<MusicRNN>();
+    std::string error;
+    if (weightsPath.empty()) {
+        model->randomize(24, 1234);
+    } else if (!model->load(weightsPath, error)) {
+        std::cout << "[bench rnn] " << error << std::endl;
+        return;
+    }
+
+    // layer >= 1 step: 4H x 2H
+    const int rows = 1024, cols = 512;
+    std::vector<float> w((size_t) rows * cols, 0.01f), x(cols, 0.5f), y(rows, 0.0f);
+    double scalarUs = microsPerCall(2000, [&]() { MatVec::matVecAddScalar(w.data(), rows, cols, x.data(), y.data()); });
+    double simdUs = microsPerCall(2000, [&]() { MatVec::matVecAdd(w.data(), rows, cols, x.data(), y.data()); });
+    std::cout << "[bench rnn] mat-vec " << rows << "x" << cols
+              << " | scalar: " << scalarUs << " us (" << 2.0 * rows * cols / scalarUs / 1000.0 << " GFLOP/s)"
+              << " | " << MatVec::isa() << ": " << simdUs << " us (" << 2.0 * rows * cols / simdUs / 1000.0 << " GFLOP/s)"
+              << " | speedup: " << scalarUs / simdUs << "x" << std::endl;
+
+    // one generate() call as WebSocketClient.py makes it: 200-token seed, 128 new tokens
+    std::vector<int> seed;
+    for (int i = 0; i < 200; ++i)
+        seed.push_back(i % 4 == 3 ? MusicRNN::NOTE_ON + 48 + i % 24 : MusicRNN::TIME_SHIFT + 1);
+    std::mt19937 rng(42);
+    auto state = model->start(1, 0);
+    double feedUs = microsPerCall(2000, [&]() { model->feed(state, MusicRNN::TIME_SHIFT + 1); });
+    double generateMs = microsPerCall(20, [&]() { model->generate(seed, 1, 0, 128, 1.0f, rng); }) / 1000.0;
+    std::cout << "[bench rnn] step: " << feedUs << " us"
+              << " | tokens/s: " << 1e6 / feedUs
+              << " | generate(seed 200, 128 tokens): " << generateMs << " ms" << std::endl;
+
+    // end to end: user note in, first generated note_on out (3 roles, round-robin)
+    NativeComposer::Config config;
+    config.period = std::chrono::milliseconds(0);
+    NativeComposer composer(model, [](const MidiEvent&) {}, config);
+    const int trials = 20;
+    for (int i = 0; i < trials; ++i) {
+        auto wall = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        composer.onUserNote("bench", "lead", 60 + i % 12, 100, wall, Clock::now());
+        while (composer.getPhrasesGenerated() < (int64_t) 3 * (i + 1))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    composer.printStats();
+}
@@ -0,0 +1,56 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "../audio_engine/synth/NativeSynth.h"
+
+// Render cost per block of the native synth with the patch approximating one preset of each role,
+// at 48 kHz / 256 samples. Each role plays its typical part: four-note chords for pads and plucks,
+// single notes for bass and lead, re-triggered every 32 blocks and held for 16. The streams-per-core
+// figure is how many such synths one core renders in real time.
+void Benchmarks::nativeSynth(int blocks) {
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    const Preset presets[] = {Presets::ANALOG_REESE_SWEEP, Presets::LEGATO_SAW_LEAD, Presets::BLADE_SWIMMER,
+                              Presets::TETRA};
+
+    for (const auto& preset : presets) {
+        NativeSynth synth;
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+        synth.setPatch(NativeSynthPatch::forPreset(preset));
+        bool chords = preset.type == "pad" || preset.type == "pluck";
+
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        int activeVoices = 0;
+        float peak = 0.0f;
+        using clock = std::chrono::steady_clock;
+        auto start = clock::now();
+        for (int block = 0; block < blocks; ++block) {
+            midi.clear();
+            buffer.clear();
+            int root = 48 + (block / 32) % 12;
+            for (int interval : {0, 4, 7, 12}) {
+                if (block % 32 == 0)
+                    midi.addEvent(juce::MidiMessage::noteOn(1, root + interval, (juce::uint8) 100), 17);
+                if (block % 32 == 16)
+                    midi.addEvent(juce::MidiMessage::noteOff(1, root + interval), 3);
+                if (!chords)
+                    break;
+            }
+            synth.renderNextBlock(buffer, midi, 0, blockSize);
+            activeVoices += synth.getActiveVoiceCount();
+            peak = std::max(peak, buffer.getMagnitude(0, blockSize));
+        }
+        double us = std::chrono::duration<double, std::micro>(clock::now() - start).count() / blocks;
+        double blockUs = 1e6 * blockSize / sampleRate;
+
+        std::cout << "[bench synth] " << preset.type << " (" << preset.name << ")"
+                  << " | " << us << " us/block"
+                  << " | " << double(activeVoices) / blocks << " voices avg"
+                  << " | peak " << peak
+                  << " | ~" << int(blockUs / us) << " streams/core" << std::endl;
+    }
+}
@@ -0,0 +1,74 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "../utils/PluginEnum.h"
+#include "../vst_hosting/PluginManager.h"
+#include "../vst_hosting/Vst3DirectInstance.h"
+
+// Render cost per block of the same plugin hosted through JUCE's VST3 wrapper and through
+// Vst3DirectInstance. Both render an identical note pattern (a three-note chord every 32 blocks,
+// held for 16) at 48 kHz / 256 samples; blocks the direct backend reported as silent are counted.
+void Benchmarks::pluginBackends(const std::string& pluginPath) {
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr int warmUpBlocks = 200;
+    constexpr int blocks = 4000;
+
+    PluginDef plugin = pluginPath.empty() ? PluginEnum::SERUM_LAPTOP : PluginEnum::fromName(pluginPath);
+
+    PluginManager pluginManager;
+    for (auto backend : {PluginDef::Backend::JUCE, PluginDef::Backend::VST3_DIRECT}) {
+        const char* label = backend == PluginDef::Backend::JUCE ? "juce" : "vst3-direct";
+        juce::String error;
+        std::unique_ptr<juce::AudioPluginInstance> instance;
+        try {
+            instance = pluginManager.loadPlugin(plugin.withBackend(backend), sampleRate, blockSize, error);
+        } catch (const std::exception& e) {
+            std::cout << "[bench vst3] " << label << ": " << e.what() << std::endl;
+            continue;
+        }
+        instance->prepareToPlay(sampleRate, blockSize);
+        auto* direct = dynamic_cast<Vst3DirectInstance*>(instance.get());
+
+        juce::AudioBuffer<float> buffer(std::max(2, instance->getTotalNumOutputChannels()), blockSize);
+        juce::MidiBuffer midi;
+        std::vector<double> micros;
+        micros.reserve(blocks);
+        int silentBlocks = 0;
+        for (int i = 0; i < warmUpBlocks + blocks; ++i) {
+            midi.clear();
+            for (int note : {48, 55, 64}) {
+                if (i % 32 == 0)
+                    midi.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8) 100), 17);
+                if (i % 32 == 16)
+                    midi.addEvent(juce::MidiMessage::noteOff(1, note), 17);
+            }
+            buffer.clear();
+            auto start = std::chrono::steady_clock::now();
+            instance->processBlock(buffer, midi);
+            auto us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            if (i < warmUpBlocks)
+                continue;
+            micros.push_back(us);
+            if (direct != nullptr && direct->isOutputSilent())
+                ++silentBlocks;
+        }
+        instance->releaseResources();
+
+        std::sort(micros.begin(), micros.end());
+        double mean = 0.0;
+        for (double us : micros)
+            mean += us;
+        mean /= micros.size();
+        std::cout << "[bench vst3] " << label << " | " << blocks << " blocks of " << blockSize
+                  << " | mean " << mean << " us/block | p50 " << micros[micros.size() / 2]
+                  << " us | p99 " << micros[micros.size() * 99 / 100] << " us";
+        if (direct != nullptr)
+            std::cout << " | silent blocks: " << silentBlocks;
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,182 @@
+#include "EngineSnapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    template <typename T>
+    void put(std::vector<char>& out, T value) {
+        const char* raw = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), raw, raw + sizeof(T));
+    }
+
+    void putBytes(std::vector<char>& out, const void* data, size_t size) {
+        put<uint32_t>(out, uint32_t(size));
+        const char* raw = static_cast<const char*>(data);
+        out.insert(out.end(), raw, raw + size);
+    }
+
+    void putString(std::vector<char>& out, const std::string& value) {
+        putBytes(out, value.data(), value.size());
+    }
+
+    // Bounds-checked cursor over the file; any read past the end marks it failed.
+    struct Reader {
+        const std::string& data;
+        size_t pos = 0;
+        bool ok = true;
+
+        template <typename T>
+        T get() {
+            T value{};
+            if (pos + sizeof(T) > data.size()) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        // element count; every element takes at least a byte, so a count beyond the remaining
+        // data means a corrupt file rather than a huge allocation
+        uint32_t getCount() {
+            auto count = get<uint32_t>();
+            if (!ok || count > data.size() - pos) {
+                ok = false;
+                return 0;
+            }
+            return count;
+        }
+
+        std::string getString() {
+            auto size = get<uint32_t>();
+            if (!ok || pos + size > data.size()) {
+                ok = false;
+                return {};
+            }
+            std::string value = data.substr(pos, size);
+            pos += size;
+            return value;
+        }
+    };
+}
+
+size_t EngineSnapshot::streamCount() const {
+    size_t count = 0;
+    for (const auto& session: sessions)
+        count += session.streams.size();
+    return count;
+}
+
+bool EngineSnapshot::write(const std::string& path, std::string& error) const {
+    std::vector<char> out(MAGIC, MAGIC + 8);
+    put<uint32_t>(out, sampleRate);
+    put<uint32_t>(out, blockSize);
+    put<uint32_t>(out, uint32_t(sessions.size()));
+    for (const auto& session: sessions) {
+        putString(out, session.id);
+        put<int32_t>(out, session.basePort);
+        put<uint32_t>(out, uint32_t(session.streams.size()));
+        for (const auto& stream: session.streams) {
+            put<int32_t>(out, stream.id);
+            put<int32_t>(out, stream.port);
+            putString(out, stream.role);
+            put<uint8_t>(out, stream.ai ? 1 : 0);
+            putString(out, stream.plugin.name);
+            putString(out, stream.plugin.path);
+            put<uint8_t>(out, uint8_t(stream.plugin.backend));
+            put<uint8_t>(out, stream.plugin.serumPresets ? 1 : 0);
+            put<uint8_t>(out, stream.paused ? 1 : 0);
+            put<uint8_t>(out, stream.preset ? 1 : 0);
+            putString(out, stream.preset ? stream.preset->name : "");
+            putString(out, stream.preset ? stream.preset->path : "");
+            putString(out, stream.preset ? stream.preset->type : "");
+            put<int32_t>(out, stream.governor.maxNoteMillis);
+            put<int32_t>(out, stream.governor.maxVoices);
+            put<int32_t>(out, stream.governor.maxNotesPerSecond);
+            put<uint32_t>(out, uint32_t(stream.parameters.size()));
+            for (const auto& parameter: stream.parameters) {
+                putString(out, parameter.first);
+                put<float>(out, parameter.second);
+            }
+            putBytes(out, stream.pluginState.getData(), stream.pluginState.getSize());
+        }
+    }
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), std::streamsize(out.size()));
+        if (!file) {
+            error = "could not write " + temporary;
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "could not move " + temporary + " to " + path;
+        return false;
+    }
+    return true;
+}
+
+bool EngineSnapshot::read(const std::string& path, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "no snapshot at " + path;
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 8 || data.compare(0, 8, MAGIC) != 0) {
+        error = path + " is not a version " + std::string(MAGIC + 6, 2) + " engine snapshot";
+        return false;
+    }
+
+    Reader in{data, 8};
+    sampleRate = in.get<uint32_t>();
+    blockSize = in.get<uint32_t>();
+    sessions.assign(in.getCount(), {});
+    for (auto& session: sessions) {
+        if (!in.ok) break;
+        session.id = in.getString();
+        session.basePort = in.get<int32_t>();
+        session.streams.assign(in.getCount(), {});
+        for (auto& stream: session.streams) {
+            if (!in.ok) break;
+            stream.id = in.get<int32_t>();
+            stream.port = in.get<int32_t>();
+            stream.role = in.getString();
+            stream.ai = in.get<uint8_t>() != 0;
+            stream.plugin.name = in.getString();
+            stream.plugin.path = in.getString();
+            stream.plugin.backend = PluginDef::Backend(in.get<uint8_t>());
+            stream.plugin.serumPresets = in.get<uint8_t>() != 0;
+            stream.paused = in.get<uint8_t>() != 0;
+            bool hasPreset = in.get<uint8_t>() != 0;
+            auto name = in.getString();
+            auto presetPath = in.getString();
+            auto type = in.getString();
+            if (hasPreset)
+                stream.preset = Preset(name, presetPath, type);
+            stream.governor.maxNoteMillis = in.get<int32_t>();
+            stream.governor.maxVoices = in.get<int32_t>();
+            stream.governor.maxNotesPerSecond = in.get<int32_t>();
+            stream.parameters.resize(in.getCount());
+            for (auto& parameter: stream.parameters) {
+                parameter.first = in.getString();
+                parameter.second = in.get<float>();
+            }
+            auto state = in.getString();
+            stream.pluginState.replaceAll(state.data(), state.size());
+        }
+    }
+    if (!in.ok) {
+        error = path + " is truncated";
+        sessions.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef ENGINESNAPSHOT_H
+#define ENGINESNAPSHOT_H
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <juce_core/juce_core.h>
+
+#include "../audio_engine/utils/MidiGovernor.h"
+#include "../utils/PluginEnum.h"
+#include "../utils/serum/Presets.h"
+
+// Everything needed to bring the host's streams back after a restart without going through the
+// plugin scan, preset files or the composer: per session its port block, per stream its routing
+// (id, port, role, AI or user, plugin and backend, paused), preset identity, governor limits, the
+// parameter values set through automation and the plugin's own state blob.
+//
+// File layout (little endian): "SHSNAP02" (the digits are the format version), uint32 sampleRate,
+// uint32 blockSize, uint32 session count, then per session
+//   str id | int32 basePort | uint32 stream count
+// and per stream
+//   int32 id | int32 port | str role | uint8 ai
+//   | str plugin name | str plugin path | uint8 backend | uint8 serum presets | uint8 paused
+//   | uint8 has preset | str name | str path | str type
+//   | int32 max note ms | int32 max voices | int32 max notes per second
+//   | uint32 parameter count | (str id | float value)... | uint32 state size | state
+// where str is a uint32 length followed by the bytes. write() goes through a temporary file and
+// a rename, so a crash mid-write leaves the previous snapshot intact.
+struct EngineSnapshot {
+    static constexpr char MAGIC[9] = "SHSNAP02";
+
+    struct Stream {
+        int id = 0;
+        int port = 0;
+        std::string role;
+        bool ai = false;
+        PluginDef plugin = PluginEnum::SERUM_LAPTOP;
+        bool paused = false;
+        std::optional<Preset> preset;
+        MidiGovernor::Config governor;
+        std::vector<std::pair<std::string, float>> parameters;
+        juce::MemoryBlock pluginState;
+    };
+
+    struct Session {
+        std::string id;
+        int basePort = 0;
+        std::vector<Stream> streams;
+    };
+
+    uint32_t sampleRate = 48000;
+    uint32_t blockSize = 512;
+    std::vector<Session> sessions;
+
+    bool write(const std::string& path, std::string& error) const;
+
+    bool read(const std::string& path, std::string& error);
+
+    size_t streamCount() const;
+};
+
+#endif //ENGINESNAPSHOT_H
@@ -0,0 +1,157 @@
+#include "SessionRecorder.h"
+#include "../executor/ThreadPolicy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    template <typename T>
+    void put(std::vector<char>& out, T value) {
+        const char* raw = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), raw, raw + sizeof(T));
+    }
+
+    std::vector<char> midiPayload(const juce::MidiMessage& message) {
+        std::vector<char> payload(4, 0);
+        auto size = std::min(message.getRawDataSize(), 3);
+        payload[0] = char(size);
+        std::memcpy(payload.data() + 1, message.getRawData(), (size_t) size);
+        return payload;
+    }
+}
+
+SessionRecorder& SessionRecorder::instance() {
+    static SessionRecorder recorder;
+    return recorder;
+}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const std::string& path, double rate) {
+    if (recording.load())
+        return false;
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "Could not open capture file " << path << std::endl;
+        return false;
+    }
+    sampleRate = rate;
+    file.write(MAGIC, 8);
+    auto sr = uint32_t(rate);
+    file.write(reinterpret_cast<const char*>(&sr), sizeof(sr));
+    startedAt = std::chrono::steady_clock::now();
+    recording.store(true);
+    flushThread = std::thread([this]() { flushLoop(); });
+    std::cout << "Capturing session traffic to " << path << std::endl;
+    return true;
+}
+
+void SessionRecorder::stop() {
+    if (!recording.exchange(false))
+        return;
+    if (flushThread.joinable())
+        flushThread.join();
+    flush();
+    file.close();
+}
+
+int SessionRecorder::addEngine(int streamId, bool isAI, int port, const PluginDef& plugin) {
+    if (!isRecording())
+        return -1;
+    int engine = nextEngine.fetch_add(1);
+    std::vector<char> payload;
+    put<int32_t>(payload, streamId);
+    put<uint8_t>(payload, isAI ? 1 : 0);
+    put<int32_t>(payload, port);
+    put<uint8_t>(payload, uint8_t(plugin.backend));
+    put<uint8_t>(payload, plugin.serumPresets ? 1 : 0);
+    std::string names = plugin.name + '\0' + plugin.path;
+    payload.insert(payload.end(), names.begin(), names.end());
+    append(RecordType::ENGINE, engine, payload.data(), payload.size());
+    return engine;
+}
+
+void SessionRecorder::recordSession(int engine, const std::string& sessionID) {
+    append(RecordType::SESSION, engine, sessionID.data(), sessionID.size());
+}
+
+void SessionRecorder::recordUserMidi(int engine, const juce::MidiMessage& message,
+                                     std::chrono::steady_clock::time_point at) {
+    auto payload = midiPayload(message);
+    append(RecordType::USER_MIDI, engine, payload.data(), payload.size(), at);
+}
+
+void SessionRecorder::recordAiMidi(int engine, const juce::MidiMessage& message, int delaySamples, uint64_t phraseId) {
+    auto payload = midiPayload(message);
+    put<int32_t>(payload, delaySamples);
+    put<uint64_t>(payload, phraseId);
+    append(RecordType::AI_MIDI, engine, payload.data(), payload.size());
+}
+
+void SessionRecorder::recordCancel(int engine, uint64_t phraseId) {
+    append(RecordType::CANCEL_PHRASE, engine, &phraseId, sizeof(phraseId));
+}
+
+void SessionRecorder::recordPreset(int engine, const Preset& preset) {
+    std::string payload = preset.name + '\0' + preset.path + '\0' + preset.type;
+    append(RecordType::PRESET, engine, payload.data(), payload.size());
+}
+
+void SessionRecorder::recordGovernor(int engine, int maxNoteMillis, int maxVoices, int maxNotesPerSecond) {
+    std::vector<char> payload;
+    put<int32_t>(payload, maxNoteMillis);
+    put<int32_t>(payload, maxVoices);
+    put<int32_t>(payload, maxNotesPerSecond);
+    append(RecordType::GOVERNOR, engine, payload.data(), payload.size());
+}
+
+void SessionRecorder::recordControl(const std::string& message) {
+    append(RecordType::CONTROL, NO_ENGINE, message.data(), message.size());
+}
+
+void SessionRecorder::append(RecordType type, int engine, const void* payload, size_t size,
+                             std::chrono::steady_clock::time_point at) {
+    if (!isRecording() || engine < 0 || size > 0xffff)
+        return;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(at - startedAt).count();
+    auto sample = uint64_t(std::max<int64_t>(0, int64_t(double(elapsed) * sampleRate / 1e9)));
+
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    put<uint64_t>(buffer, sample);
+    put<uint8_t>(buffer, uint8_t(type));
+    put<uint16_t>(buffer, uint16_t(engine));
+    put<uint16_t>(buffer, uint16_t(size));
+    const char* raw = static_cast<const char*>(payload);
+    buffer.insert(buffer.end(), raw, raw + size);
+    records.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SessionRecorder::flushLoop() {
+    ThreadPolicy::instance().applyToCurrentThread(ThreadPolicy::Role::LOGGING);
+    while (recording.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        flush();
+    }
+}
+
+void SessionRecorder::flush() {
+    std::vector<char> pending;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        pending.swap(buffer);
+    }
+    if (pending.empty())
+        return;
+    file.write(pending.data(), std::streamsize(pending.size()));
+    file.flush();
+    bytes.fetch_add(int64_t(pending.size()), std::memory_order_relaxed);
+}
+
+void SessionRecorder::printStats() const {
+    if (!isRecording())
+        return;
+    std::cout << "[capture] records " << records.load() << " | written " << bytes.load() << " bytes" << std::endl;
+}
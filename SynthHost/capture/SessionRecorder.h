@@ -0,0 +1,84 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "../utils/PluginEnum.h"
+#include "../utils/serum/Presets.h"
+
+// Process-wide recorder of everything that drives the audio engines: user MIDI, composer events,
+// phrase cancels, preset changes, governor limits and the raw control messages. Each record is
+// stamped with the host sample clock (samples since capture start at the capture sample rate)
+// and appended to a compact binary log that SessionReplay can play back offline.
+//
+// File layout (little endian): "SHCAP001", uint32 sampleRate, then records of
+//   uint64 sample | uint8 type | uint16 engine | uint16 payload length | payload
+// Engines are numbered in the order they were created; engine NO_ENGINE marks host-wide records.
+class SessionRecorder {
+public:
+    enum class RecordType : uint8_t {
+        ENGINE = 1,     // int32 stream id, uint8 ai, int32 port, uint8 backend, uint8 serum presets,
+                        // plugin name and path '\0' separated (older captures end after the port)
+        SESSION,        // session id
+        USER_MIDI,      // uint8 size, 3 bytes
+        AI_MIDI,        // uint8 size, 3 bytes, int32 delay samples, uint64 phrase id
+        CANCEL_PHRASE,  // uint64 phrase id
+        PRESET,         // preset name, path and type, '\0' separated
+        GOVERNOR,       // int32 max note ms, int32 max voices, int32 max notes per second
+        CONTROL         // raw control message (json text)
+    };
+
+    static constexpr uint16_t NO_ENGINE = 0xffff;
+    static constexpr char MAGIC[9] = "SHCAP001";
+
+    static SessionRecorder& instance();
+
+    bool start(const std::string& path, double sampleRate);
+
+    void stop();
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    // Returns the engine's capture id, or -1 when not recording.
+    int addEngine(int streamId, bool isAI, int port, const PluginDef& plugin);
+
+    void recordSession(int engine, const std::string& sessionID);
+    void recordUserMidi(int engine, const juce::MidiMessage& message, std::chrono::steady_clock::time_point at);
+    void recordAiMidi(int engine, const juce::MidiMessage& message, int delaySamples, uint64_t phraseId);
+    void recordCancel(int engine, uint64_t phraseId);
+    void recordPreset(int engine, const Preset& preset);
+    void recordGovernor(int engine, int maxNoteMillis, int maxVoices, int maxNotesPerSecond);
+    void recordControl(const std::string& message);
+
+    void printStats() const;
+
+private:
+    SessionRecorder() = default;
+    ~SessionRecorder();
+
+    void append(RecordType type, int engine, const void* payload, size_t size,
+                std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now());
+    void flushLoop();
+    void flush();
+
+    std::atomic<bool> recording{false};
+    std::chrono::steady_clock::time_point startedAt;
+    double sampleRate = 48000.0;
+    std::atomic<int> nextEngine{0};
+
+    std::mutex bufferMutex;
+    std::vector<char> buffer;
+    std::ofstream file;
+    std::thread flushThread;
+    std::atomic<int64_t> records{0};
+    std::atomic<int64_t> bytes{0};
+};
+
+#endif //SESSIONRECORDER_H
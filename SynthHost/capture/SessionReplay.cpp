@@ -0,0 +1,280 @@
+#include "SessionReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "SessionRecorder.h"
+#include "../audio_engine/HeadlessAudioEngine.h"
+#include "../utils/LatencyStats.h"
+#include "../vst_hosting/PluginManager.h"
+
+namespace {
+    using RecordType = SessionRecorder::RecordType;
+
+    struct Record {
+        uint64_t sample;
+        RecordType type;
+        uint16_t engine;
+        std::string payload;
+    };
+
+    struct ReplayEngine {
+        int streamId = 0;
+        bool isAI = false;
+        std::string session;
+        PluginDef plugin = PluginEnum::SERUM_LAPTOP;
+        std::unique_ptr<HeadlessAudioEngine> engine;
+        // rendered from its ENGINE record on, while not paused or destroyed
+        bool created = false;
+        bool paused = false;
+        bool destroyed = false;
+        juce::MidiBuffer userMidi;
+        std::vector<int64_t> blockMicros;
+    };
+
+    template <typename T>
+    T get(const std::string& payload, size_t offset) {
+        T value{};
+        if (offset + sizeof(T) <= payload.size())
+            std::memcpy(&value, payload.data() + offset, sizeof(T));
+        return value;
+    }
+
+    bool parse(const std::string& path, double& sampleRate, std::vector<Record>& records) {
+        std::ifstream file(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < 12 || data.compare(0, 8, SessionRecorder::MAGIC) != 0) {
+            std::cout << path << " is not a session capture" << std::endl;
+            return false;
+        }
+        sampleRate = get<uint32_t>(data, 8);
+        size_t pos = 12;
+        constexpr size_t headerSize = 8 + 1 + 2 + 2;
+        while (pos + headerSize <= data.size()) {
+            Record record;
+            record.sample = get<uint64_t>(data, pos);
+            record.type = RecordType(get<uint8_t>(data, pos + 8));
+            record.engine = get<uint16_t>(data, pos + 9);
+            auto size = get<uint16_t>(data, pos + 11);
+            pos += headerSize;
+            if (pos + size > data.size())
+                break;
+            record.payload = data.substr(pos, size);
+            pos += size;
+            records.push_back(std::move(record));
+        }
+        // records are appended from several threads, so neighbours can be slightly out of order
+        std::stable_sort(records.begin(), records.end(),
+                         [](const Record& a, const Record& b) { return a.sample < b.sample; });
+        return true;
+    }
+
+    juce::MidiMessage midiFrom(const std::string& payload) {
+        auto size = std::min<int>(get<uint8_t>(payload, 0), 3);
+        return juce::MidiMessage(payload.data() + 1, size);
+    }
+
+    // the plugin the engine was hosted on; captures from before it was recorded fall back to Serum
+    PluginDef pluginFrom(const std::string& payload) {
+        constexpr size_t pluginOffset = 4 + 1 + 4;
+        if (payload.size() <= pluginOffset + 2)
+            return PluginEnum::SERUM_LAPTOP;
+        auto backend = PluginDef::Backend(get<uint8_t>(payload, pluginOffset));
+        auto names = payload.substr(pluginOffset + 2);
+        auto separator = names.find('\0');
+        PluginDef plugin(names.substr(0, separator),
+                         separator == std::string::npos ? std::string() : names.substr(separator + 1));
+        plugin.serumPresets = get<uint8_t>(payload, pluginOffset + 1) != 0;
+        return backend == PluginDef::Backend::JUCE ? plugin : plugin.withBackend(backend);
+    }
+
+    int64_t percentile(std::vector<int64_t> values, double p) {
+        if (values.empty()) return 0;
+        auto index = size_t(p * double(values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + long(index), values.end());
+        return values[index];
+    }
+}
+
+int SessionReplay::run(const std::string& path, const Options& options) {
+    double sampleRate = 0;
+    std::vector<Record> records;
+    if (!parse(path, sampleRate, records))
+        return 1;
+    const int blockSize = options.blockSize;
+    std::cout << "Replaying " << records.size() << " records from " << path << " at " << sampleRate
+              << " Hz, " << blockSize << "-sample blocks, " << (options.realtime ? "real time" : "as fast as possible")
+              << std::endl;
+
+    // every engine is loaded up front so plugin loads don't land inside the measured blocks; each one
+    // only renders once the capture reaches its ENGINE record
+    PluginManager pluginManager;
+    std::map<uint16_t, ReplayEngine> engines;
+    for (const auto& record: records) {
+        if (record.type != RecordType::ENGINE)
+            continue;
+        auto& replay = engines[record.engine];
+        replay.streamId = get<int32_t>(record.payload, 0);
+        replay.isAI = get<uint8_t>(record.payload, 4) != 0;
+        replay.plugin = pluginFrom(record.payload);
+        juce::String error;
+        std::unique_ptr<juce::AudioPluginInstance> plugin;
+        try {
+            plugin = pluginManager.loadPlugin(replay.plugin, sampleRate, blockSize, error);
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+        if (plugin == nullptr) {
+            std::cout << "Could not load " << replay.plugin.name << " (" << replay.plugin.path << ") for engine "
+                      << record.engine << ": " << error << std::endl;
+            return 1;
+        }
+        replay.engine = std::make_unique<HeadlessAudioEngine>(sampleRate, blockSize);
+        replay.engine->enableAIMidiInjection(replay.isAI);
+        replay.engine->setPlugin(std::move(plugin));
+        replay.engine->prepareOffline();
+        replay.userMidi.ensureSize(1024);
+    }
+    if (engines.empty()) {
+        std::cout << "Capture contains no engines" << std::endl;
+        return 1;
+    }
+
+    // Control messages only drive the stream lifecycle here. Everything else they cause (sessions,
+    // presets, governor limits, parameter changes) reaches the engines as records of its own.
+    std::cout << "Control messages: pause, resume, destroy and close_session are replayed; the rest are "
+                 "printed only, their effect on the engines is replayed from the engine records" << std::endl;
+    auto control = [&](const Record& record) {
+        auto j = nlohmann::json::parse(record.payload, nullptr, false);
+        auto action = j.is_object() ? j.value("action", "") : "";
+        bool lifecycle = action == "pause" || action == "resume" || action == "destroy" || action == "close_session";
+        std::cout << "[replay " << double(record.sample) / sampleRate << " s] " << record.payload
+                  << (lifecycle ? "" : " (not replayed)") << std::endl;
+        if (!lifecycle)
+            return;
+        auto session = j.value("session", "default");
+        int stream = j.contains("stream") && j["stream"].is_number_integer() ? j["stream"].get<int>() : -1;
+        for (auto& entry: engines) {
+            auto& replay = entry.second;
+            if (!replay.created || replay.destroyed || (replay.session.empty() ? "default" : replay.session) != session)
+                continue;
+            if (action == "close_session" || (action == "destroy" && replay.streamId == stream))
+                replay.destroyed = true;
+            else if (replay.streamId == stream)
+                replay.paused = action == "pause";
+        }
+    };
+
+    LatencyStats presetLoads;
+    auto apply = [&](const Record& record, int64_t blockStart) {
+        if (record.type == RecordType::CONTROL)
+            return control(record);
+        auto it = engines.find(record.engine);
+        if (it == engines.end())
+            return;
+        auto& replay = it->second;
+        switch (record.type) {
+            case RecordType::ENGINE:
+                replay.created = true;
+                break;
+            case RecordType::SESSION:
+                replay.session = record.payload;
+                break;
+            case RecordType::USER_MIDI: {
+                // live, input arriving during one block is rendered in the next
+                auto offset = std::clamp<int64_t>(int64_t(record.sample) - (blockStart - blockSize), 0, blockSize - 1);
+                auto message = midiFrom(record.payload);
+                replay.userMidi.addEvent(message, int(offset));
+                break;
+            }
+            case RecordType::AI_MIDI:
+                replay.engine->enqueueMidi(midiFrom(record.payload), get<int32_t>(record.payload, 4),
+                                           get<uint64_t>(record.payload, 8));
+                break;
+            case RecordType::CANCEL_PHRASE:
+                replay.engine->cancelPhrase(get<uint64_t>(record.payload, 0));
+                break;
+            case RecordType::PRESET: {
+                auto first = record.payload.find('\0');
+                auto second = record.payload.find('\0', first + 1);
+                Preset preset(record.payload.substr(0, first),
+                              record.payload.substr(first + 1, second - first - 1),
+                              record.payload.substr(second + 1));
+                auto started = std::chrono::steady_clock::now();
+                replay.engine->setPreset(preset);
+                presetLoads.record(started);
+                break;
+            }
+            case RecordType::GOVERNOR:
+                replay.engine->setGovernorConfig({get<int32_t>(record.payload, 0), get<int32_t>(record.payload, 4),
+                                                  get<int32_t>(record.payload, 8)});
+                break;
+            default:
+                break;
+        }
+    };
+
+    const int64_t end = int64_t(records.back().sample) + int64_t(options.tailSeconds * sampleRate);
+    const auto blockDuration = std::chrono::duration<double>(double(blockSize) / sampleRate);
+    const auto started = std::chrono::steady_clock::now();
+    size_t next = 0;
+    for (int64_t cursor = 0; cursor < end; cursor += blockSize) {
+        // a record is visible to the first block that starts after it, as on the live host
+        while (next < records.size() && int64_t(records[next].sample) < cursor)
+            apply(records[next++], cursor);
+
+        for (auto& entry: engines) {
+            auto& replay = entry.second;
+            if (!replay.created || replay.paused || replay.destroyed) {
+                replay.userMidi.clear();
+                continue;
+            }
+            auto blockStarted = std::chrono::steady_clock::now();
+            replay.engine->renderOffline(replay.userMidi, blockSize);
+            replay.blockMicros.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - blockStarted).count());
+            replay.userMidi.clear();
+        }
+
+        if (options.realtime)
+            std::this_thread::sleep_until(started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                blockDuration * double((cursor + blockSize) / blockSize)));
+    }
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    const double audioSeconds = double(end) / sampleRate;
+    const auto budgetMicros = int64_t(1e6 * blockSize / sampleRate);
+
+    std::cout << "Rendered " << audioSeconds << " s of audio on " << engines.size() << " engines in "
+              << wallSeconds << " s (" << audioSeconds / wallSeconds << "x real time), block budget "
+              << budgetMicros << " us" << std::endl;
+    for (auto& entry: engines) {
+        auto& replay = entry.second;
+        auto& micros = replay.blockMicros;
+        int64_t total = 0, overruns = 0;
+        for (auto m: micros) {
+            total += m;
+            if (m > budgetMicros) ++overruns;
+        }
+        std::cout << "  engine " << entry.first << " (stream " << replay.streamId
+                  << (replay.isAI ? ", ai" : ", user") << ", " << replay.plugin.name
+                  << (replay.session.empty() ? "" : ", session " + replay.session)
+                  << "): blocks " << micros.size()
+                  << " | avg " << (micros.empty() ? 0 : total / int64_t(micros.size()))
+                  << " us | p50 " << percentile(micros, 0.5)
+                  << " us | p99 " << percentile(micros, 0.99)
+                  << " us | max " << (micros.empty() ? 0 : *std::max_element(micros.begin(), micros.end()))
+                  << " us | over budget " << overruns << std::endl;
+        replay.engine->printStats();
+    }
+    if (presetLoads.count() > 0)
+        std::cout << "  preset loads: " << presetLoads.summary() << std::endl;
+    return 0;
+}
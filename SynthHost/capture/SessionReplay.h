@@ -0,0 +1,23 @@
+#ifndef SESSIONREPLAY_H
+#define SESSIONREPLAY_H
+#include <string>
+
+// Plays a SessionRecorder capture back through freshly loaded HeadlessAudioEngines without
+// audio devices or sockets, block by block on the capture's sample clock, and reports what
+// each engine's blocks cost to render. An engine renders from the point it was created until its
+// stream is paused or destroyed; other control messages are printed, not replayed. Fast mode
+// renders as quickly as possible; real-time mode paces blocks to the wall clock like the live host.
+class SessionReplay {
+public:
+    struct Options {
+        bool realtime = false;
+        // engine block size of the captured host (2 * BLOCK_SIZE)
+        int blockSize = 1024;
+        // keeps rendering this long after the last record so releases and tails are included
+        double tailSeconds = 2.0;
+    };
+
+    static int run(const std::string& path, const Options& options);
+};
+
+#endif //SESSIONREPLAY_H
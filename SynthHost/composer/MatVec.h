@@ -0,0 +1,80 @@
+#ifndef MATVEC_H
+#define MATVEC_H
+#include <cmath>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define MATVEC_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MATVEC_SSE2 1
+#endif
+
+// Dense float kernels for the native composer. Matrices are row-major; y += W * x.
+// AVX2+FMA when the build enables it (SYNTHHOST_AVX2), SSE2 on any x64 build, scalar otherwise.
+namespace MatVec {
+
+    inline float dot(const float* a, const float* b, int n) {
+        int i = 0;
+        float sum = 0.0f;
+#if MATVEC_AVX2
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (; i + 16 <= n; i += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+        __m256 acc = _mm256_add_ps(acc0, acc1);
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        sum = _mm_cvtss_f32(half);
+#elif MATVEC_SSE2
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+        __m128 acc = _mm_add_ps(acc0, acc1);
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        sum = _mm_cvtss_f32(acc);
+#endif
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    inline void matVecAdd(const float* w, int rows, int cols, const float* x, float* y) {
+        for (int r = 0; r < rows; ++r)
+            y[r] += dot(w + (size_t) r * cols, x, cols);
+    }
+
+    // Reference version for benchmarks and checks.
+    inline void matVecAddScalar(const float* w, int rows, int cols, const float* x, float* y) {
+        for (int r = 0; r < rows; ++r) {
+            const float* row = w + (size_t) r * cols;
+            float sum = 0.0f;
+            for (int c = 0; c < cols; ++c)
+                sum += row[c] * x[c];
+            y[r] += sum;
+        }
+    }
+
+    inline float sigmoid(float v) {
+        return 1.0f / (1.0f + std::exp(-v));
+    }
+
+    inline const char* isa() {
+#if MATVEC_AVX2
+        return "avx2+fma";
+#elif MATVEC_SSE2
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+}
+
+#endif //MATVEC_H
@@ -0,0 +1,271 @@
+#include "MusicRNN.h"
+#include "MatVec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    constexpr char MAGIC[8] = {'M', 'R', 'N', 'N', '0', '0', '0', '1'};
+
+    bool readFloats(std::ifstream& in, std::vector<float>& out, size_t count) {
+        out.resize(count);
+        in.read(reinterpret_cast<char*>(out.data()), (std::streamsize) (count * sizeof(float)));
+        return (bool) in;
+    }
+}
+
+bool MusicRNN::load(const std::string& path, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    char magic[8];
+    uint32_t dims[8];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+    if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " is not an exported MusicRNN (run src/composer/export_weights.py)";
+        return false;
+    }
+    vocab = (int) dims[0];
+    roles = (int) dims[1];
+    numKeys = (int) dims[2];
+    embedDim = (int) dims[3];
+    roleDim = (int) dims[4];
+    keyDim = (int) dims[5];
+    hidden = (int) dims[6];
+    layers = (int) dims[7];
+    if (vocab != TIME_SHIFT + 101 || roles != (int) std::size(ROLES) || numKeys <= 0 || hidden <= 0 || layers <= 0) {
+        error = "unexpected model shape in " + path;
+        vocab = 0;
+        return false;
+    }
+
+    keys.clear();
+    for (int k = 0; k < numKeys; ++k) {
+        uint32_t length = 0;
+        in.read(reinterpret_cast<char*>(&length), sizeof(length));
+        std::string name(length, '\0');
+        in.read(name.data(), length);
+        keys.push_back(name);
+    }
+
+    const size_t gates = (size_t) 4 * hidden;
+    bool ok = readFloats(in, embed, (size_t) vocab * embedDim)
+              && readFloats(in, roleEmbed, (size_t) roles * roleDim)
+              && readFloats(in, keyEmbed, (size_t) numKeys * keyDim);
+    weightIh.assign(layers, {});
+    weightHh.assign(layers, {});
+    biasIh.assign(layers, {});
+    biasHh.assign(layers, {});
+    for (int l = 0; ok && l < layers; ++l) {
+        size_t inputs = l == 0 ? (size_t) embedDim + roleDim + keyDim : (size_t) hidden;
+        ok = readFloats(in, weightIh[l], gates * inputs)
+             && readFloats(in, weightHh[l], gates * hidden)
+             && readFloats(in, biasIh[l], gates)
+             && readFloats(in, biasHh[l], gates);
+    }
+    ok = ok && readFloats(in, fcWeight, (size_t) vocab * hidden) && readFloats(in, fcBias, (size_t) vocab);
+    if (!ok) {
+        error = path + " is truncated";
+        vocab = 0;
+        return false;
+    }
+
+    prepare();
+    return true;
+}
+
+void MusicRNN::randomize(int keyCount, uint32_t seed) {
+    static const char* tonics[] = {"c", "c#", "d", "d#", "e", "f", "f#", "g", "g#", "a", "a#", "b"};
+
+    vocab = TIME_SHIFT + 101;
+    roles = (int) std::size(ROLES);
+    numKeys = std::max(1, keyCount);
+    embedDim = 128;
+    roleDim = 32;
+    keyDim = 16;
+    hidden = 256;
+    layers = 2;
+
+    keys.clear();
+    for (int k = 0; k < numKeys; ++k)
+        keys.push_back(std::string(tonics[k % 12]) + (k % 24 >= 12 ? "min" : ""));
+
+    // PyTorch's default init: N(0, 1) embeddings, U(-1/sqrt(H), 1/sqrt(H)) for the rest
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> uniform(-1.0f / std::sqrt((float) hidden), 1.0f / std::sqrt((float) hidden));
+    auto fill = [&](std::vector<float>& v, size_t n, bool isEmbedding) {
+        v.resize(n);
+        for (auto& x : v)
+            x = isEmbedding ? normal(rng) : uniform(rng);
+    };
+
+    const size_t gates = (size_t) 4 * hidden;
+    fill(embed, (size_t) vocab * embedDim, true);
+    fill(roleEmbed, (size_t) roles * roleDim, true);
+    fill(keyEmbed, (size_t) numKeys * keyDim, true);
+    weightIh.assign(layers, {});
+    weightHh.assign(layers, {});
+    biasIh.assign(layers, {});
+    biasHh.assign(layers, {});
+    for (int l = 0; l < layers; ++l) {
+        size_t inputs = l == 0 ? (size_t) embedDim + roleDim + keyDim : (size_t) hidden;
+        fill(weightIh[l], gates * inputs, false);
+        fill(weightHh[l], gates * hidden, false);
+        fill(biasIh[l], gates, false);
+        fill(biasHh[l], gates, false);
+    }
+    fill(fcWeight, (size_t) vocab * hidden, false);
+    fill(fcBias, (size_t) vocab, false);
+
+    prepare();
+}
+
+void MusicRNN::prepare() {
+    const int gates = 4 * hidden;
+    const int inputs0 = embedDim + roleDim + keyDim;
+    const int conditioning = roleDim + keyDim;
+
+    // Layer 0 input is [embed(token); role; key]. Split its W_ih by columns: the token part becomes
+    // a lookup table, the role/key part is applied once per generation in start().
+    tokenGates.assign((size_t) vocab * gates, 0.0f);
+    contextWeight.resize((size_t) gates * conditioning);
+    std::vector<float> tokenWeight((size_t) gates * embedDim);
+    for (int r = 0; r < gates; ++r) {
+        const float* row = weightIh[0].data() + (size_t) r * inputs0;
+        std::copy(row, row + embedDim, tokenWeight.begin() + (size_t) r * embedDim);
+        std::copy(row + embedDim, row + inputs0, contextWeight.begin() + (size_t) r * conditioning);
+    }
+    for (int t = 0; t < vocab; ++t)
+        MatVec::matVecAdd(tokenWeight.data(), gates, embedDim, embed.data() + (size_t) t * embedDim,
+                          tokenGates.data() + (size_t) t * gates);
+
+    // Layers above take [h_below; h_self] against [W_ih | W_hh], one mat-vec per step
+    stackedWeight.assign(layers, {});
+    summedBias.assign(layers, {});
+    for (int l = 0; l < layers; ++l) {
+        summedBias[l].resize(gates);
+        for (int r = 0; r < gates; ++r)
+            summedBias[l][r] = biasIh[l][r] + biasHh[l][r];
+        if (l == 0)
+            continue;
+        stackedWeight[l].resize((size_t) gates * 2 * hidden);
+        for (int r = 0; r < gates; ++r) {
+            float* row = stackedWeight[l].data() + (size_t) r * 2 * hidden;
+            std::copy_n(weightIh[l].data() + (size_t) r * hidden, hidden, row);
+            std::copy_n(weightHh[l].data() + (size_t) r * hidden, hidden, row + hidden);
+        }
+    }
+}
+
+int MusicRNN::roleIndex(const std::string& role) const {
+    for (int r = 0; r < (int) std::size(ROLES); ++r)
+        if (role == ROLES[r])
+            return r;
+    return -1;
+}
+
+int MusicRNN::keyIndex(const std::string& key) const {
+    auto it = std::find(keys.begin(), keys.end(), key);
+    return it == keys.end() ? -1 : (int) (it - keys.begin());
+}
+
+MusicRNN::State MusicRNN::start(int role, int key) const {
+    const int gates = 4 * hidden;
+    State state;
+    state.h.assign((size_t) layers * hidden, 0.0f);
+    state.c.assign((size_t) layers * hidden, 0.0f);
+    state.gates.resize(gates);
+    state.concat.resize((size_t) 2 * hidden);
+    state.logits.resize(vocab);
+    state.probs.resize(vocab);
+
+    std::vector<float> conditioning(roleDim + keyDim);
+    std::copy_n(roleEmbed.data() + (size_t) role * roleDim, roleDim, conditioning.begin());
+    std::copy_n(keyEmbed.data() + (size_t) key * keyDim, keyDim, conditioning.begin() + roleDim);
+    state.context = summedBias[0];
+    MatVec::matVecAdd(contextWeight.data(), gates, roleDim + keyDim, conditioning.data(), state.context.data());
+    return state;
+}
+
+void MusicRNN::feed(State& state, int token) const {
+    const int gates = 4 * hidden;
+    float* g = state.gates.data();
+
+    for (int l = 0; l < layers; ++l) {
+        float* h = state.h.data() + (size_t) l * hidden;
+        float* c = state.c.data() + (size_t) l * hidden;
+
+        if (l == 0) {
+            const float* tokenRow = tokenGates.data() + (size_t) token * gates;
+            for (int r = 0; r < gates; ++r)
+                g[r] = state.context[r] + tokenRow[r];
+            MatVec::matVecAdd(weightHh[0].data(), gates, hidden, h, g);
+        } else {
+            std::copy_n(state.h.data() + (size_t) (l - 1) * hidden, hidden, state.concat.begin());
+            std::copy_n(h, hidden, state.concat.begin() + hidden);
+            std::copy(summedBias[l].begin(), summedBias[l].end(), g);
+            MatVec::matVecAdd(stackedWeight[l].data(), gates, 2 * hidden, state.concat.data(), g);
+        }
+
+        // PyTorch gate order: input, forget, cell, output
+        for (int j = 0; j < hidden; ++j) {
+            float i = MatVec::sigmoid(g[j]);
+            float f = MatVec::sigmoid(g[hidden + j]);
+            float z = std::tanh(g[2 * hidden + j]);
+            float o = MatVec::sigmoid(g[3 * hidden + j]);
+            c[j] = f * c[j] + i * z;
+            h[j] = o * std::tanh(c[j]);
+        }
+    }
+}
+
+int MusicRNN::sample(State& state, float temperature, std::mt19937& rng) const {
+    const float* top = state.h.data() + (size_t) (layers - 1) * hidden;
+    std::copy(fcBias.begin(), fcBias.end(), state.logits.begin());
+    MatVec::matVecAdd(fcWeight.data(), vocab, hidden, top, state.logits.data());
+
+    const float scale = 1.0f / std::max(temperature, 1e-3f);
+    float maxLogit = state.logits[0];
+    for (int t = 1; t < vocab; ++t)
+        maxLogit = std::max(maxLogit, state.logits[t]);
+    double sum = 0.0;
+    for (int t = 0; t < vocab; ++t) {
+        state.probs[t] = std::exp((double) (state.logits[t] - maxLogit) * scale);
+        sum += state.probs[t];
+    }
+
+    double u = std::uniform_real_distribution<double>(0.0, sum)(rng);
+    for (int t = 0; t < vocab; ++t) {
+        u -= state.probs[t];
+        if (u < 0.0)
+            return t;
+    }
+    return vocab - 1;
+}
+
+std::vector<int> MusicRNN::generate(const std::vector<int>& seed, int role, int key, int length, float temperature,
+                                    std::mt19937& rng) const {
+    std::vector<int> out;
+    if (seed.empty())
+        return out;
+
+    State state = start(role, key);
+    for (int token : seed)
+        feed(state, token);
+
+    // like the Python version, the last seed token is fed once more before sampling starts
+    int last = seed.back();
+    out.reserve(length);
+    for (int n = 0; n < length; ++n) {
+        feed(state, last);
+        last = sample(state, temperature, rng);
+        out.push_back(last);
+    }
+    return out;
+}
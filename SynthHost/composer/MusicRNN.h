@@ -0,0 +1,76 @@
+#ifndef MUSICRNN_H
+#define MUSICRNN_H
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// C++ inference for SynthComposer's MusicRNN (src/composer/music_rnn.py): token embedding plus
+// role and key embeddings into a stacked LSTM and a linear head over the event vocabulary.
+// Weights come from the flat file written by src/composer/export_weights.py.
+//
+// At load time the first layer's input projection is folded into a per-token table (and the
+// role/key part into a per-generation context vector), so a step costs one recurrent mat-vec
+// per layer plus the head.
+class MusicRNN {
+public:
+    // vocabulary layout, as in music_rnn.py
+    static constexpr int NOTE_ON = 0;
+    static constexpr int NOTE_OFF = 128;
+    static constexpr int TIME_SHIFT = 256;
+    static constexpr int TIME_SHIFT_MS = 10;
+    static constexpr const char* ROLES[] = {"bass", "lead", "pad", "pluck"};
+
+    struct State {
+        std::vector<float> h;        // layers * hidden
+        std::vector<float> c;        // layers * hidden
+        std::vector<float> context;  // role/key + bias part of layer 0's gates
+        std::vector<float> gates;
+        std::vector<float> concat;
+        std::vector<float> logits;
+        std::vector<double> probs;
+    };
+
+    bool load(const std::string& path, std::string& error);
+
+    // Random weights with the default shapes, for benchmarks without an exported model.
+    void randomize(int numKeys, uint32_t seed);
+
+    bool isLoaded() const { return vocab > 0; }
+
+    int roleIndex(const std::string& role) const;
+    int keyIndex(const std::string& key) const;
+    const std::vector<std::string>& getKeys() const { return keys; }
+    int getVocabSize() const { return vocab; }
+
+    State start(int role, int key) const;
+
+    // Advances the LSTM by one input token.
+    void feed(State& state, int token) const;
+
+    // Samples the next token from the output of the last feed().
+    int sample(State& state, float temperature, std::mt19937& rng) const;
+
+    // Same contract as music_rnn.generate(): prime on the seed, then feed back each sampled token.
+    std::vector<int> generate(const std::vector<int>& seed, int role, int key, int length, float temperature,
+                              std::mt19937& rng) const;
+
+private:
+    void prepare();
+
+    int vocab = 0, roles = 0, numKeys = 0;
+    int embedDim = 0, roleDim = 0, keyDim = 0, hidden = 0, layers = 0;
+    std::vector<std::string> keys;
+
+    std::vector<float> embed, roleEmbed, keyEmbed;
+    std::vector<std::vector<float>> weightIh, weightHh, biasIh, biasHh;
+    std::vector<float> fcWeight, fcBias;
+
+    // derived at load
+    std::vector<float> tokenGates;                // vocab x 4H: layer 0 input projection per token
+    std::vector<float> contextWeight;             // 4H x (roleDim + keyDim)
+    std::vector<std::vector<float>> stackedWeight; // layer >= 1: [W_ih | W_hh], 4H x 2H
+    std::vector<std::vector<float>> summedBias;    // b_ih + b_hh per layer
+};
+
+#endif //MUSICRNN_H
@@ -0,0 +1,207 @@
+#include "NativeComposer.h"
+#include "MatVec.h"
+#include "../executor/ThreadPolicy.h"
+#include "../websocket/ClockSync.h"
+#include <iostream>
+
+NativeComposer::NativeComposer(std::shared_ptr<const MusicRNN> model, Sink sink, Config config)
+    : model(std::move(model)), sink(std::move(sink)), config(std::move(config)) {
+    if (!this->config.defaultKey.empty())
+        defaultKey = this->model->keyIndex(this->config.defaultKey);
+    if (defaultKey < 0) {
+        std::cout << "[composer] unknown key '" << this->config.defaultKey << "', using '"
+                  << this->model->getKeys().front() << "'" << std::endl;
+        defaultKey = 0;
+    }
+    worker = std::thread([this]() { workLoop(); });
+}
+
+NativeComposer::~NativeComposer() {
+    stop();
+}
+
+void NativeComposer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        running = false;
+    }
+    inboxReady.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+void NativeComposer::onUserNote(const std::string& session, const std::string& role, int note, int velocity,
+                                int64_t wallMillis, Clock::time_point capturedAt) {
+    Input input{Input::Type::NOTE, session, role, "", note, velocity, wallMillis, capturedAt};
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        inbox.push_back(std::move(input));
+    }
+    inboxReady.notify_one();
+}
+
+void NativeComposer::setKey(const std::string& session, const std::string& key) {
+    Input input{Input::Type::KEY, session, "", key};
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        inbox.push_back(std::move(input));
+    }
+    inboxReady.notify_one();
+}
+
+void NativeComposer::workLoop() {
+    ThreadPolicy::instance().applyToCurrentThread(ThreadPolicy::Role::WORKER);
+    std::deque<Input> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(inboxMutex);
+            inboxReady.wait(lock, [this]() { return !running || !inbox.empty(); });
+            if (!running)
+                return;
+            batch.swap(inbox);
+        }
+        for (const auto& input : batch)
+            handle(input);
+        batch.clear();
+    }
+}
+
+// Mirrors one iteration of WebSocketClient.py's receive loop.
+void NativeComposer::handle(const Input& input) {
+    auto inserted = sessions.try_emplace(input.session);
+    auto& session = inserted.first->second;
+    if (inserted.second) {
+        session.key = defaultKey;
+        session.lastGeneration = Clock::now();
+    }
+
+    if (input.type == Input::Type::KEY) {
+        int key = model->keyIndex(input.key);
+        if (key < 0) {
+            std::cout << "[composer] key '" << input.key << "' is not in the model" << std::endl;
+            return;
+        }
+        if (key != session.key)
+            cancelPhrases(input.session, session);
+        session.key = key;
+        return;
+    }
+
+    // the user switched instrument: what was queued for the old roles no longer fits
+    if (!input.role.empty() && input.role != session.userRole) {
+        if (!session.userRole.empty())
+            cancelPhrases(input.session, session);
+        session.userRole = input.role;
+    }
+    if (input.velocity > 0)
+        session.buffer.emplace_back(input.wallMillis, input.note);
+
+    auto now = Clock::now();
+    if (now - session.lastGeneration < config.period)
+        return;
+    session.lastGeneration = now;
+    if (session.buffer.empty())
+        return;
+    generate(input.session, session, input.capturedAt);
+    session.buffer.clear();
+}
+
+std::vector<int> NativeComposer::seedTokens(const SessionState& session) const {
+    std::vector<int> seed;
+    int64_t previous = session.buffer.front().first;
+    for (const auto& entry : session.buffer) {
+        auto steps = (entry.first - previous + MusicRNN::TIME_SHIFT_MS / 2) / MusicRNN::TIME_SHIFT_MS;
+        seed.insert(seed.end(), (size_t) std::max<int64_t>(0, steps), MusicRNN::TIME_SHIFT + 1);
+        seed.push_back(MusicRNN::NOTE_ON + entry.second);
+        previous = entry.first;
+    }
+    if (seed.size() > SEED_TOKENS)
+        seed.erase(seed.begin(), seed.end() - SEED_TOKENS);
+    return seed;
+}
+
+void NativeComposer::generate(const std::string& sessionID, SessionState& session, Clock::time_point trigger) {
+    auto started = Clock::now();
+    auto seed = seedTokens(session);
+    int64_t startMillis = ClockSync::nowMillis();
+
+    struct Voice {
+        int role;
+        int64_t phraseId;
+        int64_t time;
+        int last;
+        MusicRNN::State state;
+    };
+    std::vector<Voice> voices;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        if (session.userRole == MusicRNN::ROLES[r])
+            continue;
+        Voice voice{r, nextPhrase++, startMillis, seed.back(), model->start(r, session.key)};
+        for (int token : seed)
+            model->feed(voice.state, token);
+        session.phrases[r] = voice.phraseId;
+        voices.push_back(std::move(voice));
+    }
+
+    bool firstNote = true;
+    for (int n = 0; n < config.generateLength; ++n) {
+        for (auto& voice : voices) {
+            model->feed(voice.state, voice.last);
+            int token = model->sample(voice.state, config.temperature, rng);
+            voice.last = token;
+            if (token >= MusicRNN::TIME_SHIFT) {
+                voice.time += (token - MusicRNN::TIME_SHIFT) * MusicRNN::TIME_SHIFT_MS;
+            } else if (token >= MusicRNN::NOTE_OFF) {
+                emit("note_off", voice.role, token - MusicRNN::NOTE_OFF, 0, voice.time, voice.phraseId, sessionID);
+            } else {
+                emit("note_on", voice.role, token, config.velocity, voice.time, voice.phraseId, sessionID);
+                emit("note_off", voice.role, token, 0, voice.time + config.noteMillis, voice.phraseId, sessionID);
+                if (firstNote) {
+                    timeToFirstNote.record(trigger);
+                    firstNote = false;
+                }
+            }
+        }
+    }
+
+    tokens.fetch_add((int64_t) voices.size() * config.generateLength, std::memory_order_relaxed);
+    generationMicros.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count(),
+                               std::memory_order_relaxed);
+    phrasesGenerated.fetch_add((int64_t) voices.size(), std::memory_order_relaxed);
+}
+
+void NativeComposer::cancelPhrases(const std::string& sessionID, SessionState& session) {
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        if (session.phrases[r] == 0)
+            continue;
+        emit("cancel", r, 0, 0, ClockSync::nowMillis(), session.phrases[r], sessionID);
+        session.phrases[r] = 0;
+    }
+}
+
+void NativeComposer::emit(const std::string& type, int role, int note, int velocity, int64_t timestamp,
+                          int64_t phraseId, const std::string& session) {
+    MidiEvent event;
+    event.type = type;
+    event.role = MusicRNN::ROLES[role];
+    event.note = note;
+    event.velocity = velocity;
+    event.timestamp = timestamp;
+    event.session = session;
+    event.phraseId = phraseId;
+    event.peer = "native";
+    if (type == "note_on")
+        notesEmitted.fetch_add(1, std::memory_order_relaxed);
+    sink(event);
+}
+
+void NativeComposer::printStats() const {
+    auto micros = generationMicros.load();
+    auto generated = tokens.load();
+    std::cout << "[composer] native (" << MatVec::isa() << ")"
+              << " | phrases: " << phrasesGenerated.load()
+              << " | tokens: " << generated
+              << " | tokens/s: " << (micros > 0 ? double(generated) * 1e6 / double(micros) : 0.0)
+              << " | notes: " << notesEmitted.load()
+              << " | time to first note: " << timeToFirstNote.summary() << std::endl;
+}
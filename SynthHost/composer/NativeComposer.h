@@ -0,0 +1,112 @@
+#ifndef NATIVECOMPOSER_H
+#define NATIVECOMPOSER_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MusicRNN.h"
+#include "../utils/LatencyStats.h"
+#include "../websocket/MidiEvent.h"
+
+// In-process replacement for SynthComposer's WebSocketClient.py loop: buffers the user's notes
+// per session and, at most once per period, generates a phrase for every AI role the user isn't
+// playing. Runs on its own worker thread; tokens are turned into note events as they are sampled
+// (the roles are stepped round-robin) so the first note doesn't wait for the whole phrase.
+//
+// Events go to the sink with host-clock timestamps, the same shape the bridge delivers.
+class NativeComposer {
+public:
+    using Sink = std::function<void(const MidiEvent&)>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        int generateLength = 128;
+        std::chrono::milliseconds period{1000};
+        float temperature = 1.0f;
+        int velocity = 100;
+        // generated notes are released this long after they start, as the Python composer does
+        int noteMillis = 100;
+        // key used until one is detected or set; empty = the model's first key
+        std::string defaultKey;
+    };
+
+    NativeComposer(std::shared_ptr<const MusicRNN> model, Sink sink, Config config);
+    ~NativeComposer();
+
+    // User note from the MIDI forwarding thread. Never blocks on generation.
+    void onUserNote(const std::string& session, const std::string& role, int note, int velocity,
+                    int64_t wallMillis, Clock::time_point capturedAt);
+    // Changes the session's key; phrases generated in the old key are cancelled.
+    void setKey(const std::string& session, const std::string& key);
+    bool hasKey(const std::string& key) const { return model->keyIndex(key) >= 0; }
+
+    void stop();
+    int64_t getPhrasesGenerated() const { return phrasesGenerated.load(); }
+    void printStats() const;
+
+private:
+    static constexpr int SEED_TOKENS = 200;
+    static constexpr int NUM_ROLES = (int) std::size(MusicRNN::ROLES);
+
+    struct Input {
+        enum class Type { NOTE, KEY } type;
+        std::string session;
+        std::string role;
+        std::string key;
+        int note = 0;
+        int velocity = 0;
+        int64_t wallMillis = 0;
+        Clock::time_point capturedAt;
+    };
+
+    struct SessionState {
+        std::vector<std::pair<int64_t, int>> buffer;  // (wallMillis, note) of user note_ons
+        std::string userRole;
+        int key = -1;
+        Clock::time_point lastGeneration;
+        std::array<int64_t, NUM_ROLES> phrases{};     // last phrase id per role, 0 = none
+    };
+
+    void workLoop();
+    void handle(const Input& input);
+    void generate(const std::string& sessionID, SessionState& session, Clock::time_point trigger);
+    void cancelPhrases(const std::string& sessionID, SessionState& session);
+    std::vector<int> seedTokens(const SessionState& session) const;
+    void emit(const std::string& type, int role, int note, int velocity, int64_t timestamp, int64_t phraseId,
+              const std::string& session);
+
+    std::shared_ptr<const MusicRNN> model;
+    Sink sink;
+    Config config;
+    int defaultKey = 0;
+
+    std::mutex inboxMutex;
+    std::condition_variable inboxReady;
+    std::deque<Input> inbox;
+    bool running = true;
+    std::thread worker;
+
+    // worker thread only
+    std::unordered_map<std::string, SessionState> sessions;
+    std::mt19937 rng{std::random_device{}()};
+    int64_t nextPhrase = 1;
+
+    std::atomic<int64_t> tokens{0};
+    std::atomic<int64_t> generationMicros{0};
+    std::atomic<int64_t> phrasesGenerated{0};
+    std::atomic<int64_t> notesEmitted{0};
+    // user note that triggered a generation -> first generated note_on handed to the sink
+    LatencyStats timeToFirstNote;
+};
+
+#endif //NATIVECOMPOSER_H
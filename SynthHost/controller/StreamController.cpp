@@ -3,73 +3,479 @@
 //
 
 #include "StreamController.h"
+#include "../capture/SessionRecorder.h"
+#include "../executor/ThreadPolicy.h"
+#include "../utils/ProcessMemory.h"
+#include "../vst_hosting/PluginScanCache.h"
 
-StreamController::StreamController(boost::asio::io_context &ioContext) : ioContext(ioContext) {
+namespace {
+    // True if key is present with another type than is() accepts; j.value() would throw on it.
+    bool mistyped(const json &j, const char *key, bool (json::*is)() const noexcept) {
+        auto it = j.find(key);
+        return it != j.end() && !((*it).*is)();
+    }
+}
+
+StreamController::StreamController(boost::asio::io_context &ioContext, ExecutorConfig config)
+    : ioContext(ioContext), controlExecutor("control", config.controlThreads),
+      presetExecutor("preset", config.presetThreads), clockSyncTimer(ioContext), snapshotTimer(ioContext),
+      hibernationTimer(ioContext) {
+    portAllocator.reserveBlock(9000);
+    sessions[DEFAULT_SESSION] = std::make_shared<Session>(DEFAULT_SESSION, 9000, portAllocator.getPortsPerSession());
+}
+
+void StreamController::addStreamManager(int blockSize, int sampleRate, int port, StreamID id, bool isAIEngine,
+                                        const string &role) {
+    addStreamManagers(blockSize, sampleRate, {{port, id, isAIEngine, role}});
+}
+
+void StreamController::addStreamManagers(int blockSize, int sampleRate, const std::vector<StreamSpec> &specs) {
+    defaultBlockSize = blockSize;
+    defaultSampleRate = sampleRate;
+    std::vector<std::shared_ptr<Session>> specSessions;
+    for (const auto &spec: specs) {
+        specSessions.push_back(getSession(spec.session.empty() ? DEFAULT_SESSION : spec.session));
+        specSessions.back()->claimPort(spec.port);
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<StreamManager>> managers(specs.size());
+    std::vector<std::exception_ptr> errors(specs.size());
+    // each worker waits on the message thread for its instance, so that thread must be running
+    // (main starts it) and never be the one joining here
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        workers.emplace_back([this, &specs, &managers, &errors, blockSize, sampleRate, i]() {
+            try {
+                const auto &spec = specs[i];
+                string streamRole = spec.role.empty() ? getRoleForStreamID(spec.id) : spec.role;
+                PluginDef plugin = spec.restore != nullptr ? spec.restore->plugin : pluginFor(streamRole);
+                const juce::MemoryBlock *state = spec.restore != nullptr && spec.restore->pluginState.getSize() > 0
+                                                     ? &spec.restore->pluginState
+                                                     : nullptr;
+                managers[i] = std::make_shared<StreamManager>(blockSize, sampleRate, spec.port, spec.id,
+                                                              spec.isAIEngine, pluginPool, plugin, state);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+    auto wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (errors[i])
+            std::rethrow_exception(errors[i]);
+        const auto &spec = specs[i];
+        string streamRole = spec.role.empty() ? getRoleForStreamID(spec.id) : spec.role;
+        auto &streamManager = managers[i];
+        auto &session = specSessions[i];
+        auto engine = streamManager->getAudioEngine();
+        engine->setSessionID(session->getID());
+        engine->setGovernorConfig(spec.restore != nullptr ? spec.restore->governor : governorConfigFor(streamRole));
+        applyLookAhead(streamManager);
+        watchForWake(streamManager);
+        if (spec.restore != nullptr) {
+            if (spec.restore->preset)
+                engine->restorePreset(*spec.restore->preset);
+            for (const auto &parameter: spec.restore->parameters)
+                engine->automateParameter(parameter.first, parameter.second, 0, 0);
+        }
+        session->getStreams().add(streamManager, streamRole);
+        if (spec.restore != nullptr && spec.restore->paused) {
+            streamManager->pause();
+            session->getStreams().setState(spec.id, StreamRegistry::State::PAUSED);
+        } else {
+            streamManager->startStreaming();
+        }
+
+        const auto &t = streamManager->getStartupTimings();
+        std::cout << "[startup] stream " << spec.id << " (" << (streamRole.empty() ? "user" : streamRole) << ")";
+        if (session->getID() != DEFAULT_SESSION)
+            std::cout << " of session " << session->getID();
+        std::cout << " | plugin " << t.plugin << " ms";
+        if (spec.restore != nullptr)
+            std::cout << " | restore " << t.restore << " ms";
+        std::cout << " | prepare " << t.prepare << " ms | warm-up " << t.warmUp
+                  << " ms | device " << t.device << " ms | total " << t.total << " ms" << std::endl;
+    }
+    std::cout << "[startup] " << specs.size() << " stream(s) up in " << wallMs << " ms" << std::endl;
+}
+
+
+bool StreamController::saveSnapshot(const string &path) {
+    auto started = std::chrono::steady_clock::now();
+    EngineSnapshot snapshot;
+    snapshot.sampleRate = uint32_t(defaultSampleRate);
+    snapshot.blockSize = uint32_t(defaultBlockSize);
+    std::vector<std::shared_ptr<Session>> current;
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+        for (const auto &session: sessions)
+            current.push_back(session.second);
+    }
+    for (const auto &session: current) {
+        EngineSnapshot::Session saved;
+        saved.id = session->getID();
+        saved.basePort = session->getBasePort();
+        for (const auto &entry: session->getStreams().list()) {
+            auto engine = entry.stream->getAudioEngine();
+            EngineSnapshot::Stream stream;
+            stream.id = entry.stream->getStreamID();
+            stream.port = entry.stream->getPort();
+            stream.role = entry.role;
+            stream.ai = entry.stream->isAI();
+            stream.plugin = entry.stream->getPluginDef();
+            stream.paused = entry.state == StreamRegistry::State::PAUSED;
+            stream.preset = engine->getCurrentPreset();
+            stream.governor = engine->getGovernorConfig();
+            stream.parameters = engine->getParameterOverrides();
+            entry.stream->getPluginState(stream.pluginState);
+            saved.streams.push_back(std::move(stream));
+        }
+        snapshot.sessions.push_back(std::move(saved));
+    }
+
+    string error;
+    if (!snapshot.write(path, error)) {
+        std::cout << "[snapshot] " << error << std::endl;
+        return false;
+    }
+    size_t bytes = 0;
+    for (const auto &session: snapshot.sessions)
+        for (const auto &stream: session.streams)
+            bytes += stream.pluginState.getSize();
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "[snapshot] " << snapshot.streamCount() << " stream(s), " << bytes / 1024 << " KB of plugin state"
+              << " written to " << path << " in " << ms << " ms" << std::endl;
+    return true;
+}
+
+bool StreamController::restoreSnapshot(const string &path, int blockSize, int sampleRate) {
+    // kept alive until the streams are built: their specs point into it
+    EngineSnapshot snapshot;
+    string error;
+    if (!snapshot.read(path, error) || snapshot.streamCount() == 0) {
+        std::cout << "[snapshot] " << (error.empty() ? path + " holds no streams" : error) << ", starting fresh"
+                  << std::endl;
+        return false;
+    }
+
+    std::vector<StreamSpec> specs;
+    for (const auto &saved: snapshot.sessions) {
+        if (saved.id != DEFAULT_SESSION && getSession(saved.id) == nullptr) {
+            if (!portAllocator.reserveBlock(saved.basePort)) {
+                std::cout << "[snapshot] port block " << saved.basePort << " of session " << saved.id
+                          << " is taken, not restoring it" << std::endl;
+                continue;
+            }
+            std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+            sessions[saved.id] = std::make_shared<Session>(saved.id, saved.basePort, portAllocator.getPortsPerSession());
+        }
+        for (const auto &stream: saved.streams)
+            specs.push_back({stream.port, static_cast<StreamID>(stream.id), stream.ai, stream.role, saved.id, &stream});
+    }
+    addStreamManagers(blockSize, sampleRate, specs);
+    std::cout << "[snapshot] restored " << specs.size() << " stream(s) in " << snapshot.sessions.size()
+              << " session(s) from " << path << std::endl;
+    return true;
+}
+
+void StreamController::startSnapshots(const string &path, std::chrono::seconds interval) {
+    snapshotPath = path;
+    snapshotInterval = interval;
+    scheduleSnapshot();
+}
+
+void StreamController::scheduleSnapshot() {
+    snapshotTimer.expires_after(snapshotInterval);
+    snapshotTimer.async_wait([this](const boost::system::error_code &ec) {
+        if (ec) return;
+        // plugin state is pulled off the io threads, next to stream creation and teardown
+        lifecycleExecutor.post([this]() { saveSnapshot(snapshotPath); });
+        scheduleSnapshot();
+    });
+}
+
+void StreamController::enableHibernation(std::chrono::seconds idleAfter, int warmInstances) {
+    hibernateAfter = idleAfter;
+    pluginPool->setMaxIdle(size_t(std::max(0, warmInstances)));
+    scheduleHibernation();
+}
+
+void StreamController::scheduleHibernation() {
+    hibernationTimer.expires_after(std::chrono::seconds(1));
+    hibernationTimer.async_wait([this](const boost::system::error_code &ec) {
+        if (ec) return;
+        lifecycleExecutor.post([this]() { hibernateIdleStreams(); });
+        scheduleHibernation();
+    });
+}
+
+void StreamController::hibernateIdleStreams() {
+    std::vector<std::shared_ptr<Session>> current;
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+        for (const auto &session: sessions)
+            current.push_back(session.second);
+    }
+    for (const auto &session: current) {
+        for (const auto &entry: session->getStreams().list()) {
+            if (entry.state != StreamRegistry::State::RUNNING || !entry.stream->isAI())
+                continue;
+            auto before = residentMemoryBytes();
+            if (!entry.stream->hibernate(double(hibernateAfter.count())))
+                continue;
+            auto released = int64_t(before) - int64_t(residentMemoryBytes());
+            hibernations.fetch_add(1);
+            hibernationReleasedBytes.fetch_add(std::max<int64_t>(0, released));
+            std::cout << "[hibernation] stream " << session->getID() << "/" << entry.stream->getStreamID() << " ("
+                      << entry.role << ") hibernated, " << released / (1024 * 1024) << " MB released" << std::endl;
+        }
+    }
 }
 
-void StreamController::addStreamManager(int blockSize, int sampleRate, int port, StreamID id, bool isAIEngine) {
-    auto streamManager = std::make_shared<StreamManager>(blockSize, sampleRate, port, id, isAIEngine);
-    streamManager->startStreaming();
+// Events for a hibernating stream wake it on the preset executor, next to the other plugin loads.
+void StreamController::watchForWake(const std::shared_ptr<StreamManager> &stream) {
+    if (!stream->isAI())
+        return;
+    std::weak_ptr<StreamManager> weak = stream;
+    stream->getAudioEngine()->setWakeHandler([this, weak]() {
+        presetExecutor.post([weak]() {
+            if (auto manager = weak.lock())
+                manager->wake();
+        });
+    });
+}
 
-    streams.push_back(streamManager);
+void StreamController::reportFirstAudio(std::chrono::steady_clock::time_point launchedAt, const string &mode) {
+    lifecycleExecutor.post([this, launchedAt, mode]() {
+        auto session = getSession(DEFAULT_SESSION);
+        if (session == nullptr) return;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        std::optional<std::chrono::steady_clock::time_point> first, last;
+        bool waiting = true;
+        while (waiting && std::chrono::steady_clock::now() < deadline) {
+            waiting = false;
+            first.reset();
+            last.reset();
+            for (const auto &entry: session->getStreams().list()) {
+                if (entry.state != StreamRegistry::State::RUNNING) continue;
+                auto at = entry.stream->getFirstAudioTime();
+                if (!at) {
+                    waiting = true;
+                    break;
+                }
+                if (!first || *at < *first) first = at;
+                if (!last || *at > *last) last = at;
+            }
+            if (waiting)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (waiting || !first) {
+            std::cout << "[startup] no audio from every stream within 10 s (" << mode << ")" << std::endl;
+            return;
+        }
+        auto ms = [&](std::chrono::steady_clock::time_point at) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(at - launchedAt).count();
+        };
+        std::cout << "[startup] first audio " << ms(*first) << " ms after launch, all streams " << ms(*last)
+                  << " ms (" << mode << ")" << std::endl;
+    });
 }
 
 
 void StreamController::addWebSocketClient(string host, string port, string url, WebSocketClientID id,
-                                          JsonMethod onJsonMethod) {
+                                          JsonMethod onJsonMethod, HandlerLane lane) {
     auto wsClient = std::make_shared<WebSocketClient>(ioContext, host, port, url, id);
-    wsClient->onJson([this, onJsonMethod](const json &j) {
-        (this->*onJsonMethod)(j);
-    });
+    if (onJsonMethod != nullptr) {
+        auto &executor = lane == HandlerLane::MIDI ? midiExecutor : controlExecutor;
+        auto strand = std::make_shared<InstrumentedExecutor::Strand>(executor.makeStrand());
+        wsClient->onJson([this, onJsonMethod, &executor, strand](const json &j) {
+            executor.post(*strand, [this, onJsonMethod, j]() {
+                (this->*onJsonMethod)(j);
+            });
+        });
+    }
     wsClient->run();
-    wsClients.push_back(wsClient);
+    wsClients[id] = wsClient;
 }
 
 
 void StreamController::shutdown() {
-    for (auto wsClient: wsClients) {
-        wsClient->close();
+    clockSyncTimer.cancel();
+    snapshotTimer.cancel();
+    hibernationTimer.cancel();
+    if (nativeComposer != nullptr)
+        nativeComposer->stop();
+    controlExecutor.join();
+    midiExecutor.join();
+    presetExecutor.join();
+    lifecycleExecutor.join();
+    // the executors are idle now, so nothing changes the streams underneath the final snapshot
+    if (!snapshotPath.empty())
+        saveSnapshot(snapshotPath);
+    for (auto &wsClient: wsClients) {
+        wsClient.second->close();
     }
-    for (auto stream: streams) {
-        stream->stopStreaming();
+    std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+    for (auto &session: sessions) {
+        for (auto stream: session.second->getStreams().all()) {
+            stream->stopStreaming();
+        }
     }
     ioContext.stop();
 }
 
-std::shared_ptr<StreamManager> StreamController::getStreamManager(StreamID id) {
-    for (auto stream: streams) {
-        if (stream->getStreamID() == id) {
-            return stream;
+void StreamController::printStats() const {
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+        for (const auto &session: sessions) {
+            std::cout << "[session " << session.first << "] ports " << session.second->getBasePort()
+                      << "+ | load " << session.second->getCpuLoad() << std::endl;
+            for (const auto &stream: session.second->getStreams().all()) {
+                stream->printStats();
+            }
         }
     }
-    throw std::runtime_error("Stream does not exist");
-}
-
-std::shared_ptr<WebSocketClient> StreamController::getWebSocketClient(WebSocketClientID id) {
-    for (auto client: wsClients) {
-        if (client->getID() == id) {
-            return client;
+    for (const auto &wsClient: wsClients) {
+        wsClient.second->printStats();
+    }
+    controlExecutor.printStats();
+    midiExecutor.printStats();
+    presetExecutor.printStats();
+    lifecycleExecutor.printStats();
+    pluginPool->printStats();
+    if (hibernateAfter.count() > 0) {
+        size_t sessionCount = 0, idleSessions = 0, hibernated = 0;
+        {
+            std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+            sessionCount = sessions.size();
+            for (const auto &session: sessions) {
+                bool allAsleep = true;
+                for (const auto &stream: session.second->getStreams().all()) {
+                    if (!stream->isAI()) continue;
+                    if (stream->isHibernating())
+                        ++hibernated;
+                    else
+                        allAsleep = false;
+                }
+                if (allAsleep) ++idleSessions;
+            }
         }
+        auto residentMb = double(residentMemoryBytes()) / (1024 * 1024);
+        auto count = hibernations.load();
+        std::cout << "[hibernation] after " << hibernateAfter.count() << " s idle | " << hibernated
+                  << " stream(s) hibernating, " << idleSessions << " of " << sessionCount << " session(s) fully"
+                  << " | resident " << residentMb << " MB, " << (sessionCount > 0 ? residentMb / sessionCount : 0.0)
+                  << " MB per session | hibernations " << count << ", avg "
+                  << (count > 0 ? hibernationReleasedBytes.load() / count / (1024 * 1024) : 0) << " MB released"
+                  << std::endl;
     }
-    return nullptr;
+    PluginScanCache::instance().printStats();
+    clockSync.printStats();
+    std::cout << "[automation] rejected events: " << rejectedAutomation.load() << std::endl;
+    if (nativeComposer != nullptr)
+        nativeComposer->printStats();
+    SessionRecorder::instance().printStats();
+    ThreadPolicy::instance().printStats();
+    std::cout << "[capacity] " << reportCapacity().dump() << std::endl;
 }
 
-std::shared_ptr<StreamManager> StreamController::getStream(StreamID id) {
-    for (auto stream: streams) {
-        if (stream->getStreamID() == id) {
-            return stream;
-        }
+std::shared_ptr<Session> StreamController::getSession(const string &id) const {
+    std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+    auto it = sessions.find(id);
+    return it == sessions.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<StreamManager> StreamController::getStreamManager(StreamID id, const string &session) {
+    auto stream = getStream(id, session);
+    if (stream == nullptr) {
+        throw std::runtime_error("Stream does not exist");
     }
-    return nullptr;
+    return stream;
 }
 
+std::shared_ptr<WebSocketClient> StreamController::getWebSocketClient(WebSocketClientID id) {
+    auto it = wsClients.find(id);
+    return it == wsClients.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<StreamManager> StreamController::getStream(StreamID id, const string &session) {
+    auto owner = getSession(session);
+    return owner == nullptr ? nullptr : owner->getStreams().find(id);
+}
+
+// Applies to the streamer of every session; sessions opened later are wired up in openSession.
 void StreamController::setMidiSenderClient(WebSocketClientID sender, StreamID streamer) {
-    auto stream = getStream(streamer);
     auto client = getWebSocketClient(sender);
-    if (client != nullptr && stream != nullptr)
+    if (client == nullptr)
+        return;
+    for (auto &stream: streamsWithID(streamer))
         stream->setMidiSenderClient(client);
 }
 
+std::vector<std::shared_ptr<StreamManager>> StreamController::streamsWithID(StreamID id) const {
+    std::vector<std::shared_ptr<StreamManager>> streams;
+    std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+    for (const auto &session: sessions) {
+        if (auto stream = session.second->getStreams().find(id))
+            streams.push_back(stream);
+    }
+    return streams;
+}
+
+void StreamController::startClockSync(std::chrono::milliseconds interval) {
+    clockSyncInterval = interval;
+    sendClockPing();
+}
+
+void StreamController::sendClockPing() {
+    if (auto client = getWebSocketClient(COMPOSER_OUTPUT))
+        client->sendJson(clockSync.makePing());
+    clockSyncTimer.expires_after(clockSyncInterval);
+    clockSyncTimer.async_wait([this](const boost::system::error_code &ec) {
+        if (!ec)
+            sendClockPing();
+    });
+}
+
+void StreamController::enableNativeComposer(std::shared_ptr<const MusicRNN> model, NativeComposer::Config config) {
+    nativeComposer = std::make_unique<NativeComposer>(std::move(model), [this](const MidiEvent &event) {
+        midiExecutor.post([this, event]() { handleComposeOutput(event); });
+    }, std::move(config));
+    for (auto &user: streamsWithID(USER))
+        attachNativeComposer(user);
+}
+
+void StreamController::attachNativeComposer(const std::shared_ptr<StreamManager> &user) {
+    if (nativeComposer == nullptr)
+        return;
+    auto composer = nativeComposer.get();
+    // the user stream's key estimate drives the composer's key; only changes are passed on
+    user->getAudioEngine()->setNoteListener([composer, lastKey = string()](
+            const string &session, const string &role, int note, int velocity, juce::int64 wallMillis,
+            std::chrono::steady_clock::time_point capturedAt, const KeyEstimator::Estimate &key) mutable {
+        for (const auto &name: key.composerNames()) {
+            if (!composer->hasKey(name))
+                continue;
+            if (name != lastKey) {
+                composer->setKey(session, name);
+                lastKey = name;
+            }
+            break;
+        }
+        composer->onUserNote(session, role, note, velocity, wallMillis, capturedAt);
+    });
+}
+
+void StreamController::setControllerForwardRate(StreamID streamer, int rateHz) {
+    controllerForwardRate = rateHz;
+    for (auto &stream: streamsWithID(streamer))
+        stream->getAudioEngine()->setControllerForwardRate(rateHz);
+}
+
 StreamID StreamController::getStreamIDForRole(const std::string &role) {
     if (role == "bass") return AI_BASS;
     if (role == "pad") return AI_PAD;
@@ -78,67 +484,487 @@ StreamID StreamController::getStreamIDForRole(const std::string &role) {
     return USER;
 }
 
+string StreamController::getRoleForStreamID(StreamID id) {
+    if (id == AI_BASS) return "bass";
+    if (id == AI_PAD) return "pad";
+    if (id == AI_PLUCK) return "pluck";
+    if (id == AI_LEAD) return "lead";
+    return "";
+}
+
+json StreamController::reportCapacity() const {
+    double load = 0.0;
+    size_t sessionCount = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+        for (const auto &session: sessions) {
+            load += session.second->getCpuLoad();
+        }
+        sessionCount = sessions.size();
+    }
+    int cores = juce::SystemStats::getNumCpus();
+    double headroom = std::max(0.0, capacityTarget * cores - load);
+    int freeBlocks = portAllocator.getFreeBlocks();
+    double perSession = sessionCount == 0 ? 0.0 : load / double(sessionCount);
+    // without a measured session cost only the port budget bounds the answer
+    int available = perSession > 0.0 ? std::min(freeBlocks, int(headroom / perSession)) : freeBlocks;
+    return {
+        {"event", "capacity"},
+        {"sessions", sessionCount},
+        {"cores", cores},
+        {"load", load},
+        {"load_per_session", perSession},
+        {"headroom", headroom},
+        {"free_port_blocks", freeBlocks},
+        {"available_sessions", available},
+        {"estimated", perSession > 0.0}
+    };
+}
+
+
+// session and stream lifecycle, always on lifecycleExecutor
+void StreamController::openSession(const string &sessionID, const string &midiInput) {
+    if (getSession(sessionID) != nullptr) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"error", "session already exists"}});
+        return;
+    }
+    // without a controller of its own the session's user stream would never hear a note
+    if (!HeadlessAudioEngine::isMidiInputAvailable(midiInput)) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID},
+                            {"error", "no free MIDI input matching '" + midiInput + "'"}});
+        return;
+    }
+    int basePort = portAllocator.allocateBlock();
+    if (basePort < 0) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"error", "no free port block"}});
+        return;
+    }
+    auto started = std::chrono::steady_clock::now();
+    auto session = std::make_shared<Session>(sessionID, basePort, portAllocator.getPortsPerSession());
+    {
+        std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+        sessions[sessionID] = session;
+    }
+    for (StreamID id: {USER, AI_BASS, AI_LEAD, AI_PAD, AI_PLUCK}) {
+        createStream(sessionID, -1, id, id != USER, getRoleForStreamID(id));
+    }
+    auto user = session->getStreams().find(USER);
+    if (user == nullptr || !user->getAudioEngine()->setMidiInput(midiInput)) {
+        {
+            std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+            sessions.erase(sessionID);
+        }
+        teardownSession(session);
+        replyStreamControl({{"event", "error"}, {"session", sessionID},
+                            {"error", "could not give the session a MIDI input matching '" + midiInput + "'"}});
+        return;
+    }
+    if (auto client = getWebSocketClient(USER_INPUT))
+        user->setMidiSenderClient(client);
+    user->getAudioEngine()->setControllerForwardRate(controllerForwardRate);
+    attachNativeComposer(user);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    replyStreamControl({{"event", "session_opened"}, {"session", sessionID}, {"port", basePort}, {"ms", ms}});
+}
+
+void StreamController::closeSession(const string &sessionID) {
+    std::shared_ptr<Session> session;
+    {
+        std::unique_lock<std::shared_mutex> lock(sessionsMutex);
+        auto it = sessions.find(sessionID);
+        if (it != sessions.end()) {
+            session = it->second;
+            sessions.erase(it);
+        }
+    }
+    if (session == nullptr) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"error", "session does not exist"}});
+        return;
+    }
+    teardownSession(session);
+    replyStreamControl({{"event", "session_closed"}, {"session", sessionID}});
+}
+
+void StreamController::teardownSession(const std::shared_ptr<Session> &session) {
+    for (auto &stream: session->getStreams().all()) {
+        session->getStreams().remove(stream->getStreamID());
+        stream->pause();
+    }
+    portAllocator.releaseBlock(session->getBasePort());
+}
+
+void StreamController::createStream(const string &sessionID, int port, StreamID id, bool isAIEngine,
+                                    const string &role) {
+    auto session = getSession(sessionID);
+    if (session == nullptr || session->getStreams().contains(id)) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"stream", id},
+                            {"error", "session missing or stream already exists"}});
+        return;
+    }
+    if (port < 0) {
+        port = session->allocatePort();
+    } else if (!session->claimPort(port)) {
+        port = -1;
+    }
+    if (port < 0) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"stream", id}, {"error", "no free port"}});
+        return;
+    }
+    auto started = std::chrono::steady_clock::now();
+    try {
+        auto streamManager = std::make_shared<StreamManager>(defaultBlockSize, defaultSampleRate, port, id,
+                                                             isAIEngine, pluginPool, pluginFor(role));
+        streamManager->getAudioEngine()->setSessionID(sessionID);
+        streamManager->getAudioEngine()->setGovernorConfig(governorConfigFor(role));
+        applyLookAhead(streamManager);
+        watchForWake(streamManager);
+        streamManager->startStreaming();
+        session->getStreams().add(streamManager, role);
+    } catch (const std::exception &e) {
+        session->releasePort(port);
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"stream", id}, {"error", e.what()}});
+        return;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Stream " << sessionID << "/" << id << " (" << role << ") created on port " << port
+              << " in " << ms << " ms" << std::endl;
+    replyStreamControl({{"event", "stream_created"}, {"session", sessionID}, {"stream", id}, {"role", role},
+                        {"port", port}, {"ms", ms}});
+}
+
+void StreamController::destroyStream(const string &sessionID, StreamID id) {
+    auto session = getSession(sessionID);
+    auto stream = session == nullptr ? nullptr : session->getStreams().remove(id);
+    if (stream == nullptr) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"stream", id}, {"error", "stream does not exist"}});
+        return;
+    }
+    stream->pause();
+    session->releasePort(stream->getPort());
+    stream.reset();
+    replyStreamControl({{"event", "stream_destroyed"}, {"session", sessionID}, {"stream", id}});
+}
+
+void StreamController::pauseStream(const string &sessionID, StreamID id) {
+    auto session = getSession(sessionID);
+    auto stream = session == nullptr ? nullptr : session->getStreams().find(id);
+    if (stream == nullptr || !session->getStreams().setState(id, StreamRegistry::State::PAUSED)) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"stream", id}, {"error", "stream is not running"}});
+        return;
+    }
+    stream->pause();
+    replyStreamControl({{"event", "stream_paused"}, {"session", sessionID}, {"stream", id}});
+}
+
+void StreamController::resumeStream(const string &sessionID, StreamID id) {
+    auto session = getSession(sessionID);
+    auto stream = session == nullptr ? nullptr : session->getStreams().find(id);
+    if (stream == nullptr) {
+        replyStreamControl({{"event", "error"}, {"session", sessionID}, {"stream", id}, {"error", "stream does not exist"}});
+        return;
+    }
+    stream->resume();
+    session->getStreams().setState(id, StreamRegistry::State::RUNNING);
+    replyStreamControl({{"event", "stream_resumed"}, {"session", sessionID}, {"stream", id}});
+}
+
+MidiGovernor::Config StreamController::governorConfigFor(const string &role) const {
+    std::lock_guard<std::mutex> lock(governorMutex);
+    auto it = governorConfigs.find(role);
+    return it == governorConfigs.end() ? MidiGovernor::Config{} : it->second;
+}
+
+void StreamController::setPluginBackend(const string &role, PluginDef::Backend backend) {
+    std::lock_guard<std::mutex> lock(governorMutex);
+    pluginBackends[role] = backend;
+}
+
+void StreamController::setPlugin(const PluginDef &plugin) {
+    std::lock_guard<std::mutex> lock(governorMutex);
+    defaultPlugin = plugin;
+}
+
+void StreamController::setLookAheadMillis(int millis) {
+    std::lock_guard<std::mutex> lock(governorMutex);
+    lookAheadMillis = std::max(0, millis);
+}
+
+void StreamController::applyLookAhead(const std::shared_ptr<StreamManager> &stream) const {
+    int millis;
+    {
+        std::lock_guard<std::mutex> lock(governorMutex);
+        millis = lookAheadMillis;
+    }
+    if (millis == 0 || !stream->isAI())
+        return;
+    int samples = int(millis * stream->getSampleRate() / 1000.0);
+    if (!stream->getAudioEngine()->enableLookAhead(samples))
+        std::cout << "[lookahead] stream " << stream->getStreamID() << " renders in lock-step: "
+                  << stream->getPluginDef().name << " can't be rolled back" << std::endl;
+}
+
+PluginDef StreamController::pluginFor(const string &role) const {
+    std::lock_guard<std::mutex> lock(governorMutex);
+    auto it = pluginBackends.find(role);
+    if (it == pluginBackends.end())
+        it = pluginBackends.find("*");
+    auto backend = it == pluginBackends.end() ? PluginDef::Backend::JUCE : it->second;
+    return defaultPlugin.withBackend(backend);
+}
+
+// Updates the role's limits for every session's streams (or only sessionID's, when given)
+// and for streams created later.
+void StreamController::configureGovernor(const string &sessionID, const string &role, const json &limits) {
+    for (const char *field: {"max_note_ms", "max_voices", "max_notes_per_second"}) {
+        if (mistyped(limits, field, &json::is_number_integer)) {
+            replyStreamControl({{"event", "error"}, {"role", role}, {"error", string("\"") + field + "\" must be an integer"}});
+            return;
+        }
+    }
+    MidiGovernor::Config config = governorConfigFor(role);
+    config.maxNoteMillis = limits.value("max_note_ms", config.maxNoteMillis);
+    config.maxVoices = limits.value("max_voices", config.maxVoices);
+    config.maxNotesPerSecond = limits.value("max_notes_per_second", config.maxNotesPerSecond);
+    {
+        std::lock_guard<std::mutex> lock(governorMutex);
+        governorConfigs[role] = config;
+    }
+    std::vector<std::shared_ptr<Session>> targets;
+    {
+        std::shared_lock<std::shared_mutex> lock(sessionsMutex);
+        for (const auto &session: sessions) {
+            if (sessionID.empty() || session.first == sessionID)
+                targets.push_back(session.second);
+        }
+    }
+    for (const auto &session: targets) {
+        session->getStreams().forEachInRole(role, [&config](const std::shared_ptr<StreamManager> &stream) {
+            stream->getAudioEngine()->setGovernorConfig(config);
+        }, false);
+    }
+    replyStreamControl({{"event", "governor"}, {"role", role}, {"max_note_ms", config.maxNoteMillis},
+                        {"max_voices", config.maxVoices}, {"max_notes_per_second", config.maxNotesPerSecond}});
+}
+
+void StreamController::replyStreamControl(json reply) {
+    if (auto client = getWebSocketClient(STREAM_CONTROL))
+        client->sendJson(reply);
+}
+
+
+void StreamController::replyPresetChange(json reply) {
+    if (auto client = getWebSocketClient(PRESET_CHANGER))
+        client->sendJson(reply);
+}
+
+// Every load runs as its own job on presetExecutor; the last one to finish reports the whole change.
+void StreamController::loadPresets(const string &sessionID, const string &preset,
+                                   std::vector<std::pair<std::shared_ptr<StreamManager>, Preset>> loads) {
+    struct PresetChange {
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        std::atomic<size_t> remaining;
+        std::mutex resultsMutex;
+        json results = json::array();
+    };
+    auto change = std::make_shared<PresetChange>();
+    change->remaining.store(loads.size());
+    for (auto &load: loads) {
+        auto stream = load.first;
+        uint64_t request = stream->nextPresetRequest();
+        presetExecutor.post([this, change, sessionID, preset, stream, request, streamPreset = load.second]() {
+            auto started = std::chrono::steady_clock::now();
+            json result = {{"stream", stream->getStreamID()}, {"preset", streamPreset.name}};
+            try {
+                if (!stream->setPreset(streamPreset, request))
+                    result["skipped"] = true;
+            } catch (const std::exception &e) {
+                result["error"] = e.what();
+            }
+            result["ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started).count();
+            {
+                std::lock_guard<std::mutex> lock(change->resultsMutex);
+                change->results.push_back(std::move(result));
+            }
+            if (change->remaining.fetch_sub(1) != 1)
+                return;
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - change->started).count();
+            std::cout << "Preset " << preset << " loaded into session " << sessionID << " in " << ms << " ms"
+                      << std::endl;
+            replyPresetChange({{"event", "preset_loaded"}, {"preset", preset}, {"session", sessionID}, {"ms", ms},
+                               {"streams", change->results}});
+        });
+    }
+}
+
 
 // handler methods
 void StreamController::changePreset(const json &j) {
+    SessionRecorder::instance().recordControl(j.dump());
     string preset = j.at("preset").get<string>();
+    string session = j.value("session", DEFAULT_SESSION);
+    std::vector<std::pair<std::shared_ptr<StreamManager>, Preset>> loads;
     try {
         Preset foundPreset = Presets::getFromString(preset);
-        std::shared_ptr<StreamManager> stream = getStreamManager(USER);
-        stream->setPreset(foundPreset);
-        std::shared_ptr<StreamManager> ai_bass_stream = getStreamManager(AI_BASS);
-        std::shared_ptr<StreamManager> ai_lead_stream = getStreamManager(AI_LEAD);
-        std::shared_ptr<StreamManager> ai_pad_stream = getStreamManager(AI_PAD);
-        std::shared_ptr<StreamManager> ai_pluck_stream = getStreamManager(AI_PLUCK);
-        if (foundPreset.type == "bass") {
-            stream->getAudioEngine()->setMidiRole("bass");
-            ai_lead_stream->setPreset(Presets::getRandomLead());
-            ai_pad_stream->setPreset(Presets::getRandomPad());
-            ai_pluck_stream->setPreset(Presets::getRandomPluck());
-        }
-        if (foundPreset.type == "lead") {
-            stream->getAudioEngine()->setMidiRole("lead");
-            ai_bass_stream->setPreset(Presets::getRandomBass());
-            ai_pad_stream->setPreset(Presets::getRandomPad());
-            ai_pluck_stream->setPreset(Presets::getRandomPluck());
-        }
-        if (foundPreset.type == "pad") {
-            stream->getAudioEngine()->setMidiRole("pad");
-            ai_bass_stream->setPreset(Presets::getRandomBass());
-            ai_lead_stream->setPreset(Presets::getRandomLead());
-            ai_pluck_stream->setPreset(Presets::getRandomPluck());
-        }
-        if (foundPreset.type == "pluck") {
-            stream->getAudioEngine()->setMidiRole("pluck");
-            ai_bass_stream->setPreset(Presets::getRandomBass());
-            ai_lead_stream->setPreset(Presets::getRandomLead());
-            ai_pad_stream->setPreset(Presets::getRandomPad());
-        }
-    } catch (const std::invalid_argument &e) {
+        std::shared_ptr<StreamManager> stream = getStreamManager(USER, session);
+        // the role is tagged on outgoing user MIDI straight away, before the load completes
+        stream->getAudioEngine()->setMidiRole(foundPreset.type);
+        loads.emplace_back(stream, foundPreset);
+        if (foundPreset.type != "bass")
+            loads.emplace_back(getStreamManager(AI_BASS, session), Presets::getRandomBass());
+        if (foundPreset.type != "lead")
+            loads.emplace_back(getStreamManager(AI_LEAD, session), Presets::getRandomLead());
+        if (foundPreset.type != "pad")
+            loads.emplace_back(getStreamManager(AI_PAD, session), Presets::getRandomPad());
+        if (foundPreset.type != "pluck")
+            loads.emplace_back(getStreamManager(AI_PLUCK, session), Presets::getRandomPluck());
+    } catch (const std::exception &e) {
         std::cout << e.what() << std::endl;
+        replyPresetChange({{"event", "error"}, {"preset", preset}, {"session", session}, {"error", e.what()}});
+        return;
     }
+    loadPresets(session, preset, std::move(loads));
 }
 
-void StreamController::handleComposeOutput(const json &j) {
-    auto role = j.at("role").get<string>();
-    auto manager = getStreamManager(getStreamIDForRole(role));
-    if (!manager) return;
+void StreamController::handleComposeOutput(const MidiEvent &event) {
+    if (event.type == "pong") {
+        clockSync.onPong(event);
+        return;
+    }
+    auto session = getSession(event.session.empty() ? DEFAULT_SESSION : event.session);
+    if (session == nullptr) return;
 
-    bool isOn = (j.at("type").get<string>() == "note_on");
-    int note = j.at("note").get<int>();
-    int vel = j.at("velocity").get<int>();
+    // every running layer of the role plays the event
+    auto forEachStream = [&](const auto &f) {
+        if (!session->getStreams().forEachInRole(event.role, f)) {
+            if (auto manager = session->getStreams().find(getStreamIDForRole(event.role)))
+                f(manager);
+        }
+    };
+    if (event.type == "cancel") {
+        auto phraseId = uint64_t(event.phraseId);
+        forEachStream([phraseId](const std::shared_ptr<StreamManager> &manager) {
+            manager->getAudioEngine()->cancelPhrase(phraseId);
+        });
+        return;
+    }
+    if (event.type != "note_on" && event.type != "note_off") return;
+
+    bool isOn = (event.type == "note_on");
     juce::MidiMessage m = isOn
-                              ? juce::MidiMessage::noteOn(1, note, (uint8_t) vel)
-                              : juce::MidiMessage::noteOff(1, note);
-    int64_t eventMs = j.at("timestamp").get<int64_t>();
-    int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    ).count();
+                              ? juce::MidiMessage::noteOn(1, event.note, (uint8_t) event.velocity)
+                              : juce::MidiMessage::noteOff(1, event.note);
+    int64_t eventMs = clockSync.toHostMillis(event.peer, event.timestamp);
+    int64_t nowMs = ClockSync::nowMillis();
     double deltaMs = double(eventMs - nowMs);
-    if (deltaMs < 0) return;
+    if (deltaMs < 0) {
+        // a late note_off still plays, dropping it would leave the note hanging
+        bool drop = isOn && -deltaMs > double(lateToleranceMs);
+        clockSync.recordLate(event.peer, nowMs - eventMs, drop);
+        if (drop) return;
+        deltaMs = 0;
+    }
+
+    auto enqueue = [&](const std::shared_ptr<StreamManager> &manager) {
+        double sr = manager->getSampleRate();
+        int delayS = int(deltaMs * sr / 1000.0 + 0.5);
+        manager->getAudioEngine()->enqueueMidi(m, delayS, uint64_t(event.phraseId));
+    };
+    forEachStream(enqueue);
+}
+
+// Automation rides the MIDI executor with the notes, so a phrase's parameter moves and notes
+// keep their relative order.
+void StreamController::handleAutomation(const ParameterEvent &event) {
+    auto session = getSession(event.session.empty() ? DEFAULT_SESSION : event.session);
+    if (session == nullptr) return;
 
-    double sr = manager->getSampleRate();
-    int delayS = int(deltaMs * sr / 1000.0 + 0.5);
+    double deltaMs = 0.0;
+    if (event.timestamp != 0)
+        deltaMs = std::max(0.0, double(clockSync.toHostMillis(event.peer, event.timestamp) - ClockSync::nowMillis()));
 
-    manager->getAudioEngine()->enqueueMidi(m, delayS);
+    auto automate = [&](const std::shared_ptr<StreamManager> &manager) {
+        double sr = manager->getSampleRate();
+        int delayS = int(deltaMs * sr / 1000.0 + 0.5);
+        int rampS = int(std::max(0, event.rampMs) * sr / 1000.0 + 0.5);
+        if (!manager->getAudioEngine()->automateParameter(event.parameter, float(event.value), delayS, rampS))
+            rejectedAutomation.fetch_add(1);
+    };
+    if (!session->getStreams().forEachInRole(event.role, automate)) {
+        if (auto manager = session->getStreams().find(getStreamIDForRole(event.role)))
+            automate(manager);
+    }
+}
+
+// {"action": "open_session" | "close_session" | "capacity" | "clock" | "governor" | "create" | "pause" | "resume" | "destroy",
+//  "session": "<id>", "stream": <id>, "port": <udp port>, "role": "lead", "ai": true,
+//  "max_note_ms": 8000, "max_voices": 12, "max_notes_per_second": 40}
+void StreamController::handleStreamControl(const json &j) {
+    SessionRecorder::instance().recordControl(j.dump());
+    // malformed messages are answered, not thrown: an exception here would take the control executor down
+    if (!j.is_object() || !j.contains("action") || !j["action"].is_string() || mistyped(j, "session", &json::is_string)) {
+        replyStreamControl({{"event", "error"}, {"error", "expected a string \"action\" and an optional string \"session\""}});
+        return;
+    }
+    auto action = j["action"].get<string>();
+    string session = j.value("session", DEFAULT_SESSION);
+    if (action == "capacity") {
+        replyStreamControl(reportCapacity());
+        return;
+    }
+    if (action == "clock") {
+        replyStreamControl(clockSync.report());
+        return;
+    }
+    if (action == "governor") {
+        if (!j.contains("role") || !j["role"].is_string()) {
+            replyStreamControl({{"event", "error"}, {"session", session}, {"error", "governor needs a string \"role\""}});
+            return;
+        }
+        configureGovernor(j.value("session", ""), j["role"].get<string>(), j);
+        return;
+    }
+    if (action == "open_session") {
+        if (mistyped(j, "midi_input", &json::is_string)) {
+            replyStreamControl({{"event", "error"}, {"session", session}, {"error", "\"midi_input\" must be a string"}});
+            return;
+        }
+        string midiInput = j.value("midi_input", "Minilab3 MIDI");
+        lifecycleExecutor.post([this, session, midiInput]() { openSession(session, midiInput); });
+        return;
+    }
+    if (action == "close_session") {
+        lifecycleExecutor.post([this, session]() { closeSession(session); });
+        return;
+    }
+    if (action != "create" && action != "destroy" && action != "pause" && action != "resume") {
+        replyStreamControl({{"event", "error"}, {"session", session}, {"error", "unknown action " + action}});
+        return;
+    }
+    if (!j.contains("stream") || !j["stream"].is_number_integer()) {
+        replyStreamControl({{"event", "error"}, {"session", session}, {"error", action + " needs an integer \"stream\""}});
+        return;
+    }
+    auto id = static_cast<StreamID>(j["stream"].get<int>());
+    if (action == "create") {
+        if (mistyped(j, "port", &json::is_number_integer) || mistyped(j, "role", &json::is_string)
+            || mistyped(j, "ai", &json::is_boolean)) {
+            replyStreamControl({{"event", "error"}, {"session", session}, {"stream", id},
+                                {"error", "\"port\" must be an integer, \"role\" a string and \"ai\" a boolean"}});
+            return;
+        }
+        int port = j.value("port", -1);
+        string role = j.value("role", getRoleForStreamID(id));
+        bool isAIEngine = j.value("ai", true);
+        lifecycleExecutor.post([this, session, port, id, isAIEngine, role]() {
+            createStream(session, port, id, isAIEngine, role);
+        });
+    } else if (action == "destroy") {
+        lifecycleExecutor.post([this, session, id]() { destroyStream(session, id); });
+    } else if (action == "pause") {
+        lifecycleExecutor.post([this, session, id]() { pauseStream(session, id); });
+    } else {
+        lifecycleExecutor.post([this, session, id]() { resumeStream(session, id); });
+    }
 }
@@ -4,40 +4,202 @@
 
 #ifndef STREAMCONTROLLER_H
 #define STREAMCONTROLLER_H
+#include <atomic>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <shared_mutex>
+#include <unordered_map>
 #include<nlohmann/json.hpp>
 
+#include "StreamRegistry.h"
+#include "../capture/EngineSnapshot.h"
+#include "../composer/NativeComposer.h"
+#include "../executor/InstrumentedExecutor.h"
+#include "../session/PortAllocator.h"
+#include "../session/Session.h"
 #include "../streaming/StreamManager.h"
 #include "../websocket/WebSocketClient.h"
+#include "../websocket/ClockSync.h"
+#include "../websocket/MidiEvent.h"
+#include "../websocket/ParameterEvent.h"
 using json = nlohmann::json;
 using string = std::string;
 
+// One of the streams the host starts with, see StreamController::addStreamManagers.
+struct StreamSpec {
+    int port;
+    StreamID id;
+    bool isAIEngine;
+    std::string role = "";
+    // session the stream belongs to, "" for the default one
+    std::string session = "";
+    // set when the stream is brought back from an EngineSnapshot
+    const EngineSnapshot::Stream* restore = nullptr;
+};
+
+struct ExecutorConfig {
+    // threads running the shared io_context: socket I/O and frame decoding, one strand per client
+    int ioThreads = 2;
+    // control message handling (stream control, preset fan-out); each client keeps its own ordering
+    int controlThreads = 2;
+    // preset file loads; one per stream of a session can run at the same time
+    int presetThreads = 4;
+};
+
 class StreamController {
 public:
     using JsonMethod = void (StreamController::*)(const json&);
 
-    explicit StreamController(boost::asio::io_context& ioContext);
-    void addStreamManager(int blockSize, int sampleRate, int port, StreamID id, bool isAIEngine);
-    std::shared_ptr<StreamManager> getStreamManager(StreamID id);
-    void addWebSocketClient(string host, string port, string url, WebSocketClientID id, JsonMethod onJsonMethod);
+    // Where a client's decoded messages are handled. MIDI is a single dedicated thread so note
+    // events keep their order and never wait behind control work.
+    enum class HandlerLane { CONTROL, MIDI };
+
+    // Session used by the statically configured streams and by messages without a "session" field.
+    static constexpr const char* DEFAULT_SESSION = "default";
+
+    explicit StreamController(boost::asio::io_context& ioContext, ExecutorConfig config = {});
+    void addStreamManager(int blockSize, int sampleRate, int port, StreamID id, bool isAIEngine,
+                          const string& role = "");
+    // Brings up the default session's streams concurrently, registers them in the given order and
+    // prints each one's startup phases. Instances are created one after the other on the message
+    // thread (see MessageThread); preparing them, warm-up and device start run in parallel.
+    void addStreamManagers(int blockSize, int sampleRate, const std::vector<StreamSpec>& specs);
+    // Writes every session's streams to an EngineSnapshot file.
+    bool saveSnapshot(const string& path);
+    // Brings back the sessions and streams of a snapshot in place of addStreamManagers; false
+    // (with nothing started) if the file is missing or unreadable.
+    bool restoreSnapshot(const string& path, int blockSize, int sampleRate);
+    // Saves a snapshot every interval and once more on shutdown.
+    void startSnapshots(const string& path, std::chrono::seconds interval);
+    // Prints how long after launchedAt the default session's streams sent their first audio.
+    void reportFirstAudio(std::chrono::steady_clock::time_point launchedAt, const string& mode);
+    std::shared_ptr<StreamManager> getStreamManager(StreamID id, const string& session = DEFAULT_SESSION);
+    void addWebSocketClient(string host, string port, string url, WebSocketClientID id, JsonMethod onJsonMethod,
+                            HandlerLane lane = HandlerLane::CONTROL);
+    template <typename T>
+    void addWebSocketClient(string host, string port, string url, WebSocketClientID id,
+                            const JsonSchema<T>& schema, void (StreamController::*onTypedMethod)(const T&),
+                            HandlerLane lane = HandlerLane::MIDI);
     void setMidiSenderClient(WebSocketClientID sender, StreamID streamer);
+    // CC/pitch-bend updates per second forwarded from the stream's controller input (0 = notes only).
+    void setControllerForwardRate(StreamID streamer, int rateHz);
+    // Pings the peers on the composer client's path so their timestamps can be mapped onto ours.
+    void startClockSync(std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    // Generates the AI parts in-process from the user stream's notes; its events take the same
+    // path as the bridge composer's (handleComposeOutput on the MIDI executor).
+    void enableNativeComposer(std::shared_ptr<const MusicRNN> model, NativeComposer::Config config);
+    // Hosts the role's streams created from now on through the given backend ("" is the user
+    // stream, "*" every role without its own setting).
+    void setPluginBackend(const string& role, PluginDef::Backend backend);
+    // The instrument every stream created from now on loads (Serum unless set).
+    void setPlugin(const PluginDef& plugin);
+    // AI streams created from now on render up to this far ahead of the device (0: in lock-step);
+    // see HeadlessAudioEngine::enableLookAhead.
+    void setLookAheadMillis(int millis);
+    // AI streams whose plugin has been idle for idleAfter hand their instance back and keep only
+    // its state (StreamManager::hibernate); the pool then keeps warmInstances per plugin for waking.
+    void enableHibernation(std::chrono::seconds idleAfter, int warmInstances);
     void shutdown();
+    void printStats() const;
 
     std::shared_ptr<WebSocketClient> getWebSocketClient(WebSocketClientID id);
-    std::shared_ptr<StreamManager> getStream(StreamID id);
+    std::shared_ptr<StreamManager> getStream(StreamID id, const string& session = DEFAULT_SESSION);
+    std::shared_ptr<Session> getSession(const string& id) const;
+
+    // How many more sessions fit at the current CPU load and port budget.
+    json reportCapacity() const;
 
     StreamID getStreamIDForRole(const std::string& role);
+    static string getRoleForStreamID(StreamID id);
 
     // handler methods
     void changePreset(const json& j);
-    void handleComposeOutput(const json& j);
+    void handleComposeOutput(const MidiEvent& event);
+    void handleAutomation(const ParameterEvent& event);
+    void handleStreamControl(const json& j);
 
 private:
+    // midiInput names the controller the session's user plays (see HeadlessAudioEngine::setMidiInput);
+    // a session is only opened when such a controller is free.
+    void openSession(const string& sessionID, const string& midiInput);
+    void closeSession(const string& sessionID);
+    void teardownSession(const std::shared_ptr<Session>& session);
+    void createStream(const string& sessionID, int port, StreamID id, bool isAIEngine, const string& role);
+    void destroyStream(const string& sessionID, StreamID id);
+    void pauseStream(const string& sessionID, StreamID id);
+    void resumeStream(const string& sessionID, StreamID id);
+    void replyStreamControl(json reply);
+    void loadPresets(const string& sessionID, const string& preset,
+                     std::vector<std::pair<std::shared_ptr<StreamManager>, Preset>> loads);
+    void replyPresetChange(json reply);
+    void configureGovernor(const string& sessionID, const string& role, const json& limits);
+    MidiGovernor::Config governorConfigFor(const string& role) const;
+    PluginDef pluginFor(const string& role) const;
+    void applyLookAhead(const std::shared_ptr<StreamManager>& stream) const;
+    void watchForWake(const std::shared_ptr<StreamManager>& stream);
+    void scheduleHibernation();
+    void hibernateIdleStreams();
+    void sendClockPing();
+    void scheduleSnapshot();
+    std::vector<std::shared_ptr<StreamManager>> streamsWithID(StreamID id) const;
+    void attachNativeComposer(const std::shared_ptr<StreamManager>& user);
+
     boost::asio::io_context& ioContext;
-    std::vector<std::shared_ptr<StreamManager>> streams;
-    std::vector<std::shared_ptr<WebSocketClient>> wsClients;
+    mutable std::shared_mutex sessionsMutex;
+    std::unordered_map<string, std::shared_ptr<Session>> sessions;
+    PortAllocator portAllocator{9000, 8, 64};
+    std::shared_ptr<PluginInstancePool> pluginPool = std::make_shared<PluginInstancePool>();
+    std::unordered_map<WebSocketClientID, std::shared_ptr<WebSocketClient>> wsClients;
+    InstrumentedExecutor controlExecutor;
+    InstrumentedExecutor midiExecutor{"midi", 1};
+    InstrumentedExecutor presetExecutor;
+    // stream creation/teardown (plugin load, device open/close) runs here, never on an io thread
+    InstrumentedExecutor lifecycleExecutor{"lifecycle", 1};
+    int defaultBlockSize = 512;
+    int controllerForwardRate = 0;
+    int defaultSampleRate = 48000;
+    // share of all cores the host may fill before it stops accepting sessions
+    double capacityTarget = 0.75;
+    // MIDI governor limits and plugin backends per role, applied to the role's streams as they are created
+    mutable std::mutex governorMutex;
+    std::unordered_map<string, MidiGovernor::Config> governorConfigs;
+    std::unordered_map<string, PluginDef::Backend> pluginBackends;
+    PluginDef defaultPlugin = PluginEnum::SERUM_LAPTOP;
+    int lookAheadMillis = 0;
+    ClockSync clockSync;
+    boost::asio::steady_timer clockSyncTimer;
+    std::chrono::milliseconds clockSyncInterval{1000};
+    boost::asio::steady_timer snapshotTimer;
+    string snapshotPath;
+    std::chrono::seconds snapshotInterval{30};
+    boost::asio::steady_timer hibernationTimer;
+    std::chrono::seconds hibernateAfter{0};
+    std::atomic<int64_t> hibernations{0};
+    // resident memory given back by hibernations, as seen around each one
+    std::atomic<int64_t> hibernationReleasedBytes{0};
+    // a note_on arriving later than this after its play time is dropped instead of played late
+    int64_t lateToleranceMs = 30;
+    std::unique_ptr<NativeComposer> nativeComposer;
+    // automation events naming a parameter the stream's plugin doesn't have, or that found the queue full
+    std::atomic<int64_t> rejectedAutomation{0};
 };
 
+template <typename T>
+void StreamController::addWebSocketClient(string host, string port, string url, WebSocketClientID id,
+                                          const JsonSchema<T>& schema, void (StreamController::*onTypedMethod)(const T&),
+                                          HandlerLane lane) {
+    auto wsClient = std::make_shared<WebSocketClient>(ioContext, host, port, url, id);
+    auto& executor = lane == HandlerLane::MIDI ? midiExecutor : controlExecutor;
+    auto strand = std::make_shared<InstrumentedExecutor::Strand>(executor.makeStrand());
+    wsClient->onTyped<T>(schema, [this, onTypedMethod, &executor, strand](const T& value) {
+        executor.post(*strand, [this, onTypedMethod, value]() {
+            (this->*onTypedMethod)(value);
+        });
+    });
+    wsClient->run();
+    wsClients[id] = wsClient;
+}
+
 
 
 #endif //STREAMCONTROLLER_H
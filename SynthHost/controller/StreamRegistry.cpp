@@ -0,0 +1,67 @@
+#include "StreamRegistry.h"
+
+#include <algorithm>
+#include <mutex>
+
+bool StreamRegistry::add(std::shared_ptr<StreamManager> stream, const std::string &role) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto id = stream->getStreamID();
+    if (entries.count(id) != 0) return false;
+    entries.emplace(id, Entry{std::move(stream), role, State::RUNNING});
+    if (!role.empty()) roles[role].push_back(id);
+    return true;
+}
+
+std::shared_ptr<StreamManager> StreamRegistry::remove(StreamID id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end()) return nullptr;
+    auto stream = std::move(it->second.stream);
+    auto roleIt = roles.find(it->second.role);
+    if (roleIt != roles.end()) {
+        auto& ids = roleIt->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        if (ids.empty()) roles.erase(roleIt);
+    }
+    entries.erase(it);
+    return stream;
+}
+
+std::shared_ptr<StreamManager> StreamRegistry::find(StreamID id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = entries.find(id);
+    return it == entries.end() ? nullptr : it->second.stream;
+}
+
+bool StreamRegistry::contains(StreamID id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return entries.count(id) != 0;
+}
+
+bool StreamRegistry::setState(StreamID id, State state) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end() || it->second.state == state) return false;
+    it->second.state = state;
+    return true;
+}
+
+std::vector<std::shared_ptr<StreamManager>> StreamRegistry::all() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<std::shared_ptr<StreamManager>> streams;
+    streams.reserve(entries.size());
+    for (const auto& entry: entries) {
+        streams.push_back(entry.second.stream);
+    }
+    return streams;
+}
+
+std::vector<StreamRegistry::Listing> StreamRegistry::list() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<Listing> listing;
+    listing.reserve(entries.size());
+    for (const auto& entry: entries) {
+        listing.push_back({entry.second.stream, entry.second.role, entry.second.state});
+    }
+    return listing;
+}
@@ -0,0 +1,67 @@
+#ifndef STREAMREGISTRY_H
+#define STREAMREGISTRY_H
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../streaming/StreamManager.h"
+
+// Live set of StreamManagers keyed by StreamID, plus the role -> streams index used to route
+// composer output (several streams may share a role, e.g. extra lead layers).
+// Lookups take a shared lock and are O(1); mutations come from the lifecycle worker.
+class StreamRegistry {
+public:
+    enum class State { RUNNING, PAUSED };
+
+    bool add(std::shared_ptr<StreamManager> stream, const std::string& role);
+
+    std::shared_ptr<StreamManager> remove(StreamID id);
+
+    std::shared_ptr<StreamManager> find(StreamID id) const;
+
+    bool contains(StreamID id) const;
+
+    bool setState(StreamID id, State state);
+
+    std::vector<std::shared_ptr<StreamManager>> all() const;
+
+    struct Listing {
+        std::shared_ptr<StreamManager> stream;
+        std::string role;
+        State state;
+    };
+
+    // Every stream with its role and state, e.g. for an EngineSnapshot.
+    std::vector<Listing> list() const;
+
+    // Calls f for every running (or, with runningOnly = false, every) stream registered under role.
+    template <typename F>
+    bool forEachInRole(const std::string& role, F&& f, bool runningOnly = true) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = roles.find(role);
+        if (it == roles.end()) return false;
+        bool any = false;
+        for (auto id: it->second) {
+            auto& entry = entries.at(id);
+            if (runningOnly && entry.state != State::RUNNING) continue;
+            f(entry.stream);
+            any = true;
+        }
+        return any;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<StreamManager> stream;
+        std::string role;
+        State state = State::RUNNING;
+    };
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<StreamID, Entry> entries;
+    std::unordered_map<std::string, std::vector<StreamID>> roles;
+};
+
+#endif //STREAMREGISTRY_H
@@ -0,0 +1,17 @@
+#include "InstrumentedExecutor.h"
+
+#include <iostream>
+
+InstrumentedExecutor::InstrumentedExecutor(std::string name, int threads)
+    : name(std::move(name)), threads(threads), pool(threads) {
+}
+
+void InstrumentedExecutor::join() {
+    pool.join();
+}
+
+void InstrumentedExecutor::printStats() const {
+    std::cout << "[executor " << name << "] threads: " << threads << " | pending: " << pending.load()
+              << " | queue latency: " << queueLatency.summary()
+              << " | run time: " << runTime.summary() << std::endl;
+}
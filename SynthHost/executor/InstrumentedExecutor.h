@@ -0,0 +1,60 @@
+#ifndef INSTRUMENTEDEXECUTOR_H
+#define INSTRUMENTEDEXECUTOR_H
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include "ThreadPolicy.h"
+#include "../utils/LatencyStats.h"
+
+// A named thread pool that records how long each posted job waited before it started
+// (queue latency) and how long it ran. Jobs posted through the same Strand run in order.
+class InstrumentedExecutor {
+public:
+    using Strand = boost::asio::strand<boost::asio::thread_pool::executor_type>;
+
+    InstrumentedExecutor(std::string name, int threads);
+
+    Strand makeStrand() { return boost::asio::make_strand(pool.get_executor()); }
+
+    template <typename F>
+    void post(F&& f) {
+        boost::asio::post(pool, wrap(std::forward<F>(f)));
+    }
+
+    template <typename F>
+    void post(Strand& strand, F&& f) {
+        boost::asio::post(strand, wrap(std::forward<F>(f)));
+    }
+
+    void join();
+
+    void printStats() const;
+
+private:
+    template <typename F>
+    auto wrap(F&& f) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        return [this, queuedAt = std::chrono::steady_clock::now(), f = std::forward<F>(f)]() mutable {
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            // boost starts the pool's threads, so they take on the policy with their first job
+            ThreadPolicy::instance().applyOnce(ThreadPolicy::Role::WORKER);
+            queueLatency.record(queuedAt);
+            auto started = std::chrono::steady_clock::now();
+            f();
+            runTime.record(started);
+        };
+    }
+
+    std::string name;
+    int threads;
+    boost::asio::thread_pool pool;
+    std::atomic<int> pending{0};
+    LatencyStats queueLatency;
+    LatencyStats runTime;
+};
+
+#endif //INSTRUMENTEDEXECUTOR_H
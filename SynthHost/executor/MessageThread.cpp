@@ -0,0 +1,43 @@
+#include "MessageThread.h"
+#include "ThreadPolicy.h"
+
+MessageThread& MessageThread::instance() {
+    static MessageThread messageThread;
+    return messageThread;
+}
+
+MessageThread::~MessageThread() {
+    stop();
+}
+
+void MessageThread::start() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (thread.joinable())
+        return;
+    thread = std::thread([this]() { run(); });
+    started.wait(lock, [this]() { return running.load(); });
+}
+
+void MessageThread::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!thread.joinable())
+        return;
+    // callers from now on run in place; what was posted before is still dispatched ahead of the quit
+    running.store(false);
+    juce::MessageManager::getInstance()->stopDispatchLoop();
+    thread.join();
+}
+
+void MessageThread::run() {
+    ThreadPolicy::instance().applyToCurrentThread(ThreadPolicy::Role::WORKER);
+    juce::initialiseJuce_GUI();
+    auto* messageManager = juce::MessageManager::getInstance();
+    messageManager->setCurrentThreadAsMessageThread();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running.store(true);
+    }
+    started.notify_all();
+    messageManager->runDispatchLoop();
+    juce::shutdownJuce_GUI();
+}
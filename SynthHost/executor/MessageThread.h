@@ -0,0 +1,52 @@
+#ifndef MESSAGETHREAD_H
+#define MESSAGETHREAD_H
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <juce_events/juce_events.h>
+
+// JUCE's message thread. main() waits on stdin, so the dispatch loop runs on a thread of its own,
+// started before anything touches the MessageManager. Plugin formats want instances created,
+// given their state and destroyed there; JUCE's VST3 host marshals some of that itself
+// (callOnMessageThread, MessageManagerLock), which only returns once this loop picks it up.
+// Threads with such work hand it over with call().
+class MessageThread {
+public:
+    static MessageThread& instance();
+
+    ~MessageThread();
+
+    void start();
+
+    // Once nothing is left to create or destroy a plugin.
+    void stop();
+
+    // Runs f on the message thread, waits for it and returns its result (or rethrows). f runs in
+    // place on the message thread itself and when no loop is running, as for replay and the
+    // benchmarks, which drive JUCE from their main thread.
+    template <typename F>
+    auto call(F&& f) -> std::invoke_result_t<F&> {
+        if (!running.load() || juce::MessageManager::getInstance()->isThisTheMessageThread())
+            return f();
+        std::packaged_task<std::invoke_result_t<F&>()> task(std::forward<F>(f));
+        auto result = task.get_future();
+        if (!juce::MessageManager::callAsync([&task]() { task(); }))
+            task();
+        return result.get();
+    }
+
+private:
+    MessageThread() = default;
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable started;
+    std::thread thread;
+    std::atomic<bool> running{false};
+};
+
+#endif //MESSAGETHREAD_H
@@ -0,0 +1,258 @@
+#include "ThreadPolicy.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <juce_core/juce_core.h>
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+ThreadPolicy& ThreadPolicy::instance() {
+    static ThreadPolicy policy;
+    return policy;
+}
+
+void ThreadPolicy::configure(const Config& newConfig) {
+    std::lock_guard<std::mutex> lock(mutex);
+    config = newConfig;
+    if (config.lockMemory && !memoryLocked)
+        memoryLocked = lockMemory(memoryError);
+}
+
+void ThreadPolicy::applyToCurrentThread(Role role, int slot) {
+    auto outcome = apply(role, slot);
+    if (outcome.error.empty())
+        applied[int(role)].fetch_add(1);
+    else
+        refused[int(role)].fetch_add(1);
+}
+
+void ThreadPolicy::applyOnce(Role role, int slot) {
+    static thread_local bool done = false;
+    if (done)
+        return;
+    done = true;
+    applyToCurrentThread(role, slot);
+}
+
+ThreadPolicy::Outcome ThreadPolicy::apply(Role role, int slot) {
+    Config current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = config;
+    }
+    Outcome outcome;
+    std::string error;
+
+    bool realtime = role == Role::RENDER || role == Role::LOOKAHEAD || role == Role::STREAMING;
+    if (current.realtimePriority > 0 && (realtime || role == Role::LOGGING)) {
+        outcome.priority = setPriority(role, current.realtimePriority, error);
+        if (!outcome.priority)
+            outcome.error = "priority: " + error;
+    }
+
+    std::vector<int> cores;
+    if (role == Role::RENDER) {
+        if (!current.renderCores.empty())
+            cores.push_back(current.renderCores[size_t(slot) % current.renderCores.size()]);
+    } else if (role == Role::LOOKAHEAD && current.renderCores.size() > 1) {
+        cores = current.renderCores;
+        cores.erase(cores.begin() + long(size_t(slot) % cores.size()));
+    } else {
+        cores = current.systemCores;
+    }
+    if (!cores.empty()) {
+        outcome.affinity = setAffinity(cores, error);
+        if (!outcome.affinity)
+            outcome.error += (outcome.error.empty() ? "affinity: " : "; affinity: ") + error;
+    }
+
+    // touch the stack now so the first deep call in the audio path doesn't fault it in
+    if (current.lockMemory && realtime)
+        prefaultStack();
+    return outcome;
+}
+
+bool ThreadPolicy::setPriority(Role role, int realtimePriority, std::string& error) {
+#if JUCE_WINDOWS
+    int priority = role == Role::RENDER ? THREAD_PRIORITY_TIME_CRITICAL
+                   : role == Role::STREAMING ? THREAD_PRIORITY_HIGHEST
+                   : role == Role::LOOKAHEAD ? THREAD_PRIORITY_ABOVE_NORMAL
+                   : THREAD_PRIORITY_LOWEST;
+    if (SetThreadPriority(GetCurrentThread(), priority))
+        return true;
+    error = "SetThreadPriority failed (" + std::to_string(GetLastError()) + ")";
+    return false;
+#else
+    int policy = SCHED_FIFO;
+    sched_param param{};
+    if (role == Role::LOGGING) {
+#ifdef SCHED_IDLE
+        policy = SCHED_IDLE;
+#else
+        policy = SCHED_OTHER;
+#endif
+    } else {
+        // senders run just below the renderers they drain, look-ahead workers (which have the
+        // horizon to catch up in) below both
+        int priority = role == Role::RENDER ? realtimePriority
+                       : role == Role::STREAMING ? realtimePriority - 10
+                       : realtimePriority - 20;
+        param.sched_priority = juce::jlimit(sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO),
+                                            priority);
+    }
+    int result = pthread_setschedparam(pthread_self(), policy, &param);
+    if (result == 0)
+        return true;
+    error = std::strerror(result);
+    return false;
+#endif
+}
+
+bool ThreadPolicy::setAffinity(const std::vector<int>& cores, std::string& error) {
+#if JUCE_WINDOWS
+    DWORD_PTR mask = 0;
+    for (int core: cores)
+        if (core >= 0 && core < int(sizeof(DWORD_PTR) * 8))
+            mask |= DWORD_PTR(1) << core;
+    if (mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0)
+        return true;
+    error = "SetThreadAffinityMask failed (" + std::to_string(GetLastError()) + ")";
+    return false;
+#elif JUCE_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core: cores)
+        if (core >= 0 && core < CPU_SETSIZE)
+            CPU_SET(core, &set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result == 0)
+        return true;
+    error = std::strerror(result);
+    return false;
+#else
+    juce::ignoreUnused(cores);
+    error = "not supported on this platform";
+    return false;
+#endif
+}
+
+bool ThreadPolicy::lockMemory(std::string& error) {
+#if JUCE_WINDOWS
+    error = "not supported on Windows";
+    return false;
+#else
+    // Locking future mappings too makes every later allocation fail once the memlock limit is
+    // reached, so that is only asked for when there is no limit.
+    rlimit limit{};
+    int flags = MCL_CURRENT;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY)
+        flags |= MCL_FUTURE;
+    if (mlockall(flags) != 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    if ((flags & MCL_FUTURE) == 0)
+        error = "later allocations unlocked, memlock limit is finite";
+    return true;
+#endif
+}
+
+void ThreadPolicy::prefaultStack() {
+    [[maybe_unused]] volatile char stack[STACK_PREFAULT_BYTES];
+    for (size_t i = 0; i < STACK_PREFAULT_BYTES; i += 4096)
+        stack[i] = 0;
+}
+
+void ThreadPolicy::selfCheck() {
+    Config current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = config;
+    }
+    if (current.realtimePriority == 0 && current.renderCores.empty() && current.systemCores.empty()
+        && !current.lockMemory) {
+        std::cout << "[threads] default scheduling (no --rt-priority, --render-cores, --system-cores or --lock-memory)"
+                  << std::endl;
+        return;
+    }
+
+    if (current.lockMemory) {
+        // without MCL_FUTURE only what was mapped at configure() is locked; take in the plugins,
+        // ring buffers and thread stacks the streams have set up since
+        std::lock_guard<std::mutex> lock(mutex);
+        memoryLocked = lockMemory(memoryError);
+    }
+
+    Outcome render, system;
+    std::thread([&]() { render = apply(Role::RENDER, 0); }).join();
+    std::thread([&]() { system = apply(Role::NETWORK, 0); }).join();
+
+    auto join = [](const std::vector<int>& cores) {
+        std::ostringstream out;
+        for (size_t i = 0; i < cores.size(); ++i)
+            out << (i > 0 ? "," : "") << cores[i];
+        return out.str();
+    };
+    std::cout << "[threads] self-check";
+    if (current.realtimePriority > 0)
+        std::cout << " | real-time priority " << current.realtimePriority << ": " << (render.priority ? "ok" : "refused");
+    if (!current.renderCores.empty())
+        std::cout << " | render cores " << join(current.renderCores) << ": " << (render.affinity ? "ok" : "refused");
+    if (!current.systemCores.empty())
+        std::cout << " | system cores " << join(current.systemCores) << ": " << (system.affinity ? "ok" : "refused");
+    if (current.lockMemory) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << " | memory locked: " << (memoryLocked ? "yes" : "no");
+        if (!memoryError.empty())
+            std::cout << " (" << memoryError << ")";
+    }
+    std::cout << std::endl;
+    if (!render.error.empty())
+        std::cout << "[threads] render threads: " << render.error << std::endl;
+    if (!system.error.empty())
+        std::cout << "[threads] system threads: " << system.error << std::endl;
+}
+
+void ThreadPolicy::printStats() const {
+    std::cout << "[threads]";
+    for (int role = 0; role < ROLES; ++role)
+        std::cout << (role > 0 ? " |" : "") << " " << roleName(Role(role)) << " " << applied[role].load()
+                  << " applied, " << refused[role].load() << " refused";
+    std::cout << std::endl;
+}
+
+std::vector<int> ThreadPolicy::parseCores(const std::string& list) {
+    std::vector<int> cores;
+    std::stringstream in(list);
+    for (std::string item; std::getline(in, item, ',');) {
+        auto dash = item.find('-');
+        int first = std::atoi(item.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(item.substr(dash + 1).c_str());
+        for (int core = first; core <= last; ++core)
+            cores.push_back(core);
+    }
+    return cores;
+}
+
+const char* ThreadPolicy::roleName(Role role) {
+    switch (role) {
+        case Role::RENDER: return "render";
+        case Role::LOOKAHEAD: return "look-ahead";
+        case Role::STREAMING: return "streaming";
+        case Role::NETWORK: return "network";
+        case Role::WORKER: return "worker";
+        case Role::LOGGING: return "logging";
+    }
+    return "?";
+}
@@ -0,0 +1,84 @@
+#ifndef THREADPOLICY_H
+#define THREADPOLICY_H
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide scheduling policy for every thread SynthHost runs. Each thread applies it to
+// itself once, by role, when it starts (or on its first job / first audio callback for threads
+// created by boost or the audio driver):
+//   RENDER     audio callbacks: real-time priority, pinned to their stream's core
+//              (renderCores[slot % n], the slot being the stream's port)
+//   LOOKAHEAD  look-ahead workers, which render up to a horizon ahead of the callback: real-time
+//              priority below STREAMING, on the render cores other than their stream's (the system
+//              cores with fewer than two render cores), so they never preempt a callback
+//   STREAMING  UDP senders: real-time priority below RENDER, on the system cores
+//   NETWORK    io threads and MIDI forwarding, on the system cores
+//   WORKER     executor pools and the native composer, on the system cores
+//   LOGGING    capture flushing, on the system cores at the lowest priority
+// Nothing is changed for a setting left at its default, and a policy the OS refuses (no
+// CAP_SYS_NICE, rtprio or memlock limit too low, ...) is counted and reported, never fatal.
+class ThreadPolicy {
+public:
+    enum class Role { RENDER, LOOKAHEAD, STREAMING, NETWORK, WORKER, LOGGING };
+
+    struct Config {
+        // SCHED_FIFO priority of RENDER threads (Linux/macOS, 1-99; time-critical on Windows); 0 = off
+        int realtimePriority = 0;
+        std::vector<int> renderCores;
+        std::vector<int> systemCores;
+        // mlockall (MCL_FUTURE too when the memlock limit allows) and pre-faulted stacks on real-time threads
+        bool lockMemory = false;
+    };
+
+    static ThreadPolicy& instance();
+
+    // Before any thread starts.
+    void configure(const Config& config);
+
+    // Applies the role's policy to the calling thread; slot picks a RENDER thread's core (and the
+    // one a LOOKAHEAD thread stays off).
+    void applyToCurrentThread(Role role, int slot = 0);
+
+    // applyToCurrentThread() on a thread's first call only, for threads SynthHost doesn't start itself.
+    void applyOnce(Role role, int slot = 0);
+
+    // Once the streams are up: locks memory again (see lockMemory()), tries each configured policy
+    // on a scratch thread and prints which of them took effect.
+    void selfCheck();
+
+    void printStats() const;
+
+    // "2,3,5-7" -> {2, 3, 5, 6, 7}
+    static std::vector<int> parseCores(const std::string& list);
+
+private:
+    struct Outcome {
+        bool priority = false;
+        bool affinity = false;
+        std::string error;
+    };
+
+    static constexpr size_t STACK_PREFAULT_BYTES = 256 * 1024;
+    static constexpr int ROLES = 6;
+
+    ThreadPolicy() = default;
+
+    Outcome apply(Role role, int slot);
+    static bool setPriority(Role role, int realtimePriority, std::string& error);
+    static bool setAffinity(const std::vector<int>& cores, std::string& error);
+    bool lockMemory(std::string& error);
+    static void prefaultStack();
+    static const char* roleName(Role role);
+
+    mutable std::mutex mutex;
+    Config config;
+    bool memoryLocked = false;
+    std::string memoryError;
+    std::atomic<int> applied[ROLES]{};
+    std::atomic<int> refused[ROLES]{};
+};
+
+#endif //THREADPOLICY_H
@@ -1,4 +1,13 @@
 #include "controller/StreamController.h"
+#include "benchmark/Benchmarks.h"
+#include "capture/SessionRecorder.h"
+#include "capture/SessionReplay.h"
+#include "executor/MessageThread.h"
+#include "executor/ThreadPolicy.h"
+#include "vst_hosting/PluginScanCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <boost/asio/io_context.hpp>
 
@@ -7,27 +16,139 @@
 
 using IoContext = boost::asio::io_context;
 
-int main()
+int main(int argc, char* argv[])
 {
-    IoContext ioContext;
-    StreamController controller{ioContext};
-    controller.addStreamManager(BLOCK_SIZE, SAMPLE_RATE, 9000, USER, false);
-    controller.addStreamManager(BLOCK_SIZE, SAMPLE_RATE, 9001, AI_BASS, true);
-    controller.addStreamManager(BLOCK_SIZE, SAMPLE_RATE, 9002, AI_LEAD, true);
-    controller.addStreamManager(BLOCK_SIZE, SAMPLE_RATE, 9003, AI_PAD, true);
-    controller.addStreamManager(BLOCK_SIZE, SAMPLE_RATE, 9004, AI_PLUCK, true);
+    auto launchedAt = std::chrono::steady_clock::now();
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+        return Benchmarks::run(argc > 2 ? argv[2] : "all", argc > 3 ? argv[3] : "");
+    // --replay <capture> [realtime]
+    if (argc > 2 && std::string(argv[1]) == "--replay")
+    {
+        SessionReplay::Options options;
+        options.realtime = argc > 3 && std::string(argv[3]) == "realtime";
+        options.blockSize = 2 * BLOCK_SIZE;
+        return SessionReplay::run(argv[2], options);
+    }
+
+    ExecutorConfig executorConfig;
+    int controllerForwardRate = 0;
+    std::string nativeComposerWeights;
+    NativeComposer::Config composerConfig;
+    // roles hosted on the direct VST3 backend / replaced by the built-in synth: "bass", "user", ... or "all"
+    std::vector<std::string> directRoles;
+    std::vector<std::string> nativeRoles;
+    // "serum", "test-synth" (the bundled mda JX10) or a .vst3 path
+    std::string pluginName = "serum";
+    // warm restarts: streams come back from this file if it holds a snapshot, and it is rewritten
+    // every snapshotInterval seconds and on exit
+    std::string snapshotPath;
+    int snapshotInterval = 30;
+    // AI streams on the built-in synth render this far ahead of the device (0: in lock-step)
+    int lookAheadMs = 0;
+    // AI streams idle this long hand their plugin instance back (0: never); the pool keeps
+    // warmInstances per plugin to wake them from
+    int hibernateAfter = 0;
+    int warmInstances = 2;
+    // real-time scheduling, core pinning and memory locking (see ThreadPolicy); all off by default
+    ThreadPolicy::Config threadConfig;
+    std::string capturePath;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--io-threads") executorConfig.ioThreads = std::max(1, std::atoi(argv[i + 1]));
+        if (option == "--control-threads") executorConfig.controlThreads = std::max(1, std::atoi(argv[i + 1]));
+        if (option == "--preset-threads") executorConfig.presetThreads = std::max(1, std::atoi(argv[i + 1]));
+        if (option == "--cc-rate") controllerForwardRate = std::max(0, std::atoi(argv[i + 1]));
+        if (option == "--capture") capturePath = argv[i + 1];
+        if (option == "--native-composer") nativeComposerWeights = argv[i + 1];
+        if (option == "--native-key") composerConfig.defaultKey = argv[i + 1];
+        if (option == "--scan-cache") PluginScanCache::instance().setCacheFile(juce::File(argv[i + 1]));
+        if (option == "--vst3-direct") directRoles.push_back(argv[i + 1]);
+        if (option == "--native-synth") nativeRoles.push_back(argv[i + 1]);
+        if (option == "--plugin") pluginName = argv[i + 1];
+        if (option == "--snapshot") snapshotPath = argv[i + 1];
+        if (option == "--snapshot-interval") snapshotInterval = std::max(1, std::atoi(argv[i + 1]));
+        if (option == "--look-ahead-ms") lookAheadMs = std::max(0, std::atoi(argv[i + 1]));
+        if (option == "--hibernate-after") hibernateAfter = std::max(0, std::atoi(argv[i + 1]));
+        if (option == "--warm-instances") warmInstances = std::max(0, std::atoi(argv[i + 1]));
+        if (option == "--rt-priority") threadConfig.realtimePriority = std::max(0, std::atoi(argv[i + 1]));
+        if (option == "--render-cores") threadConfig.renderCores = ThreadPolicy::parseCores(argv[i + 1]);
+        if (option == "--system-cores") threadConfig.systemCores = ThreadPolicy::parseCores(argv[i + 1]);
+        if (option == "--lock-memory") threadConfig.lockMemory = std::string(argv[i + 1]) == "on";
+    }
+    // before any thread starts, the capture's flush thread included
+    ThreadPolicy::instance().configure(threadConfig);
+    if (!capturePath.empty())
+        SessionRecorder::instance().start(capturePath, SAMPLE_RATE);
+    // plugins are created and destroyed on it from here on; it stops after the controller is gone
+    MessageThread::instance().start();
+
+    IoContext ioContext{executorConfig.ioThreads};
+    StreamController controller{ioContext, executorConfig};
+    controller.setPlugin(PluginEnum::fromName(pluginName));
+    controller.setLookAheadMillis(lookAheadMs);
+    for (const auto& role : directRoles)
+        controller.setPluginBackend(role == "all" ? "*" : role == "user" ? "" : role, PluginDef::Backend::VST3_DIRECT);
+    for (const auto& role : nativeRoles)
+        controller.setPluginBackend(role == "all" ? "*" : role == "user" ? "" : role, PluginDef::Backend::NATIVE);
+    auto startupBegan = std::chrono::steady_clock::now();
+    bool restored = !snapshotPath.empty() && controller.restoreSnapshot(snapshotPath, BLOCK_SIZE, SAMPLE_RATE);
+    if (!restored)
+    {
+        controller.addStreamManagers(BLOCK_SIZE, SAMPLE_RATE, {
+            {9000, USER, false},
+            {9001, AI_BASS, true},
+            {9002, AI_LEAD, true},
+            {9003, AI_PAD, true},
+            {9004, AI_PLUCK, true},
+        });
+    }
+    auto startupMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startupBegan).count();
+    std::cout << "[startup] streams ready in " << startupMs << " ms ("
+              << (PluginScanCache::instance().getScanCount() == 0 ? "warm" : "cold") << " plugin scan cache"
+              << (restored ? ", restored from snapshot" : "") << ")\n";
+    ThreadPolicy::instance().selfCheck();
+    controller.reportFirstAudio(launchedAt, restored ? "restored from snapshot" : "fresh start");
+    if (!snapshotPath.empty())
+        controller.startSnapshots(snapshotPath, std::chrono::seconds(snapshotInterval));
+    if (hibernateAfter > 0)
+        controller.enableHibernation(std::chrono::seconds(hibernateAfter), warmInstances);
     controller.addWebSocketClient("localhost", "8080", "/user/preset", PRESET_CHANGER, &StreamController::changePreset);
     controller.addWebSocketClient("localhost", "8080", "/user/input", USER_INPUT, nullptr);
     controller.setMidiSenderClient(USER_INPUT, USER);
-    controller.addWebSocketClient("localhost", "8080", "/composer/output", COMPOSER_OUTPUT, &StreamController::handleComposeOutput);
-    std::thread ioThread([&] { ioContext.run(); });
-    std::cout << "Type `quit` + Enter to exit.\n";
+    controller.setControllerForwardRate(USER, controllerForwardRate);
+    controller.addWebSocketClient("localhost", "8080", "/composer/output", COMPOSER_OUTPUT, MidiEvent::schema(),
+                                  &StreamController::handleComposeOutput);
+    controller.addWebSocketClient("localhost", "8080", "/host/streams", STREAM_CONTROL, &StreamController::handleStreamControl);
+    controller.addWebSocketClient("localhost", "8080", "/host/automation", AUTOMATION, ParameterEvent::schema(),
+                                  &StreamController::handleAutomation);
+    controller.startClockSync();
+    if (!nativeComposerWeights.empty())
+    {
+        auto model = std::make_shared<MusicRNN>();
+        std::string error;
+        if (model->load(nativeComposerWeights, error))
+            controller.enableNativeComposer(model, composerConfig);
+        else
+            std::cout << "[composer] " << error << std::endl;
+    }
+    std::vector<std::thread> ioThreads;
+    for (int i = 0; i < executorConfig.ioThreads; ++i)
+        ioThreads.emplace_back([&] {
+            ThreadPolicy::instance().applyToCurrentThread(ThreadPolicy::Role::NETWORK);
+            ioContext.run();
+        });
+    std::cout << "Type `quit` + Enter to exit, `stats` to print runtime metrics.\n";
     for (std::string line; std::getline(std::cin, line);)
     {
         if (line == "quit") break;
+        if (line == "stats") controller.printStats();
     }
     controller.shutdown();
+    SessionRecorder::instance().stop();
     ioContext.stop();
-    ioThread.join();
+    for (auto& ioThread : ioThreads)
+        ioThread.join();
     return 0;
 }
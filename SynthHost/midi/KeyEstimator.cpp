@@ -0,0 +1,135 @@
+#include "KeyEstimator.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+namespace {
+    // Krumhansl-Kessler probe-tone profiles (music21's KrumhanslSchmuckler weights), tonic first
+    constexpr double MAJOR[12] = {6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88};
+    constexpr double MINOR[12] = {6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17};
+
+    // profiles[k][pc]: key k = tonic (0..11) major, 12 + tonic minor; centred and scaled to unit norm
+    struct Profiles {
+        double weight[24][12];
+
+        Profiles() {
+            for (int mode = 0; mode < 2; ++mode) {
+                const double* base = mode == 0 ? MAJOR : MINOR;
+                double mean = 0.0;
+                for (int i = 0; i < 12; ++i)
+                    mean += base[i] / 12.0;
+                double norm = 0.0;
+                for (int i = 0; i < 12; ++i)
+                    norm += (base[i] - mean) * (base[i] - mean);
+                norm = std::sqrt(norm);
+                for (int tonic = 0; tonic < 12; ++tonic)
+                    for (int pc = 0; pc < 12; ++pc)
+                        weight[mode * 12 + tonic][pc] = (base[(pc - tonic + 12) % 12] - mean) / norm;
+            }
+        }
+    };
+
+    const Profiles& profiles() {
+        static const Profiles p;
+        return p;
+    }
+
+    const char* const MUSIC21_NAMES[12] = {"C", "C#", "D", "E-", "E", "F", "F#", "G", "G#", "A", "B-", "B"};
+    const char* const SHARP_NAMES[12] = {"c", "c#", "d", "d#", "e", "f", "f#", "g", "g#", "a", "a#", "b"};
+    const char* const FLAT_NAMES[12] = {"c", "db", "d", "eb", "e", "f", "gb", "g", "ab", "a", "bb", "b"};
+}
+
+std::string KeyEstimator::Estimate::name() const {
+    if (!valid())
+        return "";
+    return std::string(MUSIC21_NAMES[tonic]) + (minor ? " minor" : " major");
+}
+
+std::vector<std::string> KeyEstimator::Estimate::composerNames() const {
+    std::vector<std::string> names;
+    if (!valid())
+        return names;
+    std::string suffix = minor ? "min" : "";
+    std::string music21 = MUSIC21_NAMES[tonic];
+    for (auto& ch : music21)
+        ch = (char) std::tolower((unsigned char) ch);
+    for (const std::string& tonicName : {music21, std::string(FLAT_NAMES[tonic]), std::string(SHARP_NAMES[tonic])}) {
+        auto candidate = tonicName + suffix;
+        bool seen = false;
+        for (const auto& name : names)
+            seen = seen || name == candidate;
+        if (!seen)
+            names.push_back(candidate);
+    }
+    return names;
+}
+
+KeyEstimator::KeyEstimator(double halfLifeSeconds, int minNotes)
+    : halfLife(halfLifeSeconds), minNotes(minNotes) {
+    profiles();
+}
+
+void KeyEstimator::reset() {
+    histogram.fill(0.0);
+    correlations.fill(0.0);
+    notes = 0;
+    estimate = {};
+}
+
+void KeyEstimator::decayTo(double timeSeconds) {
+    double elapsed = timeSeconds - lastTime;
+    lastTime = timeSeconds;
+    if (notes == 0 || elapsed <= 0.0)
+        return;
+    double factor = std::exp2(-elapsed / halfLife);
+    for (auto& bin : histogram)
+        bin *= factor;
+    for (auto& dot : correlations)
+        dot *= factor;
+}
+
+const KeyEstimator::Estimate& KeyEstimator::addNote(int midiNote, double timeSeconds, double weight) {
+    decayTo(timeSeconds);
+    int pc = ((midiNote % 12) + 12) % 12;
+    histogram[pc] += weight;
+    const auto& p = profiles();
+    for (int k = 0; k < 24; ++k)
+        correlations[k] += weight * p.weight[k][pc];
+    ++notes;
+    estimate = pick(correlations);
+    return estimate;
+}
+
+KeyEstimator::Estimate KeyEstimator::pick(const std::array<double, 24>& dots) const {
+    Estimate best;
+    if (notes < minNotes)
+        return best;
+
+    // profiles are centred, so dot / |x - mean(x)| is the Pearson correlation
+    double sum = 0.0, sumSq = 0.0;
+    for (double bin : histogram) {
+        sum += bin;
+        sumSq += bin * bin;
+    }
+    double spread = std::sqrt(std::max(0.0, sumSq - sum * sum / 12.0));
+    if (spread <= 1e-12)
+        return best;
+
+    int bestKey = 0;
+    for (int k = 1; k < 24; ++k)
+        if (dots[k] > dots[bestKey])
+            bestKey = k;
+    best.tonic = bestKey % 12;
+    best.minor = bestKey >= 12;
+    best.confidence = dots[bestKey] / spread;
+    return best;
+}
+
+KeyEstimator::Estimate KeyEstimator::recompute() const {
+    std::array<double, 24> dots{};
+    const auto& p = profiles();
+    for (int k = 0; k < 24; ++k)
+        for (int pc = 0; pc < 12; ++pc)
+            dots[k] += histogram[pc] * p.weight[k][pc];
+    return pick(dots);
+}
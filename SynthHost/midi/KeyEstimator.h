@@ -0,0 +1,51 @@
+#ifndef KEYESTIMATOR_H
+#define KEYESTIMATOR_H
+#include <array>
+#include <string>
+#include <vector>
+
+// Streaming Krumhansl-Schmuckler key finder over the user's note-ons.
+//
+// Pitch classes go into a histogram that decays exponentially with time (halfLifeSeconds), which
+// plays the role of KeyDetector.py's sliding window. The histogram's dot product with each of the
+// 24 mean-centred, unit-norm key profiles is kept up to date as notes arrive: decay scales all of
+// them alike and a new note adds one profile column, so an update costs O(24) instead of
+// re-correlating the whole window.
+class KeyEstimator {
+public:
+    struct Estimate {
+        int tonic = -1;          // pitch class, -1 until enough notes were seen
+        bool minor = false;
+        double confidence = 0.0; // Pearson correlation of the winning profile, -1..1
+
+        bool valid() const { return tonic >= 0; }
+        // music21's spelling, as KeyDetector.py reports it: "E- major", "C# minor"
+        std::string name() const;
+        // the names SynthComposer's models may use for this key ("e-", "eb", "d#"; "...min" for minor)
+        std::vector<std::string> composerNames() const;
+    };
+
+    explicit KeyEstimator(double halfLifeSeconds = 2.5, int minNotes = 5);
+
+    // Adds a note-on at timeSeconds (monotonic) and returns the updated estimate.
+    const Estimate& addNote(int midiNote, double timeSeconds, double weight = 1.0);
+    const Estimate& current() const { return estimate; }
+    void reset();
+
+    // Same result computed from scratch; reference for the benchmark.
+    Estimate recompute() const;
+
+private:
+    void decayTo(double timeSeconds);
+    Estimate pick(const std::array<double, 24>& dots) const;
+
+    double halfLife;
+    int minNotes;
+    std::array<double, 12> histogram{};
+    std::array<double, 24> correlations{};  // histogram . profile[k], unnormalised
+    double lastTime = 0.0;
+    int notes = 0;
+    Estimate estimate;
+};
+
+#endif //KEYESTIMATOR_H
@@ -3,8 +3,22 @@
 //
 
 #include "MidiInputCollector.h"
+#include "../capture/SessionRecorder.h"
+#include "../executor/ThreadPolicy.h"
 
 
+MidiInputCollector::MidiInputCollector() {
+    dirtyControllers.reserve(pendingControllers.size());
+    forwardThread = std::thread([this]() { forwardLoop(); });
+}
+
+MidiInputCollector::~MidiInputCollector() {
+    forwarding.store(false);
+    forwardWakeup.signal();
+    if (forwardThread.joinable())
+        forwardThread.join();
+}
+
 void MidiInputCollector::logMidiMessage(const juce::MidiMessage& message)
 {
     if (message.isNoteOn())
@@ -40,32 +54,184 @@ void MidiInputCollector::logMidiMessage(const juce::MidiMessage& message)
 }
 
 
+// Runs on the MIDI driver thread: no console I/O, no allocation, no locks besides the
+// MidiMessageCollector's own. Everything else happens on forwardThread.
 void MidiInputCollector::handleIncomingMidiMessage(juce::MidiInput *source, const juce::MidiMessage &message) {
-    logMidiMessage(message);
     midiCollector.addMessageToQueue(message);
-    if (midiSenderClient != nullptr) {
-        json j;
-        auto tsSeconds = juce::Time::currentTimeMillis();
-        j["timestamp"] = tsSeconds;
-        if (message.isNoteOn()) {
-            j["type"] = "note_on";
-            j["note"] = message.getNoteNumber();
-            j["velocity"] = static_cast<int>(message.getVelocity() * 127.0f);
-            j["role"] = userRole;
-        }
-        else if (message.isNoteOff())
-        {
-            j["type"] = "note_off";
-            j["note"] = message.getNoteNumber();
-            j["velocity"] = 0;
-            j["role"] = userRole;
+
+    auto size = message.getRawDataSize();
+    if (size > 3)
+        return;
+    if (capturedFifo.getFreeSpace() == 0) {
+        droppedCaptures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    capturedFifo.write(1).forEach([&](int index) {
+        auto& slot = captured[(size_t) index];
+        std::memcpy(slot.data, message.getRawData(), (size_t) size);
+        slot.size = size;
+        slot.wallMillis = juce::Time::currentTimeMillis();
+        slot.capturedAt = std::chrono::steady_clock::now();
+    });
+    forwardWakeup.signal();
+}
+
+void MidiInputCollector::forwardLoop() {
+    ThreadPolicy::instance().applyToCurrentThread(ThreadPolicy::Role::NETWORK);
+    while (forwarding.load()) {
+        int waitMs = 100;
+        if (!dirtyControllers.empty()) {
+            auto untilFlush = std::chrono::duration_cast<std::chrono::milliseconds>(
+                nextControllerFlush - std::chrono::steady_clock::now()).count();
+            waitMs = (int) std::max<juce::int64>(0, std::min<juce::int64>(waitMs, untilFlush));
         }
-        else
-        {
-            return;
+        forwardWakeup.wait(waitMs);
+        drainCaptured();
+        if (!dirtyControllers.empty() && std::chrono::steady_clock::now() >= nextControllerFlush)
+            flushControllers();
+    }
+    drainCaptured();
+    flushControllers();
+}
+
+void MidiInputCollector::drainCaptured() {
+    capturedFifo.read(capturedFifo.getNumReady()).forEach([this](int index) {
+        forward(captured[(size_t) index]);
+    });
+}
+
+std::shared_ptr<WebSocketClient> MidiInputCollector::getSender(std::string &role, std::string &session,
+                                                               NoteListener *listener) {
+    std::lock_guard<std::mutex> lock(senderMutex);
+    role = userRole;
+    session = sessionID;
+    if (listener != nullptr)
+        *listener = noteListener;
+    return midiSenderClient;
+}
+
+void MidiInputCollector::forward(const CapturedMidi &captured) {
+    juce::MidiMessage message(captured.data, captured.size);
+    int capture = captureId.load(std::memory_order_relaxed);
+    if (capture >= 0)
+        SessionRecorder::instance().recordUserMidi(capture, message, captured.capturedAt);
+    if (message.isController() || message.isPitchWheel()) {
+        coalesceController(message, captured);
+        return;
+    }
+    logMidiMessage(message);
+    if (!message.isNoteOnOrOff())
+        return;
+    if (message.isNoteOn())
+        updateKey(message.getNoteNumber(), captured.capturedAt);
+    const auto &key = keyEstimator.current();
+
+    std::string role;
+    std::string session;
+    NoteListener listener;
+    auto sender = getSender(role, session, &listener);
+    if (listener)
+        listener(session, role, message.getNoteNumber(),
+                 message.isNoteOn() ? static_cast<int>(message.getVelocity() * 127.0f) : 0,
+                 captured.wallMillis, captured.capturedAt, key);
+    if (sender == nullptr)
+        return;
+
+    // controller changes made before the note reach the composer ahead of it; the note itself is never held back
+    if (!dirtyControllers.empty())
+        flushControllers();
+
+    json j;
+    j["timestamp"] = captured.wallMillis;
+    if (!session.empty())
+        j["session"] = session;
+    if (message.isNoteOn()) {
+        j["type"] = "note_on";
+        j["note"] = message.getNoteNumber();
+        j["velocity"] = static_cast<int>(message.getVelocity() * 127.0f);
+        j["role"] = role;
+    }
+    else
+    {
+        j["type"] = "note_off";
+        j["note"] = message.getNoteNumber();
+        j["velocity"] = 0;
+        j["role"] = role;
+    }
+    // consumers can take the key from here instead of running their own detection
+    if (key.valid()) {
+        j["key"] = key.name();
+        j["key_confidence"] = key.confidence;
+    }
+    sender->sendJson(j, {}, captured.capturedAt);
+}
+
+void MidiInputCollector::updateKey(int note, std::chrono::steady_clock::time_point capturedAt) {
+    auto started = std::chrono::steady_clock::now();
+    const auto &key = keyEstimator.addNote(note, std::chrono::duration<double>(capturedAt - keyEpoch).count());
+    keyUpdateNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count(), std::memory_order_relaxed);
+    keyUpdates.fetch_add(1, std::memory_order_relaxed);
+    currentKey.store(key.valid() ? key.tonic + (key.minor ? 12 : 0) : -1, std::memory_order_relaxed);
+    currentKeyConfidence.store(static_cast<int>(key.confidence * 100.0), std::memory_order_relaxed);
+}
+
+// Knob sweeps produce hundreds of values per second; only the latest value per controller is kept
+// and forwarded once per 1/rate slice. A change after a quiet period goes out immediately.
+void MidiInputCollector::coalesceController(const juce::MidiMessage &message, const CapturedMidi &captured) {
+    if (controllerRateHz.load(std::memory_order_relaxed) <= 0)
+        return;
+    controllersReceived.fetch_add(1, std::memory_order_relaxed);
+
+    int slot = (message.getChannel() - 1) * controllersPerChannel
+               + (message.isPitchWheel() ? pitchBendSlot : message.getControllerNumber());
+    auto &pending = pendingControllers[(size_t) slot];
+    pending.value = message.isPitchWheel() ? message.getPitchWheelValue() : message.getControllerValue();
+    pending.wallMillis = captured.wallMillis;
+    pending.capturedAt = captured.capturedAt;
+    if (!pending.dirty) {
+        pending.dirty = true;
+        dirtyControllers.push_back(slot);
+    }
+}
+
+void MidiInputCollector::flushControllers() {
+    if (dirtyControllers.empty())
+        return;
+    std::string role;
+    std::string session;
+    auto sender = getSender(role, session);
+
+    for (int slot: dirtyControllers) {
+        auto &pending = pendingControllers[(size_t) slot];
+        pending.dirty = false;
+        if (sender == nullptr)
+            continue;
+        int channel = slot / controllersPerChannel + 1;
+        int controller = slot % controllersPerChannel;
+
+        json j;
+        j["timestamp"] = pending.wallMillis;
+        if (!session.empty())
+            j["session"] = session;
+        j["role"] = role;
+        j["channel"] = channel;
+        j["value"] = pending.value;
+        if (controller == pitchBendSlot) {
+            j["type"] = "pitch_bend";
+        } else {
+            j["type"] = "cc";
+            j["controller"] = controller;
+            logMidiMessage(juce::MidiMessage::controllerEvent(channel, controller, pending.value));
         }
-        midiSenderClient->sendJson(j);
+        // if the socket is backed up, a newer value replaces this one while it is still the last queued
+        sender->sendJson(j, "ctl:" + std::to_string(slot), pending.capturedAt);
+        controllersForwarded.fetch_add(1, std::memory_order_relaxed);
     }
+    dirtyControllers.clear();
+
+    int rate = std::max(1, controllerRateHz.load(std::memory_order_relaxed));
+    nextControllerFlush = std::chrono::steady_clock::now() + std::chrono::microseconds(1'000'000 / rate);
 }
 
 void MidiInputCollector::removeNextBlockOfMessages(juce::MidiBuffer &destBuffer, int numSamples) {
@@ -77,11 +243,43 @@ juce::MidiMessageCollector &MidiInputCollector::getMidiMessageCollector() {
 }
 
 void MidiInputCollector::setMidiSenderClient(std::shared_ptr<WebSocketClient> sender) {
+    std::lock_guard<std::mutex> lock(senderMutex);
     this->midiSenderClient = sender;
 }
 
 void MidiInputCollector::setUserRole(std::string userRole) {
+    std::lock_guard<std::mutex> lock(senderMutex);
     this->userRole = userRole;
 }
 
+void MidiInputCollector::setSessionID(std::string sessionID) {
+    std::lock_guard<std::mutex> lock(senderMutex);
+    this->sessionID = sessionID;
+}
 
+void MidiInputCollector::setNoteListener(NoteListener listener) {
+    std::lock_guard<std::mutex> lock(senderMutex);
+    noteListener = std::move(listener);
+}
+
+void MidiInputCollector::setControllerForwardRate(int rateHz) {
+    controllerRateHz.store(std::max(0, rateHz));
+}
+
+void MidiInputCollector::printStats() const {
+    std::cout << "[midi in] queued: " << capturedFifo.getNumReady()
+              << " | dropped in callback: " << droppedCaptures.load()
+              << " | controllers received: " << controllersReceived.load()
+              << ", forwarded: " << controllersForwarded.load()
+              << " (" << controllerRateHz.load() << " Hz)" << std::endl;
+    auto updates = keyUpdates.load();
+    int key = currentKey.load();
+    KeyEstimator::Estimate estimate;
+    estimate.tonic = key < 0 ? -1 : key % 12;
+    estimate.minor = key >= 12;
+    std::cout << "[midi in] key: " << (key < 0 ? "-" : estimate.name())
+              << " (" << currentKeyConfidence.load() << "%)"
+              << " | updates: " << updates
+              << " | avg update: " << (updates > 0 ? double(keyUpdateNanos.load()) / double(updates) : 0.0)
+              << " ns" << std::endl;
+}
@@ -6,22 +6,102 @@
 #define MIDIINPUTCOLLECTOR_H
 #include <juce_audio_devices/juce_audio_devices.h>
 #include <juce_audio_processors/juce_audio_processors.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "KeyEstimator.h"
 #include "../websocket/WebSocketClient.h"
 
 class MidiInputCollector: public juce::MidiInputCallback {
 public:
-    MidiInputCollector() = default;
+    // Sees every user note on the forwarding thread, with or without a sender client attached,
+    // together with the key estimated from the notes so far.
+    using NoteListener = std::function<void(const std::string& session, const std::string& role, int note,
+                                            int velocity, juce::int64 wallMillis,
+                                            std::chrono::steady_clock::time_point capturedAt,
+                                            const KeyEstimator::Estimate& key)>;
+
+    MidiInputCollector();
+    ~MidiInputCollector() override;
     void handleIncomingMidiMessage(juce::MidiInput* source, const juce::MidiMessage& message) override;
     void removeNextBlockOfMessages(juce::MidiBuffer& destBuffer, int numSamples);
     juce::MidiMessageCollector& getMidiMessageCollector();
     void setMidiSenderClient(std::shared_ptr<WebSocketClient> sender);
     void setUserRole(std::string userRole);
+    void setSessionID(std::string sessionID);
+    // Forward CC and pitch-bend changes, at most rateHz updates per controller (0 = don't forward).
+    void setControllerForwardRate(int rateHz);
+    void setCaptureId(int id) { captureId.store(id); }
+    void setNoteListener(NoteListener listener);
+    void printStats() const;
 private:
+    // What the driver callback hands to the forwarding thread: raw bytes and capture time only.
+    struct CapturedMidi {
+        juce::uint8 data[3];
+        int size;
+        juce::int64 wallMillis;
+        std::chrono::steady_clock::time_point capturedAt;
+    };
+
+    // Latest not yet forwarded value of one controller (128 CCs + pitch bend per channel).
+    struct PendingController {
+        int value = 0;
+        juce::int64 wallMillis = 0;
+        std::chrono::steady_clock::time_point capturedAt;
+        bool dirty = false;
+    };
+
+    static constexpr int controllersPerChannel = 129;
+    static constexpr int pitchBendSlot = 128;
+
+    void forwardLoop();
+    void drainCaptured();
+    void forward(const CapturedMidi& captured);
+    void coalesceController(const juce::MidiMessage& message, const CapturedMidi& captured);
+    void flushControllers();
+    void updateKey(int note, std::chrono::steady_clock::time_point capturedAt);
+    std::shared_ptr<WebSocketClient> getSender(std::string& role, std::string& session, NoteListener* listener = nullptr);
     void logMidiMessage(const juce::MidiMessage& message);
+
     juce::MidiMessageCollector midiCollector;
+
+    // single-producer (MIDI driver thread) / single-consumer (forwardThread) queue
+    static constexpr int capturedCapacity = 1024;
+    juce::AbstractFifo capturedFifo{capturedCapacity};
+    std::array<CapturedMidi, capturedCapacity> captured{};
+    std::atomic<juce::int64> droppedCaptures{0};
+    juce::WaitableEvent forwardWakeup;
+    std::atomic<bool> forwarding{true};
+    std::thread forwardThread;
+
+    // controller coalescing, touched by forwardThread only (apart from the rate)
+    std::atomic<int> controllerRateHz{0};
+    std::array<PendingController, 16 * controllersPerChannel> pendingControllers{};
+    std::vector<int> dirtyControllers;
+    std::chrono::steady_clock::time_point nextControllerFlush;
+    std::atomic<juce::int64> controllersReceived{0};
+    std::atomic<juce::int64> controllersForwarded{0};
+
+    std::atomic<int> captureId{-1};
+
+    // key of the user's playing, fed with note-ons on forwardThread
+    KeyEstimator keyEstimator;
+    std::chrono::steady_clock::time_point keyEpoch = std::chrono::steady_clock::now();
+    std::atomic<juce::int64> keyUpdates{0};
+    std::atomic<juce::int64> keyUpdateNanos{0};
+    std::atomic<int> currentKey{-1};
+    std::atomic<int> currentKeyConfidence{0};  // percent
+
+    std::mutex senderMutex;
     std::shared_ptr<WebSocketClient> midiSenderClient;
+    NoteListener noteListener;
     std::string userRole;
+    std::string sessionID;
 };
 
 
@@ -0,0 +1,38 @@
+#include "PortAllocator.h"
+
+#include <algorithm>
+
+PortAllocator::PortAllocator(int firstPort, int portsPerSession, int maxSessions)
+    : firstPort(firstPort), portsPerSession(portsPerSession), taken(maxSessions, false) {
+}
+
+int PortAllocator::allocateBlock() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < taken.size(); ++i) {
+        if (!taken[i]) {
+            taken[i] = true;
+            return firstPort + int(i) * portsPerSession;
+        }
+    }
+    return -1;
+}
+
+bool PortAllocator::reserveBlock(int basePort) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = (basePort - firstPort) / portsPerSession;
+    if (basePort < firstPort || index >= int(taken.size()) || taken[index]) return false;
+    taken[index] = true;
+    return true;
+}
+
+void PortAllocator::releaseBlock(int basePort) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = (basePort - firstPort) / portsPerSession;
+    if (basePort >= firstPort && index < int(taken.size()))
+        taken[index] = false;
+}
+
+int PortAllocator::getFreeBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return int(std::count(taken.begin(), taken.end(), false));
+}
@@ -0,0 +1,30 @@
+#ifndef PORTALLOCATOR_H
+#define PORTALLOCATOR_H
+#include <mutex>
+#include <vector>
+
+// Hands out contiguous blocks of UDP ports, one block per session, starting at firstPort.
+class PortAllocator {
+public:
+    PortAllocator(int firstPort, int portsPerSession, int maxSessions);
+
+    // Returns the base port of a free block, or -1 when every block is taken.
+    int allocateBlock();
+
+    // Claims the block starting at basePort (used for the statically configured default session).
+    bool reserveBlock(int basePort);
+
+    void releaseBlock(int basePort);
+
+    int getPortsPerSession() const { return portsPerSession; }
+
+    int getFreeBlocks() const;
+
+private:
+    mutable std::mutex mutex;
+    int firstPort;
+    int portsPerSession;
+    std::vector<bool> taken;
+};
+
+#endif //PORTALLOCATOR_H
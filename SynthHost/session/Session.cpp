@@ -0,0 +1,39 @@
+#include "Session.h"
+
+Session::Session(std::string id, int basePort, int portCount)
+    : id(std::move(id)), basePort(basePort), portsTaken(portCount, false) {
+}
+
+int Session::allocatePort() {
+    std::lock_guard<std::mutex> lock(portMutex);
+    for (size_t i = 0; i < portsTaken.size(); ++i) {
+        if (!portsTaken[i]) {
+            portsTaken[i] = true;
+            return basePort + int(i);
+        }
+    }
+    return -1;
+}
+
+bool Session::claimPort(int port) {
+    std::lock_guard<std::mutex> lock(portMutex);
+    int index = port - basePort;
+    if (index < 0 || index >= int(portsTaken.size()) || portsTaken[index]) return false;
+    portsTaken[index] = true;
+    return true;
+}
+
+void Session::releasePort(int port) {
+    std::lock_guard<std::mutex> lock(portMutex);
+    int index = port - basePort;
+    if (index >= 0 && index < int(portsTaken.size()))
+        portsTaken[index] = false;
+}
+
+double Session::getCpuLoad() const {
+    double load = 0.0;
+    for (const auto& stream: streams.all()) {
+        load += stream->getAudioEngine()->getCpuLoad();
+    }
+    return load;
+}
@@ -0,0 +1,41 @@
+#ifndef SESSION_H
+#define SESSION_H
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../controller/StreamRegistry.h"
+
+// One jam session: its own USER/AI stream set and a private block of UDP ports.
+class Session {
+public:
+    Session(std::string id, int basePort, int portCount);
+
+    const std::string& getID() const { return id; }
+
+    StreamRegistry& getStreams() { return streams; }
+
+    const StreamRegistry& getStreams() const { return streams; }
+
+    int getBasePort() const { return basePort; }
+
+    // Next unused port of the session's block for a stream created at runtime, or -1.
+    int allocatePort();
+
+    // Marks an explicitly configured port as used; false if it is outside the block or taken.
+    bool claimPort(int port);
+
+    void releasePort(int port);
+
+    // Sum of the audio-callback load of every stream in the session, as a proportion of one core.
+    double getCpuLoad() const;
+
+private:
+    std::string id;
+    int basePort;
+    StreamRegistry streams;
+    std::mutex portMutex;
+    std::vector<bool> portsTaken;
+};
+
+#endif //SESSION_H
@@ -3,41 +3,85 @@
 //
 
 #include "StreamManager.h"
+#include "../capture/SessionRecorder.h"
+#include "../executor/MessageThread.h"
+#include "../executor/ThreadPolicy.h"
 
-StreamManager::StreamManager(int blockSize, int sampleRate, int port, StreamID id, bool isAIEngine) {
+StreamManager::StreamManager(int blockSize, int sampleRate, int port, StreamID id, bool isAIEngine,
+                             std::shared_ptr<PluginInstancePool> pluginPool, PluginDef plugin,
+                             const juce::MemoryBlock* pluginState)
+    : pluginPool(std::move(pluginPool)), plugin(std::move(plugin)) {
     this->blockSize = blockSize;
     this->sampleRate = sampleRate;
     this->port = port;
     this->running.store(false);
     this->id = id;
-    this->init(isAIEngine);
+    this->isAIEngine = isAIEngine;
+    this->init(pluginState);
 }
 
 StreamManager::~StreamManager() {
-    streamingThread.join();
+    stopStreaming();
+    if (streamingThread.joinable())
+        streamingThread.join();
     audioEngine->stop();
+    returnInstance(audioEngine->releasePlugin());
 }
 
 
-void StreamManager::init(bool isAIEngine) {
+void StreamManager::init(const juce::MemoryBlock* pluginState) {
+    using clock = std::chrono::steady_clock;
+    auto started = clock::now();
+    auto lap = started;
+    auto phaseMs = [&lap]() {
+        auto now = clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - lap).count();
+        lap = now;
+        return ms;
+    };
+
     this->audioEngine = std::make_unique<HeadlessAudioEngine>(sampleRate, 2 * blockSize);
     juce::String error;
     std::unique_ptr<juce::AudioPluginInstance> serumInstance;
     try {
-        serumInstance = pluginManager.loadPlugin(PluginEnum::SERUM_LAPTOP, sampleRate, 2 * blockSize, error);
+        serumInstance = loadInstance(error);
     } catch (std::runtime_error &e) {
         std::cout << e.what() << std::endl;
         throw;
     }
+    startupTimings.plugin = phaseMs();
     audioEngine->enableAIMidiInjection(isAIEngine);
+    audioEngine->setCaptureId(SessionRecorder::instance().addEngine(id, isAIEngine, port, plugin));
+    // ports are handed out consecutively, so streams spread over the render cores
+    audioEngine->setThreadSlot(port);
+    if (pluginState != nullptr) {
+        // into the bare instance, so the warm-up below already pages in the restored patch; on the
+        // message thread, where VST3 wants its state set
+        MessageThread::instance().call([&]() {
+            serumInstance->setStateInformation(pluginState->getData(), (int) pluginState->getSize());
+        });
+    }
+    startupTimings.restore = phaseMs();
     audioEngine->setPlugin(std::move(serumInstance));
+    startupTimings.prepare = phaseMs();
+    audioEngine->warmUp();
+    startupTimings.warmUp = phaseMs();
     audioEngine->start();
+    startupTimings.device = phaseMs();
     udpAudioSender = std::make_unique<UDPAudioSender>("127.0.0.1", port);
+    startupTimings.total = std::chrono::duration<double, std::milli>(clock::now() - started).count();
+}
+
+std::unique_ptr<juce::AudioPluginInstance> StreamManager::loadInstance(juce::String& error) {
+    return pluginPool
+               ? pluginPool->acquire(plugin, sampleRate, 2 * blockSize, error)
+               : pluginManager.loadPlugin(plugin, sampleRate, 2 * blockSize, error);
 }
 
 void StreamManager::startStreaming() {
     running.store(true);
     streamingThread = std::thread([&]() {
+        ThreadPolicy::instance().applyToCurrentThread(ThreadPolicy::Role::STREAMING);
         const int FRAMES_PER_PACKET = 512;
         const int FLOATS_PER_PACKET = FRAMES_PER_PACKET * 2;
         using clock = std::chrono::high_resolution_clock;
@@ -51,7 +95,17 @@ void StreamManager::startStreaming() {
             if (got < pcmBuffer.size()) {
                 std::fill(pcmBuffer.begin() + got, pcmBuffer.end(), 0.0f);
             }
-            udpAudioSender->send(pcmBuffer.data(), pcmBuffer.size());
+            // mostly an idle plugin (see IdleDetector); the receiver fills in the zeros
+            auto range = juce::FloatVectorOperations::findMinAndMax(pcmBuffer.data(), (int) pcmBuffer.size());
+            if (range.getStart() == 0.0f && range.getEnd() == 0.0f) {
+                udpAudioSender->sendSilence(FRAMES_PER_PACKET);
+                silencePackets.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                udpAudioSender->send(pcmBuffer.data(), pcmBuffer.size());
+            }
+            packetsSent.fetch_add(1, std::memory_order_relaxed);
+            if (got > 0 && firstAudioAt.load(std::memory_order_relaxed) == 0)
+                firstAudioAt.store(std::chrono::steady_clock::now().time_since_epoch().count());
             nextTick += interval;
             std::this_thread::sleep_until(nextTick);
         }
@@ -62,14 +116,126 @@ void StreamManager::stopStreaming() {
     running.store(false);
 }
 
+void StreamManager::pause() {
+    stopStreaming();
+    if (streamingThread.joinable())
+        streamingThread.join();
+    audioEngine->stop();
+}
+
+void StreamManager::resume() {
+    if (running.load())
+        return;
+    audioEngine->start();
+    startStreaming();
+}
+
 void StreamManager::setPreset(Preset preset) {
-    audioEngine->setPreset(preset);
+    std::lock_guard<std::mutex> lock(presetMutex);
+    applyPreset(preset);
+}
+
+bool StreamManager::setPreset(const Preset& preset, uint64_t request) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    if (request != presetRequest.load())
+        return false;
+    applyPreset(preset);
+    return true;
+}
+
+void StreamManager::applyPreset(const Preset& preset) {
+    if (!wakeLocked())
+        throw std::runtime_error("stream " + std::to_string(id) + " could not wake from hibernation");
+    // the preset files are Serum's; any other plugin only takes the role and preset identity
+    if (plugin.serumPresets)
+        audioEngine->setPreset(preset);
+    else
+        audioEngine->restorePreset(preset);
+}
+
+void StreamManager::getPluginState(juce::MemoryBlock& state) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    if (hibernating.load())
+        state = hibernatedState;
+    else
+        audioEngine->getPluginState(state);
+}
+
+bool StreamManager::hibernate(double minIdleSeconds) {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    if (!isAIEngine || hibernating.load() || !audioEngine->beginHibernation(minIdleSeconds))
+        return false;
+    audioEngine->stop();
+    audioEngine->getPluginState(hibernatedState);
+    returnInstance(audioEngine->releasePlugin());
+    hibernating.store(true);
+    return true;
+}
+
+void StreamManager::returnInstance(std::unique_ptr<juce::AudioPluginInstance> instance) {
+    if (pluginPool)
+        pluginPool->release(plugin, std::move(instance));
+    else
+        MessageThread::instance().call([&instance]() { instance.reset(); });
+}
+
+bool StreamManager::wake() {
+    std::lock_guard<std::mutex> lock(presetMutex);
+    return wakeLocked();
+}
+
+bool StreamManager::wakeLocked() {
+    if (!hibernating.load())
+        return true;
+    auto started = std::chrono::steady_clock::now();
+    juce::String error;
+    std::unique_ptr<juce::AudioPluginInstance> instance;
+    try {
+        instance = loadInstance(error);
+    } catch (const std::exception &e) {
+        error = e.what();
+    }
+    if (instance == nullptr) {
+        // the events stay held; the next one tries again
+        std::cout << "[hibernation] stream " << id << " could not wake: " << error << std::endl;
+        return false;
+    }
+    if (hibernatedState.getSize() > 0) {
+        MessageThread::instance().call([&]() {
+            instance->setStateInformation(hibernatedState.getData(), (int) hibernatedState.getSize());
+        });
+    }
+    audioEngine->setPlugin(std::move(instance));
+    audioEngine->warmUp();
+    audioEngine->start();
+    lateWakeEvents.fetch_add(audioEngine->endHibernation());
+    hibernatedState.reset();
+    hibernating.store(false);
+    wakeLatency.record(started);
+    return true;
+}
+
+std::optional<std::chrono::steady_clock::time_point> StreamManager::getFirstAudioTime() const {
+    auto ticks = firstAudioAt.load();
+    if (ticks == 0)
+        return std::nullopt;
+    return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
 }
 
 StreamID StreamManager::getStreamID() {
     return id;
 }
 
+void StreamManager::printStats() const {
+    std::cout << "[stream " << id << "] port " << port
+              << " | packets " << packetsSent.load() << " (" << silencePackets.load() << " silence markers)";
+    if (wakeLatency.count() > 0 || hibernating.load())
+        std::cout << " | " << (hibernating.load() ? "hibernating" : "awake") << ", wakes " << wakeLatency.summary()
+                  << ", late events " << lateWakeEvents.load();
+    std::cout << std::endl;
+    audioEngine->printStats();
+}
+
 void StreamManager::setMidiSenderClient(std::shared_ptr<WebSocketClient> sender)
 {
     audioEngine->setMidiSenderClient(sender);
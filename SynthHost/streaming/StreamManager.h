@@ -4,16 +4,34 @@
 
 #ifndef STREAMMANAGER_H
 #define STREAMMANAGER_H
+#include <chrono>
+#include <mutex>
+#include <optional>
 #include <thread>
 
 #include "../audio_engine/HeadlessAudioEngine.h"
 #include "UDPAudioSender.h"
+#include "../utils/LatencyStats.h"
 #include "../utils/StreamID.h"
 #include "../vst_hosting/PluginManager.h"
+#include "../vst_hosting/PluginInstancePool.h"
 
 class StreamManager {
 public:
-    explicit StreamManager(int blockSize = 512, int sampleRate = 48000, int port = 9000, StreamID id = USER, bool isAIEngine = false);
+    // How long each step of bringing the stream up took, in milliseconds.
+    struct StartupTimings {
+        double plugin = 0;   // instance from the pool or a fresh load
+        double restore = 0;  // plugin state from a snapshot, if any
+        double prepare = 0;  // prepareToPlay
+        double warmUp = 0;   // HeadlessAudioEngine::warmUp
+        double device = 0;   // audio device open and start
+        double total = 0;
+    };
+
+    explicit StreamManager(int blockSize = 512, int sampleRate = 48000, int port = 9000, StreamID id = USER, bool isAIEngine = false,
+                           std::shared_ptr<PluginInstancePool> pluginPool = nullptr,
+                           PluginDef plugin = PluginEnum::SERUM_LAPTOP,
+                           const juce::MemoryBlock* pluginState = nullptr);
 
     ~StreamManager();
 
@@ -21,28 +39,88 @@ public:
 
     void stopStreaming();
 
+    // Stops the streaming thread and the audio device while keeping the plugin instance and its state.
+    void pause();
+
+    void resume();
+
     void setPreset(Preset preset);
 
+    // Loads issued for this stream are numbered; a load that was overtaken by a newer request
+    // before it got to run is skipped (returns false) so rapid preset changes don't pile up.
+    uint64_t nextPresetRequest() { return ++presetRequest; }
+
+    bool setPreset(const Preset& preset, uint64_t request);
+
     StreamID getStreamID();
 
     void setMidiSenderClient(std::shared_ptr<WebSocketClient> sender);
 
     double getSampleRate() { return sampleRate; }
 
+    int getPort() const { return port; }
+
     HeadlessAudioEngine* getAudioEngine() { return audioEngine.get(); }
 
+    const StartupTimings& getStartupTimings() const { return startupTimings; }
+
+    bool isAI() const { return isAIEngine; }
+
+    const PluginDef& getPluginDef() const { return plugin; }
+
+    // The plugin's state blob, taken between preset loads.
+    void getPluginState(juce::MemoryBlock& state);
+
+    // An AI stream whose plugin has been idle for minIdleSeconds gives the instance back to the
+    // pool (which keeps only a few warm and destroys the rest), keeping just its state blob; the
+    // streaming thread goes on sending silence. Events for it are held by the engine until wake()
+    // brings an instance back from the pool with the state restored. A preset change wakes it too.
+    bool hibernate(double minIdleSeconds);
+    bool wake();
+    bool isHibernating() const { return hibernating.load(); }
+    // time from the start of a wake until held events are handed on
+    const LatencyStats& getWakeLatency() const { return wakeLatency; }
+    int64_t getLateWakeEvents() const { return lateWakeEvents.load(); }
+
+    // When the first packet carrying rendered audio went out, or nullopt if none has yet.
+    std::optional<std::chrono::steady_clock::time_point> getFirstAudioTime() const;
+
+    void printStats() const;
+
 private:
-    void init(bool isAIEngine);
+    void init(const juce::MemoryBlock* pluginState);
+
+    void applyPreset(const Preset& preset);
+
+    bool wakeLocked();
+
+    std::unique_ptr<juce::AudioPluginInstance> loadInstance(juce::String& error);
+    // Back to the pool, or destroyed on the message thread without one.
+    void returnInstance(std::unique_ptr<juce::AudioPluginInstance> instance);
 
     StreamID id;
     std::unique_ptr<HeadlessAudioEngine> audioEngine;
     std::unique_ptr<UDPAudioSender> udpAudioSender;
     PluginManager pluginManager;
+    std::shared_ptr<PluginInstancePool> pluginPool;
+    PluginDef plugin;
     std::thread streamingThread;
     std::atomic<bool> running;
+    std::mutex presetMutex;
+    std::atomic<uint64_t> presetRequest{0};
     int blockSize;
     int sampleRate;
     int port;
+    bool isAIEngine;
+    StartupTimings startupTimings;
+    std::atomic<int64_t> firstAudioAt{0};
+    std::atomic<int64_t> packetsSent{0};
+    std::atomic<int64_t> silencePackets{0};
+    // hibernation, guarded by presetMutex
+    std::atomic<bool> hibernating{false};
+    juce::MemoryBlock hibernatedState;
+    LatencyStats wakeLatency;
+    std::atomic<int64_t> lateWakeEvents{0};
 };
 
 #endif //STREAMMANAGER_H
@@ -7,6 +7,7 @@
 
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <cstdint>
 #include <stdexcept>
 #include <iostream>
 
@@ -38,10 +39,23 @@ public:
         WSACleanup();
     }
 
+    // A silent packet goes out as this 8-byte marker instead of its zeros: SILENCE_MAGIC followed by
+    // the number of frames, both little-endian uint32. PCM packets are never that short.
+    static constexpr uint32_t SILENCE_MAGIC = 0x434E4C53; // "SLNC"
+
     void send(const float* samples, size_t sampleCount) {
-        size_t byteCount = sampleCount * sizeof(float);
+        sendBytes(samples, sampleCount * sizeof(float));
+    }
+
+    void sendSilence(uint32_t frames) {
+        const uint32_t marker[2] = {SILENCE_MAGIC, frames};
+        sendBytes(marker, sizeof(marker));
+    }
+
+private:
+    void sendBytes(const void* bytes, size_t byteCount) {
         int sent = sendto(sockfd,
-                          reinterpret_cast<const char*>(samples),
+                          reinterpret_cast<const char*>(bytes),
                           static_cast<int>(byteCount),
                           0,
                           reinterpret_cast<sockaddr*>(&destAddr),
@@ -52,7 +66,6 @@ public:
         }
     }
 
-private:
     SOCKET sockfd;
     sockaddr_in destAddr;
 };
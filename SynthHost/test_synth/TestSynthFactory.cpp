@@ -0,0 +1,38 @@
+// Plugin factory for the bundled test synth. Same registration as the vst3sdk's mdafactory.cpp,
+// reduced to the JX10 processor/controller pair so the module stays small and only exposes one
+// instrument to the host.
+
+#include "mdaJX10Controller.h"
+#include "mdaJX10Processor.h"
+#include "version.h"
+
+#include "public.sdk/source/main/pluginfactory_constexpr.h"
+
+#define kVersionString	FULL_VERSION_STR
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+BEGIN_FACTORY_DEF (stringCompanyName, stringCompanyWeb, stringCompanyEmail, 2)
+
+DEF_CLASS  (mda::JX10Processor::uid,
+			PClassInfo::kManyInstances,
+			kVstAudioEffectClass,
+			"mda JX10",
+			Vst::kDistributable,
+			Vst::PlugType::kInstrumentSynth,
+			kVersionString,
+			kVstVersionString,
+			mda::JX10Processor::createInstance, nullptr)
+
+DEF_CLASS  (mda::JX10Controller::uid,
+			PClassInfo::kManyInstances,
+			kVstComponentControllerClass,
+			"mda JX10",
+			Vst::kDistributable,
+			"",
+			kVersionString,
+			kVstVersionString,
+			mda::JX10Controller::createInstance, nullptr)
+
+END_FACTORY
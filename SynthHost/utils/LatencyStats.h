@@ -0,0 +1,52 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Lock-free running count/mean/max of durations. record() may be called from any thread.
+class LatencyStats {
+public:
+    void record(int64_t micros) {
+        samples.fetch_add(1, std::memory_order_relaxed);
+        totalMicros.fetch_add(micros, std::memory_order_relaxed);
+        int64_t peak = peakMicros.load(std::memory_order_relaxed);
+        while (micros > peak && !peakMicros.compare_exchange_weak(peak, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    void record(std::chrono::steady_clock::time_point since) {
+        record(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - since).count());
+    }
+
+    int64_t count() const { return samples.load(std::memory_order_relaxed); }
+
+    double averageMicros() const {
+        auto n = count();
+        return n == 0 ? 0.0 : double(totalMicros.load(std::memory_order_relaxed)) / double(n);
+    }
+
+    int64_t maxMicros() const { return peakMicros.load(std::memory_order_relaxed); }
+
+    void reset() {
+        samples.store(0);
+        totalMicros.store(0);
+        peakMicros.store(0);
+    }
+
+    std::string summary() const {
+        std::ostringstream out;
+        out << "n=" << count() << " avg=" << averageMicros() << "us max=" << maxMicros() << "us";
+        return out.str();
+    }
+
+private:
+    std::atomic<int64_t> samples{0};
+    std::atomic<int64_t> totalMicros{0};
+    std::atomic<int64_t> peakMicros{0};
+};
+
+#endif //LATENCYSTATS_H
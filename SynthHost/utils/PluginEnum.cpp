@@ -4,4 +4,29 @@
 #include "PluginEnum.h"
 
 PluginDef PluginEnum::SERUM_PC = PluginDef("Serum","D:/Projects/SynthAI/SynthHost/resources/plugins/Serum.vst3");
-PluginDef PluginEnum::SERUM_LAPTOP = PluginDef("Serum","C:/Projects/SynthHost/resources/plugins/Serum.vst3");
\ No newline at end of file
+PluginDef PluginEnum::SERUM_LAPTOP = PluginDef("Serum","C:/Projects/SynthHost/resources/plugins/Serum.vst3");
+
+// set by CMake when the test synth is built along with the host (SYNTHHOST_TEST_SYNTH)
+#ifndef SYNTHHOST_TEST_SYNTH_PATH
+#define SYNTHHOST_TEST_SYNTH_PATH "resources/plugins/SynthHostTestSynth.vst3"
+#endif
+
+static PluginDef makeTestSynth() {
+    PluginDef def("mda JX10", SYNTHHOST_TEST_SYNTH_PATH);
+    def.serumPresets = false;
+    return def;
+}
+
+PluginDef PluginEnum::TEST_SYNTH = makeTestSynth();
+
+PluginDef PluginEnum::fromName(const std::string &name) {
+    if (name == "serum")
+        return SERUM_LAPTOP;
+    if (name == "test-synth")
+        return TEST_SYNTH;
+    auto slash = name.find_last_of("/\\");
+    auto file = slash == std::string::npos ? name : name.substr(slash + 1);
+    PluginDef def(file.substr(0, file.rfind(".vst3")), name);
+    def.serumPresets = false;
+    return def;
+}
\ No newline at end of file
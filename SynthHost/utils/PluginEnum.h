@@ -7,18 +7,50 @@
 
 class PluginDef {
 public:
+    // How the plugin is hosted: through JUCE's VST3 wrapper or straight on the vst3sdk hosting
+    // classes (Vst3DirectInstance). NATIVE swaps the plugin for the built-in NativeSynthInstance,
+    // whose patches approximate the Serum presets.
+    enum class Backend { JUCE, VST3_DIRECT, NATIVE };
+
     PluginDef(const std::string &name, const std::string &path) {
         this->name = name;
         this->path = path;
     }
+
+    PluginDef withBackend(Backend backend) const {
+        PluginDef def = *this;
+        def.backend = backend;
+        if (backend == Backend::NATIVE) {
+            def.name = "Native Synth";
+            def.serumPresets = false;
+        }
+        return def;
+    }
+
+    // Instances are only interchangeable when both the binary and the backend match.
+    std::string key() const {
+        if (backend == Backend::NATIVE)
+            return "#native";
+        return backend == Backend::VST3_DIRECT ? path + "#vst3-direct" : path;
+    }
+
     std::string path;
     std::string name;
+    Backend backend = Backend::JUCE;
+    // Whether Presets (Serum .fxp/.vstpreset files) can be loaded into it. Other plugins keep
+    // their own patch; a preset change then only switches the stream's role.
+    bool serumPresets = true;
 };
 
 class PluginEnum {
 public:
     static PluginDef SERUM_PC;
     static PluginDef SERUM_LAPTOP;
+    // mda JX10 built from test_synth/, for running the pipeline where Serum isn't installed
+    static PluginDef TEST_SYNTH;
+
+    // "serum", "test-synth" or the path of any other .vst3
+    static PluginDef fromName(const std::string &name);
 };
 
 
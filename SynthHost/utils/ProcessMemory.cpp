@@ -0,0 +1,35 @@
+#include "ProcessMemory.h"
+#include <juce_core/juce_core.h>
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif JUCE_MAC
+#include <mach/mach.h>
+#else
+#include <fstream>
+#include <unistd.h>
+#endif
+
+size_t residentMemoryBytes() {
+#if JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize;
+#elif JUCE_MAC
+    mach_task_basic_info info{};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    // pages: total program size, then resident
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, resident = 0;
+    if (!(statm >> total >> resident))
+        return 0;
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
@@ -0,0 +1,8 @@
+#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+#include <cstddef>
+
+// Resident memory of this process (the working set on Windows), in bytes; 0 where unknown.
+size_t residentMemoryBytes();
+
+#endif //PROCESSMEMORY_H
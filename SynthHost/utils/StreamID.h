@@ -6,7 +6,8 @@
 #define STREAMID_H
 #include <string>
 
-enum StreamID {
+// Fixed underlying type so ids allocated at runtime (above AI_PAD) are valid values too.
+enum StreamID : int {
     USER, AI_BASS, AI_LEAD, AI_PLUCK, AI_PAD
 };
 
@@ -6,7 +6,7 @@
 #define WEBSOCKETCLIENTID_H
 
 enum WebSocketClientID {
-    PRESET_CHANGER, USER_INPUT, COMPOSER_OUTPUT
+    PRESET_CHANGER, USER_INPUT, COMPOSER_OUTPUT, STREAM_CONTROL, AUTOMATION
 };
 
 #endif //WEBSOCKETCLIENTID_H
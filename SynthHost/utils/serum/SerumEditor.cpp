@@ -17,8 +17,10 @@ void SerumEditor::loadSerumPreset(const Preset& preset, juce::AudioPluginInstanc
     }
     juce::MemoryBlock presetBlock;
     if (presetFile.loadFileAsData(presetBlock)) {
-        juce::VST3PluginFormat::setStateFromVSTPresetFile(serumInstance, presetBlock);
-        // serumInstance->setStateInformation(presetBlock.getData(), (int) presetBlock.getSize());
+        // only JUCE's own VST3 wrapper takes the preset this way; the direct backend reads
+        // .vstpreset images as its state
+        if (!juce::VST3PluginFormat::setStateFromVSTPresetFile(serumInstance, presetBlock))
+            serumInstance->setStateInformation(presetBlock.getData(), (int) presetBlock.getSize());
         std::cout << "Preset: " << presetPath << " was loaded successfully into the Serum instance!" << std::endl;
     }
     else {
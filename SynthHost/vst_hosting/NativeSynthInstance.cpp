@@ -0,0 +1,166 @@
+#include "NativeSynthInstance.h"
+
+namespace
+{
+    struct ParameterSpec
+    {
+        const char* id;
+        const char* name;
+        float NativeSynthPatch::* member;
+        float minimum, maximum, centre;
+    };
+
+    // times and the cutoff are skewed so the middle of the range lands on a typical value
+    const ParameterSpec parameterSpecs[] = {
+        { "osc2_semitones", "Osc 2 Semitones", &NativeSynthPatch::osc2Semitones, -24.0f, 24.0f, 0.0f },
+        { "detune", "Detune", &NativeSynthPatch::detuneCents, 0.0f, 50.0f, 10.0f },
+        { "osc2_level", "Osc 2 Level", &NativeSynthPatch::osc2Level, 0.0f, 1.0f, 0.5f },
+        { "cutoff", "Cutoff", &NativeSynthPatch::cutoff, 20.0f, 20000.0f, 1000.0f },
+        { "resonance", "Resonance", &NativeSynthPatch::resonance, 0.0f, 1.0f, 0.5f },
+        { "filter_env", "Filter Env Amount", &NativeSynthPatch::filterEnvOctaves, 0.0f, 8.0f, 2.0f },
+        { "key_track", "Key Track", &NativeSynthPatch::keyTrack, 0.0f, 1.0f, 0.5f },
+        { "amp_attack", "Amp Attack", &NativeSynthPatch::ampAttack, 0.001f, 5.0f, 0.1f },
+        { "amp_decay", "Amp Decay", &NativeSynthPatch::ampDecay, 0.001f, 5.0f, 0.3f },
+        { "amp_sustain", "Amp Sustain", &NativeSynthPatch::ampSustain, 0.0f, 1.0f, 0.5f },
+        { "amp_release", "Amp Release", &NativeSynthPatch::ampRelease, 0.001f, 5.0f, 0.3f },
+        { "filter_attack", "Filter Attack", &NativeSynthPatch::filterAttack, 0.001f, 5.0f, 0.1f },
+        { "filter_decay", "Filter Decay", &NativeSynthPatch::filterDecay, 0.001f, 5.0f, 0.3f },
+        { "filter_sustain", "Filter Sustain", &NativeSynthPatch::filterSustain, 0.0f, 1.0f, 0.5f },
+        { "filter_release", "Filter Release", &NativeSynthPatch::filterRelease, 0.001f, 5.0f, 0.3f },
+        { "gain", "Gain", &NativeSynthPatch::gain, 0.0f, 1.0f, 0.25f },
+    };
+}
+
+// Writes through to the synth's patch under its lock; the synth picks the value up at its next
+// control block. setPatch() syncs these from whichever thread loads a preset or a state.
+class NativeSynthInstance::PatchParameter : public juce::AudioParameterFloat
+{
+public:
+    PatchParameter (const ParameterSpec& spec, NativeSynth& synth)
+        : juce::AudioParameterFloat (juce::ParameterID { spec.id, 1 },
+                                     spec.name,
+                                     rangeFor (spec),
+                                     synth.getPatch().*spec.member),
+          member (spec.member),
+          synth (synth)
+    {
+    }
+
+    float NativeSynthPatch::* const member;
+
+protected:
+    void valueChanged (float newValue) override
+    {
+        const juce::ScopedLock sl (synth.getLock());
+        synth.getPatchForEditing().*member = newValue;
+    }
+
+private:
+    static juce::NormalisableRange<float> rangeFor (const ParameterSpec& spec)
+    {
+        juce::NormalisableRange<float> range (spec.minimum, spec.maximum);
+        if (spec.centre > spec.minimum && spec.centre < spec.maximum)
+            range.setSkewForCentre (spec.centre);
+        return range;
+    }
+
+    NativeSynth& synth;
+};
+
+NativeSynthInstance::NativeSynthInstance()
+    : AudioPluginInstance (BusesProperties().withOutput ("Output", juce::AudioChannelSet::stereo(), true))
+{
+    for (const auto& spec : parameterSpecs)
+    {
+        auto parameter = std::make_unique<PatchParameter> (spec, synth);
+        patchParameters.add (parameter.get());
+        addHostedParameter (std::move (parameter));
+    }
+}
+
+void NativeSynthInstance::fillInPluginDescription (juce::PluginDescription& description) const
+{
+    description.name = getName();
+    description.descriptiveName = getName();
+    description.pluginFormatName = "Native";
+    description.category = "Instrument";
+    description.manufacturerName = "SynthHost";
+    description.version = "1.0";
+    description.fileOrIdentifier = "native-synth";
+    description.isInstrument = true;
+    description.numInputChannels = 0;
+    description.numOutputChannels = getTotalNumOutputChannels();
+    description.uniqueId = description.deprecatedUid = (int) juce::String ("native-synth").hashCode();
+}
+
+void NativeSynthInstance::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    setRateAndBufferSizeDetails (sampleRate, maximumExpectedSamplesPerBlock);
+    synth.setCurrentPlaybackSampleRate (sampleRate);
+}
+
+void NativeSynthInstance::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi)
+{
+    buffer.clear();
+    synth.renderNextBlock (buffer, midi, 0, buffer.getNumSamples());
+}
+
+void NativeSynthInstance::reset()
+{
+    synth.allNotesOff (0, false);
+}
+
+double NativeSynthInstance::getTailLengthSeconds() const
+{
+    return synth.getPatch().ampRelease;
+}
+
+void NativeSynthInstance::setPatch (const NativeSynthPatch& patch)
+{
+    synth.setPatch (patch);
+    syncParameters();
+}
+
+void NativeSynthInstance::restoreRenderState (const NativeSynth::Snapshot& state)
+{
+    synth.restoreSnapshot (state);
+    syncParameters();
+}
+
+void NativeSynthInstance::syncParameters()
+{
+    const auto& patch = synth.getPatch();
+    for (auto* parameter : patchParameters)
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (patch.*(parameter->member)));
+}
+
+void NativeSynthInstance::getStateInformation (juce::MemoryBlock& destData)
+{
+    NativeSynthPatch patch;
+    {
+        const juce::ScopedLock sl (synth.getLock());
+        patch = synth.getPatch();
+    }
+    juce::XmlElement xml ("NativeSynth");
+    xml.setAttribute ("name", juce::String (patch.name));
+    xml.setAttribute ("osc1", (int) patch.osc1);
+    xml.setAttribute ("osc2", (int) patch.osc2);
+    for (const auto& spec : parameterSpecs)
+        xml.setAttribute (spec.id, (double) (patch.*spec.member));
+    copyXmlToBinary (xml, destData);
+}
+
+void NativeSynthInstance::setStateInformation (const void* data, int sizeInBytes)
+{
+    auto xml = getXmlFromBinary (data, sizeInBytes);
+    if (xml == nullptr || ! xml->hasTagName ("NativeSynth"))
+        return;
+
+    NativeSynthPatch patch;
+    patch.name = xml->getStringAttribute ("name", "Init").toStdString();
+    patch.osc1 = (NativeSynthPatch::Waveform) juce::jlimit (0, 2, xml->getIntAttribute ("osc1"));
+    patch.osc2 = (NativeSynthPatch::Waveform) juce::jlimit (0, 2, xml->getIntAttribute ("osc2"));
+    for (const auto& spec : parameterSpecs)
+        patch.*spec.member = (float) xml->getDoubleAttribute (spec.id, patch.*spec.member);
+    setPatch (patch);
+}
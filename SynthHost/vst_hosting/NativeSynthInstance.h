@@ -0,0 +1,63 @@
+#ifndef NATIVESYNTHINSTANCE_H
+#define NATIVESYNTHINSTANCE_H
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "../audio_engine/synth/NativeSynth.h"
+
+// The built-in NativeSynth behind the juce::AudioPluginInstance interface, so the engine, the
+// instance pool, parameter automation and snapshots treat it like any hosted plugin. The patch's
+// continuous values are exposed as parameters (cutoff, resonance, envelopes, ...); the state is
+// the whole patch as XML.
+class NativeSynthInstance : public juce::AudioPluginInstance
+{
+public:
+    NativeSynthInstance();
+
+    const juce::String getName() const override { return "Native Synth"; }
+    void fillInPluginDescription (juce::PluginDescription& description) const override;
+
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override {}
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override;
+    void reset() override;
+
+    double getTailLengthSeconds() const override;
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return false; }
+
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram (int) override {}
+    const juce::String getProgramName (int) override { return {}; }
+    void changeProgramName (int, const juce::String&) override {}
+
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+    // Switches to the patch approximating the given Serum preset (NativeSynthPatch::forPreset).
+    void setPatch (const NativeSynthPatch& patch);
+
+    const NativeSynthPatch& getPatch() const { return synth.getPatch(); }
+
+    int getActiveVoiceCount() const { return synth.getActiveVoiceCount(); }
+
+    // The synth's complete render state, voices included, for look-ahead rendering to roll back
+    // to (see LookAheadRenderer).
+    void saveRenderState (NativeSynth::Snapshot& state) const { synth.saveSnapshot (state); }
+    void restoreRenderState (const NativeSynth::Snapshot& state);
+
+private:
+    class PatchParameter;
+
+    void syncParameters();
+
+    NativeSynth synth;
+    juce::Array<PatchParameter*> patchParameters;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NativeSynthInstance)
+};
+
+#endif //NATIVESYNTHINSTANCE_H
@@ -0,0 +1,123 @@
+#include "PluginInstancePool.h"
+#include "../executor/MessageThread.h"
+
+#include <iostream>
+
+std::unique_ptr<juce::AudioPluginInstance> PluginInstancePool::acquire(
+    const PluginDef& plugin, const double sampleRate, const int blockSize, juce::String& error)
+{
+    std::unique_ptr<juce::AudioPluginInstance> pooled;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto& instances = idle[plugin.key()];
+        if (! instances.empty())
+        {
+            pooled = std::move (instances.back());
+            instances.pop_back();
+            reused.fetch_add (1);
+        }
+    }
+    if (pooled != nullptr)
+    {
+        // the last session's patch and tweaks must not carry over into the next one; outside the
+        // pool lock, which restoreInitialState takes itself and the message thread call may wait on
+        restoreInitialState (plugin, *pooled);
+        pooled->reset();
+        return pooled;
+    }
+
+    // created on the message thread, one at a time (PluginManager)
+    auto instance = pluginManager.loadPlugin (plugin, sampleRate, blockSize, error);
+    created.fetch_add (1);
+    recordInitialState (plugin, *instance);
+    return instance;
+}
+
+void PluginInstancePool::recordInitialState (const PluginDef& plugin, juce::AudioPluginInstance& instance)
+{
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        if (initialStates.count (plugin.key()) > 0)
+            return;
+    }
+    juce::MemoryBlock state;
+    MessageThread::instance().call ([&] { instance.getStateInformation (state); });
+    std::lock_guard<std::mutex> lock (mutex);
+    initialStates.emplace (plugin.key(), std::move (state));
+}
+
+void PluginInstancePool::restoreInitialState (const PluginDef& plugin, juce::AudioPluginInstance& instance)
+{
+    juce::MemoryBlock state;
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto it = initialStates.find (plugin.key());
+        if (it == initialStates.end() || it->second.getSize() == 0)
+            return;
+        state = it->second;
+    }
+    MessageThread::instance().call ([&] { instance.setStateInformation (state.getData(), (int) state.getSize()); });
+}
+
+void PluginInstancePool::release (const PluginDef& plugin, std::unique_ptr<juce::AudioPluginInstance> instance)
+{
+    if (instance == nullptr)
+        return;
+
+    instance->releaseResources();
+    instance->suspendProcessing (false);
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto& instances = idle[plugin.key()];
+        if (instances.size() < maxIdle.load())
+        {
+            instances.push_back (std::move (instance));
+            return;
+        }
+    }
+    // outside the lock: unloading a plugin can take a while. JUCE's VST3 instance tears itself
+    // down on the message thread and waits for it, so do it there instead of blocking on it.
+    MessageThread::instance().call ([&instance] { instance.reset(); });
+    destroyed.fetch_add (1);
+}
+
+PluginInstancePool::~PluginInstancePool()
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    MessageThread::instance().call ([this] { idle.clear(); });
+}
+
+void PluginInstancePool::setMaxIdle (size_t perPlugin)
+{
+    maxIdle.store (perPlugin);
+}
+
+void PluginInstancePool::prewarm (const PluginDef& plugin, double sampleRate, int blockSize, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        juce::String error;
+        auto instance = pluginManager.loadPlugin (plugin, sampleRate, blockSize, error);
+        created.fetch_add (1);
+        recordInitialState (plugin, *instance);
+        release (plugin, std::move (instance));
+    }
+}
+
+size_t PluginInstancePool::idleCount() const
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    size_t count = 0;
+    for (const auto& entry : idle)
+        count += entry.second.size();
+    return count;
+}
+
+void PluginInstancePool::printStats() const
+{
+    std::cout << "[plugin pool] idle: " << idleCount()
+              << " | created: " << created.load()
+              << " | reused: " << reused.load()
+              << " | destroyed: " << destroyed.load() << std::endl;
+}
@@ -0,0 +1,53 @@
+#ifndef PLUGININSTANCEPOOL_H
+#define PLUGININSTANCEPOOL_H
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "PluginManager.h"
+
+// Process-wide pool of idle plugin instances, keyed by plugin path and backend. Streams borrow an instance
+// when they are created and hand it back on teardown, so a session that ends leaves its
+// instances warm for the next one instead of paying a fresh plugin load. A reused instance is
+// first put back into the state the plugin had when it was loaded.
+class PluginInstancePool
+{
+public:
+    ~PluginInstancePool();
+
+    std::unique_ptr<juce::AudioPluginInstance> acquire (const PluginDef& plugin,
+                                                        double sampleRate,
+                                                        int blockSize,
+                                                        juce::String& error);
+
+    void release (const PluginDef& plugin, std::unique_ptr<juce::AudioPluginInstance> instance);
+
+    // Instances kept warm per plugin; one released past that is destroyed instead, so hibernated
+    // streams actually give their memory back. Unlimited unless set.
+    void setMaxIdle (size_t perPlugin);
+
+    // Loads instances up front so the first sessions do not wait on plugin loads.
+    void prewarm (const PluginDef& plugin, double sampleRate, int blockSize, int count);
+
+    size_t idleCount() const;
+
+    void printStats() const;
+
+private:
+    void recordInitialState (const PluginDef& plugin, juce::AudioPluginInstance& instance);
+    void restoreInitialState (const PluginDef& plugin, juce::AudioPluginInstance& instance);
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::vector<std::unique_ptr<juce::AudioPluginInstance>>> idle;
+    // per plugin: the state of its first instance straight after loading
+    std::unordered_map<std::string, juce::MemoryBlock> initialStates;
+    PluginManager pluginManager;
+    std::atomic<int> created{0};
+    std::atomic<int> reused{0};
+    std::atomic<int> destroyed{0};
+    std::atomic<size_t> maxIdle{std::numeric_limits<size_t>::max()};
+};
+
+#endif //PLUGININSTANCEPOOL_H
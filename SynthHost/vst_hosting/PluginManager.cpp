@@ -1,4 +1,8 @@
 #include "PluginManager.h"
+#include "NativeSynthInstance.h"
+#include "PluginScanCache.h"
+#include "Vst3DirectInstance.h"
+#include "../executor/MessageThread.h"
 
 using namespace juce;
 
@@ -14,24 +18,31 @@ PluginManager::~PluginManager()
 std::unique_ptr<AudioPluginInstance> PluginManager::loadPlugin(
     const PluginDef& plugin, const double sampleRate, const int blockSize, String& error)
 {
-    OwnedArray<PluginDescription> descriptions;
-    KnownPluginList pluginList;
-    for (int i = 0; i < formatManager.getNumFormats(); ++i)
+    if (plugin.backend == PluginDef::Backend::VST3_DIRECT)
+        return loadDirect(plugin, sampleRate, blockSize, error);
+    if (plugin.backend == PluginDef::Backend::NATIVE)
     {
-        pluginList.scanAndAddFile(plugin.path, true, descriptions,
-                             *formatManager.getFormat(i));
+        auto instance = std::make_unique<NativeSynthInstance>();
+        instance->setRateAndBufferSizeDetails(sampleRate, blockSize);
+        return instance;
     }
 
+    // a scan that misses the cache loads the module, so it goes to the message thread as well
+    OwnedArray<PluginDescription> descriptions;
+    MessageThread::instance().call([&]() {
+        PluginScanCache::instance().findTypes(plugin.path, formatManager, descriptions);
+    });
+
 
     if (descriptions.size() == 0)
     {
         throw new std::runtime_error("No plugin found at " + plugin.path);
     }
 
-    auto instance = formatManager.createPluginInstance(*descriptions[0],
-                                                        sampleRate,
-                                                        blockSize,
-                                                        error);
+    // on the message thread, which also means one instance at a time when streams start together
+    auto instance = MessageThread::instance().call([&]() {
+        return formatManager.createPluginInstance(*descriptions[0], sampleRate, blockSize, error);
+    });
 
     if (instance == nullptr)
     {
@@ -39,3 +50,18 @@ std::unique_ptr<AudioPluginInstance> PluginManager::loadPlugin(
     }
     return instance;
 }
+
+std::unique_ptr<AudioPluginInstance> PluginManager::loadDirect(
+    const PluginDef& plugin, const double sampleRate, const int blockSize, String& error)
+{
+    // VST3 wants its component and controller initialised on the UI thread
+    auto instance = MessageThread::instance().call([&]() { return Vst3DirectInstance::create(plugin.path, error); });
+
+    if (instance == nullptr)
+    {
+        throw std::runtime_error("The plugin could not be instantiated: " + error.toStdString());
+    }
+    // like the JUCE path, the engine calls prepareToPlay once the instance is installed
+    instance->setRateAndBufferSizeDetails(sampleRate, blockSize);
+    return instance;
+}
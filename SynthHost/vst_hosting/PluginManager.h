@@ -16,6 +16,11 @@ public:
                                                            juce::String& error);
 
 private:
+    std::unique_ptr<juce::AudioPluginInstance> loadDirect (const PluginDef& plugin,
+                                                           double sampleRate,
+                                                           int blockSize,
+                                                           juce::String& error);
+
     juce::AudioPluginFormatManager formatManager;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "PluginScanCache.h"
+
+#include <chrono>
+#include <iostream>
+
+using namespace juce;
+
+PluginScanCache& PluginScanCache::instance()
+{
+    static PluginScanCache cache;
+    return cache;
+}
+
+void PluginScanCache::setCacheFile (const File& file)
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    cacheFile = file;
+    loaded = false;
+}
+
+// A VST3 "file" is usually a bundle directory; its stamp covers every file inside it.
+PluginScanCache::Stamp PluginScanCache::stampOf (const File& file)
+{
+    Stamp stamp;
+    if (! file.isDirectory())
+    {
+        stamp.size = file.getSize();
+        stamp.modified = file.getLastModificationTime().toMilliseconds();
+        return stamp;
+    }
+    stamp.modified = file.getLastModificationTime().toMilliseconds();
+    for (const auto& entry : RangedDirectoryIterator (file, true, "*", File::findFiles))
+    {
+        stamp.size += entry.getFileSize();
+        stamp.modified = jmax (stamp.modified, entry.getModificationTime().toMilliseconds());
+    }
+    return stamp;
+}
+
+void PluginScanCache::loadIfNeeded()
+{
+    if (loaded)
+        return;
+    loaded = true;
+    if (cacheFile == File())
+        cacheFile = File::getSpecialLocation (File::userApplicationDataDirectory)
+                        .getChildFile ("SynthHost")
+                        .getChildFile ("plugin-scan-cache.xml");
+
+    auto started = std::chrono::steady_clock::now();
+    knownPlugins.clear();
+    stamps.clear();
+    auto xml = parseXML (cacheFile);
+    if (xml == nullptr || ! xml->hasTagName ("PLUGINSCANCACHE"))
+        return;
+
+    if (auto* list = xml->getChildByName ("KNOWNPLUGINS"))
+        knownPlugins.recreateFromXml (*list);
+    if (auto* files = xml->getChildByName ("FILES"))
+    {
+        for (auto* entry : files->getChildWithTagNameIterator ("FILE"))
+        {
+            Stamp stamp;
+            stamp.size = entry->getStringAttribute ("size").getLargeIntValue();
+            stamp.modified = entry->getStringAttribute ("modified").getLargeIntValue();
+            stamps[entry->getStringAttribute ("path")] = stamp;
+        }
+    }
+    loadMicros.store (std::chrono::duration_cast<std::chrono::microseconds> (
+        std::chrono::steady_clock::now() - started).count());
+    std::cout << "[plugin scan] loaded " << stamps.size() << " cached plugin(s) from "
+              << cacheFile.getFullPathName() << std::endl;
+}
+
+void PluginScanCache::save() const
+{
+    XmlElement root ("PLUGINSCANCACHE");
+    if (auto list = knownPlugins.createXml())
+    {
+        list->setTagName ("KNOWNPLUGINS");
+        root.addChildElement (list.release());
+    }
+    auto* files = root.createNewChildElement ("FILES");
+    for (const auto& entry : stamps)
+    {
+        auto* file = files->createNewChildElement ("FILE");
+        file->setAttribute ("path", entry.first);
+        file->setAttribute ("size", String (entry.second.size));
+        file->setAttribute ("modified", String (entry.second.modified));
+    }
+    cacheFile.getParentDirectory().createDirectory();
+    if (! root.writeTo (cacheFile))
+        std::cout << "[plugin scan] could not write " << cacheFile.getFullPathName() << std::endl;
+}
+
+bool PluginScanCache::findTypes (const String& path,
+                                 AudioPluginFormatManager& formats,
+                                 OwnedArray<PluginDescription>& descriptions)
+{
+    // held across the scan: streams created together wait for one scan instead of each running their own
+    std::lock_guard<std::mutex> lock (mutex);
+    loadIfNeeded();
+
+    auto stamp = stampOf (File (path));
+    auto cached = stamps.find (path);
+    if (cached != stamps.end() && cached->second == stamp)
+    {
+        for (const auto& type : knownPlugins.getTypes())
+            if (type.fileOrIdentifier == path)
+                descriptions.add (new PluginDescription (type));
+        if (! descriptions.isEmpty())
+        {
+            hits.fetch_add (1);
+            return true;
+        }
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    for (const auto& type : knownPlugins.getTypes())
+        if (type.fileOrIdentifier == path)
+            knownPlugins.removeType (type);
+    for (int i = 0; i < formats.getNumFormats(); ++i)
+        knownPlugins.scanAndAddFile (path, false, descriptions, *formats.getFormat (i));
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds> (
+        std::chrono::steady_clock::now() - started).count();
+    scans.fetch_add (1);
+    scanMicros.fetch_add (micros);
+    std::cout << "[plugin scan] scanned " << path << " in " << micros / 1000 << " ms" << std::endl;
+
+    if (! descriptions.isEmpty())
+    {
+        stamps[path] = stamp;
+        save();
+    }
+    return false;
+}
+
+void PluginScanCache::clear()
+{
+    std::lock_guard<std::mutex> lock (mutex);
+    loadIfNeeded();
+    knownPlugins.clear();
+    stamps.clear();
+    cacheFile.deleteFile();
+}
+
+void PluginScanCache::printStats() const
+{
+    std::cout << "[plugin scan] cache hits: " << hits.load()
+              << " | scans: " << scans.load()
+              << " | scan time: " << scanMicros.load() / 1000 << " ms"
+              << " | cache load: " << loadMicros.load() / 1000.0 << " ms" << std::endl;
+}
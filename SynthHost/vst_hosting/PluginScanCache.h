@@ -0,0 +1,62 @@
+#ifndef PLUGINSCANCACHE_H
+#define PLUGINSCANCACHE_H
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+// Process-wide cache of plugin scan results, shared by every PluginManager. Descriptions live in
+// one KnownPluginList that is saved to disk next to a stamp (total size and latest modification
+// time) of each scanned plugin path, so a plugin is only scanned again when its files change --
+// not once per stream, and not again on the next start.
+class PluginScanCache
+{
+public:
+    static PluginScanCache& instance();
+
+    // Defaults to <user app data>/SynthHost/plugin-scan-cache.xml. Loads the file on first use.
+    void setCacheFile (const juce::File& file);
+
+    // Fills descriptions with the plugin types at path, scanning with formats on a miss.
+    // Returns true if the cached result was used.
+    bool findTypes (const juce::String& path,
+                    juce::AudioPluginFormatManager& formats,
+                    juce::OwnedArray<juce::PluginDescription>& descriptions);
+
+    // Forgets every cached scan, in memory and on disk.
+    void clear();
+
+    // Scans run so far; 0 after startup means every plugin came from the cache.
+    int getScanCount() const { return scans.load(); }
+
+    void printStats() const;
+
+private:
+    struct Stamp
+    {
+        juce::int64 size = 0;
+        juce::int64 modified = 0;
+
+        bool operator== (const Stamp& other) const { return size == other.size && modified == other.modified; }
+    };
+
+    PluginScanCache() = default;
+
+    static Stamp stampOf (const juce::File& file);
+    void loadIfNeeded();
+    void save() const;
+
+    mutable std::mutex mutex;
+    juce::File cacheFile;
+    bool loaded = false;
+    juce::KnownPluginList knownPlugins;
+    std::map<juce::String, Stamp> stamps;
+
+    std::atomic<int> hits { 0 };
+    std::atomic<int> scans { 0 };
+    std::atomic<int64_t> scanMicros { 0 };
+    std::atomic<int64_t> loadMicros { 0 };
+};
+
+#endif //PLUGINSCANCACHE_H
@@ -0,0 +1,401 @@
+#include "Vst3DirectInstance.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "public.sdk/source/common/memorystream.h"
+#include "public.sdk/source/vst/hosting/hostclasses.h"
+#include "public.sdk/source/vst/utility/stringconvert.h"
+#include "public.sdk/source/vst/vstpresetfile.h"
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace
+{
+    // Module handles stay loaded for the life of the process; every instance of a path shares one.
+    VST3::Hosting::Module::Ptr loadModule (const std::string& path, std::string& error)
+    {
+        static std::mutex mutex;
+        static std::map<std::string, VST3::Hosting::Module::Ptr> modules;
+
+        std::lock_guard<std::mutex> lock (mutex);
+        auto it = modules.find (path);
+        if (it != modules.end())
+            return it->second;
+
+        static HostApplication host;
+        PluginContextFactory::instance().setPluginContext (&host);
+
+        auto module = VST3::Hosting::Module::create (path, error);
+        if (module != nullptr)
+            modules[path] = module;
+        return module;
+    }
+}
+
+std::unique_ptr<Vst3DirectInstance> Vst3DirectInstance::create (const juce::String& path, juce::String& error)
+{
+    std::string moduleError;
+    auto module = loadModule (path.toStdString(), moduleError);
+    if (module == nullptr)
+    {
+        error = "Could not load VST3 module " + path + ": " + juce::String (moduleError);
+        return nullptr;
+    }
+
+    for (const auto& classInfo : module->getFactory().classInfos())
+    {
+        if (classInfo.category() != kVstAudioEffectClass)
+            continue;
+        auto provider = owned (new PlugProvider (module->getFactory(), classInfo, true));
+        if (! provider->initialize())
+        {
+            error = "Could not initialize " + juce::String (classInfo.name());
+            return nullptr;
+        }
+        return std::unique_ptr<Vst3DirectInstance> (new Vst3DirectInstance (module, provider, classInfo, path));
+    }
+    error = "No audio processor class in " + path;
+    return nullptr;
+}
+
+juce::AudioProcessor::BusesProperties Vst3DirectInstance::busesFor (IComponent* component)
+{
+    BusesProperties buses;
+    for (int32 i = 0; i < component->getBusCount (kAudio, kOutput); ++i)
+    {
+        BusInfo info {};
+        if (component->getBusInfo (kAudio, kOutput, i, info) == kResultTrue)
+            buses.addBus (false, "Output " + juce::String (i + 1),
+                          juce::AudioChannelSet::canonicalChannelSet (info.channelCount), i == 0);
+    }
+    return buses;
+}
+
+Vst3DirectInstance::Vst3DirectInstance (VST3::Hosting::Module::Ptr moduleToUse,
+                                        IPtr<PlugProvider> providerToUse,
+                                        const VST3::Hosting::ClassInfo& classInfo,
+                                        const juce::String& pathToUse)
+    : AudioPluginInstance (busesFor (providerToUse->getComponentPtr().get())),
+      module (std::move (moduleToUse)),
+      provider (std::move (providerToUse)),
+      component (provider->getComponentPtr()),
+      controller (provider->getControllerPtr()),
+      processor (component.get()),
+      classId (classInfo.ID()),
+      name (classInfo.name()),
+      vendor (classInfo.vendor()),
+      version (classInfo.version()),
+      path (pathToUse)
+{
+    for (auto& channel : controllerParams)
+        channel.fill (kNoParamId);
+
+    for (int32 i = 0; i < controller->getParameterCount(); ++i)
+    {
+        ParameterInfo info {};
+        if (controller->getParameterInfo (i, info) == kResultTrue)
+            parameterIds.push_back (info.id);
+    }
+    std::sort (parameterIds.begin(), parameterIds.end());
+    parameterIds.erase (std::unique (parameterIds.begin(), parameterIds.end()), parameterIds.end());
+    sentValues = std::make_unique<std::atomic<double>[]> (parameterIds.size());
+    forgetSentValues();
+}
+
+Vst3DirectInstance::~Vst3DirectInstance()
+{
+    activate (false);
+    processData.unprepare();
+}
+
+void Vst3DirectInstance::fillInPluginDescription (juce::PluginDescription& description) const
+{
+    description.name = name;
+    description.descriptiveName = name;
+    description.pluginFormatName = "VST3";
+    description.category = "Instrument";
+    description.manufacturerName = vendor;
+    description.version = version;
+    description.fileOrIdentifier = path;
+    description.isInstrument = true;
+    description.numInputChannels = getTotalNumInputChannels();
+    description.numOutputChannels = getTotalNumOutputChannels();
+    description.uniqueId = description.deprecatedUid = (int) juce::String (classId.toString()).hashCode();
+}
+
+void Vst3DirectInstance::activate (bool shouldBeActive)
+{
+    if (active == shouldBeActive || processor == nullptr)
+        return;
+    if (shouldBeActive)
+    {
+        component->setActive (true);
+        processor->setProcessing (true);
+    }
+    else
+    {
+        processor->setProcessing (false);
+        component->setActive (false);
+    }
+    active = shouldBeActive;
+}
+
+void Vst3DirectInstance::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    activate (false);
+    setRateAndBufferSizeDetails (sampleRate, maximumExpectedSamplesPerBlock);
+
+    ProcessSetup setup { kRealtime, kSample32, maximumExpectedSamplesPerBlock, sampleRate };
+    processor->setupProcessing (setup);
+    if (component->getBusCount (kAudio, kOutput) > 0)
+        component->activateBus (kAudio, kOutput, 0, true);
+    if (component->getBusCount (kEvent, kInput) > 0)
+        component->activateBus (kEvent, kInput, 0, true);
+
+    // bufferSamples = 0: only the per-bus pointer arrays are allocated, processBlock fills them in
+    processData.prepare (*component, 0, kSample32);
+    processData.processMode = kRealtime;
+    processData.inputEvents = &inputEvents;
+    processData.inputParameterChanges = &inputParameterChanges;
+    processData.processContext = &processContext;
+    inputEvents.clear();
+    inputParameterChanges.clearQueue();
+
+    processContext = {};
+    processContext.sampleRate = sampleRate;
+    processContext.tempo = 120.0;
+    processContext.timeSigNumerator = 4;
+    processContext.timeSigDenominator = 4;
+    processContext.state = ProcessContext::kPlaying | ProcessContext::kTempoValid | ProcessContext::kTimeSigValid;
+
+    int channels = 0;
+    for (int32 i = 0; i < processData.numInputs; ++i)
+        channels += processData.inputs[i].numChannels;
+    for (int32 i = 0; i < processData.numOutputs; ++i)
+        channels += processData.outputs[i].numChannels;
+    spareChannels.setSize (juce::jmax (1, channels), maximumExpectedSamplesPerBlock);
+    spareChannels.clear();
+
+    buildControllerMap();
+    activate (true);
+}
+
+void Vst3DirectInstance::releaseResources()
+{
+    activate (false);
+}
+
+void Vst3DirectInstance::reset()
+{
+    // a VST3 processor drops voices and tails on deactivation
+    if (active)
+    {
+        activate (false);
+        activate (true);
+    }
+}
+
+double Vst3DirectInstance::getTailLengthSeconds() const
+{
+    if (processor == nullptr || processContext.sampleRate <= 0.0)
+        return 0.0;
+    auto samples = processor->getTailSamples();
+    return samples == kInfiniteTail ? std::numeric_limits<double>::infinity()
+                                    : (double) samples / processContext.sampleRate;
+}
+
+void Vst3DirectInstance::buildControllerMap()
+{
+    for (auto& channel : controllerParams)
+        channel.fill (kNoParamId);
+
+    FUnknownPtr<IMidiMapping> mapping (controller.get());
+    if (mapping == nullptr)
+        return;
+    for (int16 channel = 0; channel < 16; ++channel)
+    {
+        for (int slot = 0; slot < controllerSlots; ++slot)
+        {
+            ParamID id = kNoParamId;
+            if (mapping->getMidiControllerAssignment (0, channel, (CtrlNumber) slot, id) == kResultTrue)
+                controllerParams[(size_t) channel][(size_t) slot] = id;
+        }
+    }
+}
+
+bool Vst3DirectInstance::findParameter (const juce::String& idOrTitle, ParamID& id) const
+{
+    const bool numeric = idOrTitle.containsOnly ("0123456789");
+    for (int32 i = 0; i < controller->getParameterCount(); ++i)
+    {
+        ParameterInfo info {};
+        if (controller->getParameterInfo (i, info) != kResultTrue)
+            continue;
+        if (numeric ? (ParamID) idOrTitle.getLargeIntValue() == info.id
+                    : idOrTitle.equalsIgnoreCase (juce::String (VST3::StringConvert::convert (info.title))))
+        {
+            id = info.id;
+            return true;
+        }
+    }
+    return false;
+}
+
+int Vst3DirectInstance::parameterIndex (ParamID id) const
+{
+    auto it = std::lower_bound (parameterIds.begin(), parameterIds.end(), id);
+    return it != parameterIds.end() && *it == id ? (int) (it - parameterIds.begin()) : -1;
+}
+
+void Vst3DirectInstance::forgetSentValues()
+{
+    for (size_t i = 0; i < parameterIds.size(); ++i)
+        sentValues[i].store (-1.0, std::memory_order_relaxed);
+}
+
+double Vst3DirectInstance::getParameterValue (ParamID id) const
+{
+    // the processor has moved on from what the controller shows once automation has been sent
+    auto index = parameterIndex (id);
+    if (index >= 0)
+    {
+        auto sent = sentValues[(size_t) index].load (std::memory_order_relaxed);
+        if (sent >= 0.0)
+            return sent;
+    }
+    return controller->getParamNormalized (id);
+}
+
+void Vst3DirectInstance::addControllerChange (int channel, int slot, double value, int sampleOffset)
+{
+    auto id = controllerParams[(size_t) channel][(size_t) slot];
+    if (id != kNoParamId)
+        addParameterChange (id, value, sampleOffset);
+}
+
+void Vst3DirectInstance::addParameterChange (ParamID id, double value, int sampleOffset)
+{
+    int32 queueIndex = 0;
+    if (auto* queue = inputParameterChanges.addParameterData (id, queueIndex))
+    {
+        int32 pointIndex = 0;
+        if (queue->addPoint (sampleOffset, value, pointIndex) == kResultTrue)
+        {
+            auto index = parameterIndex (id);
+            if (index >= 0)
+                sentValues[(size_t) index].store (value, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Vst3DirectInstance::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi)
+{
+    const int numSamples = buffer.getNumSamples();
+    if (! active || numSamples > spareChannels.getNumSamples())
+    {
+        inputParameterChanges.clearQueue();
+        buffer.clear();
+        return;
+    }
+
+    // inputParameterChanges may already hold this block's automation (addParameterChange)
+    inputEvents.clear();
+    for (const auto metadata : midi)
+    {
+        const auto message = metadata.getMessage();
+        const int channel = message.getChannel() - 1;
+        Event event {};
+        event.busIndex = 0;
+        event.sampleOffset = metadata.samplePosition;
+        if (message.isNoteOn())
+        {
+            event.type = Event::kNoteOnEvent;
+            event.noteOn.channel = (int16) channel;
+            event.noteOn.pitch = (int16) message.getNoteNumber();
+            event.noteOn.velocity = message.getFloatVelocity();
+            event.noteOn.noteId = -1;
+            inputEvents.addEvent (event);
+        }
+        else if (message.isNoteOff())
+        {
+            event.type = Event::kNoteOffEvent;
+            event.noteOff.channel = (int16) channel;
+            event.noteOff.pitch = (int16) message.getNoteNumber();
+            event.noteOff.velocity = message.getFloatVelocity();
+            event.noteOff.noteId = -1;
+            inputEvents.addEvent (event);
+        }
+        else if (message.isController())
+        {
+            addControllerChange (channel, message.getControllerNumber(), message.getControllerValue() / 127.0,
+                                 metadata.samplePosition);
+        }
+        else if (message.isPitchWheel())
+        {
+            addControllerChange (channel, kPitchBend, message.getPitchWheelValue() / 16383.0, metadata.samplePosition);
+        }
+        else if (message.isChannelPressure())
+        {
+            addControllerChange (channel, kAfterTouch, message.getChannelPressureValue() / 127.0,
+                                 metadata.samplePosition);
+        }
+    }
+
+    // the caller's channels are handed to the output buses as they are; anything left over uses spares
+    int nextChannel = 0;
+    int nextSpare = 0;
+    for (int32 i = 0; i < processData.numOutputs; ++i)
+    {
+        auto& bus = processData.outputs[i];
+        for (int32 ch = 0; ch < bus.numChannels; ++ch)
+            bus.channelBuffers32[ch] = nextChannel < buffer.getNumChannels()
+                                           ? buffer.getWritePointer (nextChannel++)
+                                           : spareChannels.getWritePointer (nextSpare++);
+        bus.silenceFlags = 0;
+    }
+    for (int32 i = 0; i < processData.numInputs; ++i)
+    {
+        auto& bus = processData.inputs[i];
+        for (int32 ch = 0; ch < bus.numChannels; ++ch)
+        {
+            bus.channelBuffers32[ch] = spareChannels.getWritePointer (nextSpare++);
+            juce::FloatVectorOperations::clear (bus.channelBuffers32[ch], numSamples);
+        }
+        bus.silenceFlags = bus.numChannels >= 64 ? ~uint64 (0) : (uint64 (1) << bus.numChannels) - 1;
+    }
+
+    processData.numSamples = numSamples;
+    processor->process (processData);
+    inputParameterChanges.clearQueue();
+    processContext.projectTimeSamples += numSamples;
+    processContext.continousTimeSamples += numSamples;
+
+    outputSilent = false;
+    if (processData.numOutputs > 0)
+    {
+        const auto& main = processData.outputs[0];
+        const uint64 all = main.numChannels >= 64 ? ~uint64 (0) : (uint64 (1) << main.numChannels) - 1;
+        outputSilent = main.numChannels > 0 && (main.silenceFlags & all) == all;
+    }
+    // a plugin reporting silence doesn't have to write its buffers
+    if (outputSilent)
+        buffer.clear();
+}
+
+void Vst3DirectInstance::getStateInformation (juce::MemoryBlock& destData)
+{
+    MemoryStream stream;
+    if (PresetFile::savePreset (&stream, FUID::fromTUID (classId.data()), component.get(), controller.get()))
+        destData.replaceAll (stream.getData(), (size_t) stream.getSize());
+}
+
+void Vst3DirectInstance::setStateInformation (const void* data, int sizeInBytes)
+{
+    MemoryStream stream (const_cast<void*> (data), sizeInBytes);
+    PresetFile::loadPreset (&stream, FUID::fromTUID (classId.data()), component.get(), controller.get());
+    // the loaded state is what both sides now hold
+    forgetSentValues();
+}
@@ -0,0 +1,117 @@
+#ifndef VST3DIRECTINSTANCE_H
+#define VST3DIRECTINSTANCE_H
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "public.sdk/source/vst/hosting/eventlist.h"
+#include "public.sdk/source/vst/hosting/module.h"
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#include "public.sdk/source/vst/hosting/plugprovider.h"
+#include "public.sdk/source/vst/hosting/processdata.h"
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "pluginterfaces/vst/ivsteditcontroller.h"
+#include "pluginterfaces/vst/ivstmidicontrollers.h"
+
+// A VST3 plugin hosted straight through the vst3sdk hosting classes instead of JUCE's VST3 wrapper,
+// behind the same juce::AudioPluginInstance interface so the engine, the instance pool and preset
+// loading don't care which backend a stream uses.
+//
+// Everything process() touches is set up in prepareToPlay(): the ProcessData bus arrays point
+// straight at the caller's AudioBuffer channels (no copies), the event list and parameter queues
+// have fixed capacity, and controller input is mapped to parameters through a lookup table filled
+// from IMidiMapping. Output silence flags come back through isOutputSilent().
+class Vst3DirectInstance : public juce::AudioPluginInstance
+{
+public:
+    // Loads the module (once per path) and instantiates its first audio effect class.
+    static std::unique_ptr<Vst3DirectInstance> create (const juce::String& path, juce::String& error);
+
+    ~Vst3DirectInstance() override;
+
+    const juce::String getName() const override { return name; }
+    void fillInPluginDescription (juce::PluginDescription& description) const override;
+
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override;
+    void reset() override;
+
+    double getTailLengthSeconds() const override;
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return false; }
+
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram (int) override {}
+    const juce::String getProgramName (int) override { return {}; }
+    void changeProgramName (int, const juce::String&) override {}
+
+    // State is a .vstpreset image (component + controller state), so preset files load as-is.
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+    // True if the plugin flagged every output channel of the last block as silent.
+    bool isOutputSilent() const { return outputSilent; }
+
+    Steinberg::Vst::IEditController* getController() const { return controller.get(); }
+
+    // Looks a parameter up by its numeric id or title.
+    bool findParameter (const juce::String& idOrTitle, Steinberg::Vst::ParamID& id) const;
+    // The value last queued for the processor through addParameterChange(), which the controller
+    // doesn't see; the controller's value for parameters not automated since the last state load.
+    double getParameterValue (Steinberg::Vst::ParamID id) const;
+
+    // Audio thread, before processBlock(): queues a normalized value for the next block at the
+    // given sample offset. Points of one parameter must come in increasing offset order.
+    void addParameterChange (Steinberg::Vst::ParamID id, double value, int sampleOffset);
+
+private:
+    Vst3DirectInstance (VST3::Hosting::Module::Ptr module,
+                        Steinberg::IPtr<Steinberg::Vst::PlugProvider> provider,
+                        const VST3::Hosting::ClassInfo& classInfo,
+                        const juce::String& path);
+
+    static BusesProperties busesFor (Steinberg::Vst::IComponent* component);
+    void activate (bool shouldBeActive);
+    void buildControllerMap();
+    void addControllerChange (int channel, int slot, double value, int sampleOffset);
+    int parameterIndex (Steinberg::Vst::ParamID id) const;
+    void forgetSentValues();
+
+    static constexpr int maxEvents = 512;
+    static constexpr int maxParameterChanges = 128;
+    static constexpr int controllerSlots = Steinberg::Vst::kCountCtrlNumber;
+
+    VST3::Hosting::Module::Ptr module;
+    Steinberg::IPtr<Steinberg::Vst::PlugProvider> provider;
+    Steinberg::IPtr<Steinberg::Vst::IComponent> component;
+    Steinberg::IPtr<Steinberg::Vst::IEditController> controller;
+    Steinberg::FUnknownPtr<Steinberg::Vst::IAudioProcessor> processor;
+    VST3::UID classId;
+    juce::String name, vendor, version, path;
+
+    Steinberg::Vst::HostProcessData processData;
+    Steinberg::Vst::ProcessContext processContext {};
+    Steinberg::Vst::EventList inputEvents { maxEvents };
+    Steinberg::Vst::ParameterChanges inputParameterChanges { maxParameterChanges };
+    // channels of buses beyond what the caller's buffer provides (sidechains, extra outputs)
+    juce::AudioBuffer<float> spareChannels;
+    // MIDI CCs / pitch bend / aftertouch per channel -> parameter, kNoParamId if unmapped
+    std::array<std::array<Steinberg::Vst::ParamID, controllerSlots>, 16> controllerParams {};
+    // sorted parameter ids and, per id, the value last sent to the processor (-1 = none since the
+    // last state load); fixed at construction so the audio thread only does a lookup
+    std::vector<Steinberg::Vst::ParamID> parameterIds;
+    std::unique_ptr<std::atomic<double>[]> sentValues;
+    bool active = false;
+    bool outputSilent = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Vst3DirectInstance)
+};
+
+#endif //VST3DIRECTINSTANCE_H
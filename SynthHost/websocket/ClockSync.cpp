@@ -0,0 +1,103 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+int64_t ClockSync::nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+nlohmann::json ClockSync::makePing() {
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t seq = ++nextSeq;
+    int64_t t0 = nowMillis();
+    sent[size_t(seq) % OUTSTANDING] = {seq, t0};
+    return {{"type", "ping"}, {"seq", seq}, {"timestamp", t0}};
+}
+
+void ClockSync::onPong(const MidiEvent& pong) {
+    int64_t t3 = nowMillis();
+    std::lock_guard<std::mutex> lock(mutex);
+    // an old, foreign or replayed pong would skew the offset
+    const auto& ping = sent[size_t(pong.seq) % OUTSTANDING];
+    if (pong.seq <= 0 || ping.first != pong.seq || ping.second != pong.t0) {
+        rejectedPongs.fetch_add(1);
+        return;
+    }
+    int64_t t0 = ping.second, t1 = pong.t1, t2 = pong.timestamp;
+    int64_t rtt = (t3 - t0) - (t2 - t1);
+    if (rtt < 0) {
+        rejectedPongs.fetch_add(1);
+        return;
+    }
+    int64_t offset = ((t1 - t0) + (t2 - t3)) / 2;
+
+    auto& peer = peers[pong.peer];
+    peer.samples[peer.next] = {offset, rtt};
+    peer.next = (peer.next + 1) % WINDOW;
+    peer.sampleCount = std::min(peer.sampleCount + 1, WINDOW);
+    ++peer.pongs;
+
+    const Sample* best = &peer.samples[0];
+    for (size_t i = 1; i < peer.sampleCount; ++i) {
+        if (peer.samples[i].rtt < best->rtt)
+            best = &peer.samples[i];
+    }
+    peer.offset = best->offset;
+    peer.rtt = best->rtt;
+
+    if (peer.pongs == 1) {
+        peer.firstOffset = peer.offset;
+        peer.firstAt = t3;
+    } else if (t3 - peer.firstAt >= DRIFT_MIN_SPAN_MS) {
+        peer.driftPpm = double(peer.offset - peer.firstOffset) * 1e6 / double(t3 - peer.firstAt);
+    }
+}
+
+int64_t ClockSync::toHostMillis(const std::string& peer, int64_t peerMillis) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = peers.find(peer);
+    return it == peers.end() ? peerMillis : peerMillis - it->second.offset;
+}
+
+void ClockSync::recordLate(const std::string& peer, int64_t lateMillis, bool dropped) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& p = peers[peer];
+    ++p.late;
+    if (dropped)
+        ++p.dropped;
+    p.maxLate = std::max(p.maxLate, lateMillis);
+}
+
+nlohmann::json ClockSync::report() const {
+    auto list = nlohmann::json::array();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry: peers) {
+        const auto& p = entry.second;
+        list.push_back({
+            {"peer", entry.first},
+            {"offset", p.offset},
+            {"rtt", p.rtt},
+            {"drift_ppm", p.driftPpm},
+            {"pongs", p.pongs},
+            {"late", p.late},
+            {"dropped", p.dropped},
+            {"max_late", p.maxLate}
+        });
+    }
+    return {{"event", "clock"}, {"peers", list}, {"rejected_pongs", rejectedPongs.load()}};
+}
+
+void ClockSync::printStats() const {
+    for (const auto& peer: report().at("peers")) {
+        std::cout << "[clock " << peer.at("peer").get<std::string>() << "] offset " << peer.at("offset")
+                  << " ms | rtt " << peer.at("rtt") << " ms | drift " << peer.at("drift_ppm")
+                  << " ppm | late " << peer.at("late") << " (dropped " << peer.at("dropped")
+                  << ", max " << peer.at("max_late") << " ms)" << std::endl;
+    }
+    if (rejectedPongs.load() > 0)
+        std::cout << "[clock] rejected pongs: " << rejectedPongs.load() << std::endl;
+}
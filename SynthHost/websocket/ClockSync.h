@@ -0,0 +1,74 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <nlohmann/json.hpp>
+
+#include "MidiEvent.h"
+
+// NTP-style estimate of each peer's clock relative to the host's system_clock.
+// The host sends {"type":"ping","seq":n,"timestamp":t0}; a peer answers with
+// {"type":"pong","peer":id,"seq":n,"t0":t0,"t1":<received>,"timestamp":<sent>}. With t3 the
+// arrival of the pong, offset = ((t1 - t0) + (t2 - t3)) / 2 and rtt = (t3 - t0) - (t2 - t1).
+// Queueing only ever makes a sample's rtt larger, so of the last few samples the one with the
+// smallest rtt is taken as the current offset. A pong only counts if it answers one of the last
+// OUTSTANDING pings, with the t0 that ping carried; anything else is ignored.
+class ClockSync {
+public:
+    static int64_t nowMillis();
+
+    nlohmann::json makePing();
+
+    void onPong(const MidiEvent& pong);
+
+    // Peer epoch ms -> host epoch ms. Peers without a pong yet are assumed to share the host clock.
+    int64_t toHostMillis(const std::string& peer, int64_t peerMillis) const;
+
+    // An event that arrived after its (translated) play time.
+    void recordLate(const std::string& peer, int64_t lateMillis, bool dropped);
+
+    // {"event": "clock", "peers": [{peer, offset, rtt, drift_ppm, pongs, late, dropped, max_late}]}
+    nlohmann::json report() const;
+
+    void printStats() const;
+
+private:
+    static constexpr size_t WINDOW = 8;
+    static constexpr size_t OUTSTANDING = 16;
+    // drift is only reported once the estimates span this long
+    static constexpr int64_t DRIFT_MIN_SPAN_MS = 10'000;
+
+    struct Sample {
+        int64_t offset = 0;
+        int64_t rtt = 0;
+    };
+
+    struct Peer {
+        std::array<Sample, WINDOW> samples{};
+        size_t sampleCount = 0;
+        size_t next = 0;
+        int64_t offset = 0;
+        int64_t rtt = 0;
+        int64_t firstOffset = 0;
+        int64_t firstAt = 0;
+        double driftPpm = 0.0;
+        uint64_t pongs = 0;
+        uint64_t late = 0;
+        uint64_t dropped = 0;
+        int64_t maxLate = 0;
+    };
+
+    // the pings last sent, as (seq, t0), by seq % OUTSTANDING; seq 0 marks a free slot
+    std::array<std::pair<int64_t, int64_t>, OUTSTANDING> sent{};
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Peer> peers;
+    int64_t nextSeq = 0;
+    std::atomic<uint64_t> rejectedPongs{0};
+};
+
+#endif //CLOCKSYNC_H
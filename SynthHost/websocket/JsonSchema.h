@@ -0,0 +1,161 @@
+#ifndef JSONSCHEMA_H
+#define JSONSCHEMA_H
+
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Describes how the top-level keys of a flat JSON object map onto the members of T.
+// decode() drives nlohmann's SAX parser straight over the raw bytes, so no intermediate
+// std::string copy of the message and no DOM are built. Nested objects/arrays and unknown
+// keys are skipped.
+template <typename T>
+class JsonSchema {
+public:
+    JsonSchema& field(std::string key, std::string T::* member, bool required = true) {
+        return add(std::move(key), member, required);
+    }
+
+    JsonSchema& field(std::string key, int T::* member, bool required = true) {
+        return add(std::move(key), member, required);
+    }
+
+    JsonSchema& field(std::string key, int64_t T::* member, bool required = true) {
+        return add(std::move(key), member, required);
+    }
+
+    JsonSchema& field(std::string key, double T::* member, bool required = true) {
+        return add(std::move(key), member, required);
+    }
+
+    JsonSchema& field(std::string key, bool T::* member, bool required = true) {
+        return add(std::move(key), member, required);
+    }
+
+    // Returns false on malformed JSON, a type mismatch or a missing required key.
+    bool decode(const char* begin, const char* end, T& out) const {
+        Sax sax(*this, out);
+        if (!nlohmann::json::sax_parse(begin, end, &sax))
+            return false;
+        return (sax.seen & requiredMask) == requiredMask;
+    }
+
+private:
+    using Member = std::variant<std::string T::*, int T::*, int64_t T::*, double T::*, bool T::*>;
+
+    struct Field {
+        std::string key;
+        Member member;
+    };
+
+    JsonSchema& add(std::string key, Member member, bool required) {
+        if (required)
+            requiredMask |= uint64_t(1) << fields.size();
+        fields.push_back({std::move(key), member});
+        return *this;
+    }
+
+    // Minimal nlohmann SAX consumer: only values directly under the root object are bound.
+    class Sax {
+    public:
+        using number_integer_t = nlohmann::json::number_integer_t;
+        using number_unsigned_t = nlohmann::json::number_unsigned_t;
+        using number_float_t = nlohmann::json::number_float_t;
+        using string_t = nlohmann::json::string_t;
+        using binary_t = nlohmann::json::binary_t;
+
+        Sax(const JsonSchema& schema, T& out) : schema(schema), out(out) {}
+
+        bool null() {
+            active = -1;
+            return true;
+        }
+
+        bool boolean(bool val) {
+            if (auto* m = current<bool>()) { out.*(*m) = val; return mark(); }
+            return !bound();
+        }
+
+        bool number_integer(number_integer_t val) { return number(val); }
+
+        bool number_unsigned(number_unsigned_t val) { return number(static_cast<number_integer_t>(val)); }
+
+        bool number_float(number_float_t val, const string_t&) {
+            if (auto* m = current<double>()) { out.*(*m) = val; return mark(); }
+            return !bound();
+        }
+
+        bool string(string_t& val) {
+            if (auto* m = current<std::string>()) { out.*(*m) = std::move(val); return mark(); }
+            return !bound();
+        }
+
+        bool binary(binary_t&) { return !bound(); }
+
+        bool start_object(std::size_t) {
+            if (depth == 1 && bound()) return false;
+            ++depth;
+            return true;
+        }
+
+        bool end_object() { --depth; return true; }
+
+        bool start_array(std::size_t) {
+            if (depth == 1 && bound()) return false;
+            ++depth;
+            return true;
+        }
+
+        bool end_array() { --depth; return true; }
+
+        bool key(string_t& key) {
+            if (depth != 1) return true;
+            active = -1;
+            for (std::size_t i = 0; i < schema.fields.size(); ++i) {
+                if (schema.fields[i].key == key) {
+                    active = static_cast<int>(i);
+                    break;
+                }
+            }
+            return true;
+        }
+
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) { return false; }
+
+        uint64_t seen = 0;
+
+    private:
+        bool bound() const { return depth == 1 && active >= 0; }
+
+        template <typename V>
+        V T::* const* current() const {
+            if (!bound()) return nullptr;
+            return std::get_if<V T::*>(&schema.fields[active].member);
+        }
+
+        bool number(number_integer_t val) {
+            if (auto* m = current<int>()) { out.*(*m) = static_cast<int>(val); return mark(); }
+            if (auto* m = current<int64_t>()) { out.*(*m) = static_cast<int64_t>(val); return mark(); }
+            if (auto* m = current<double>()) { out.*(*m) = static_cast<double>(val); return mark(); }
+            return !bound();
+        }
+
+        bool mark() {
+            seen |= uint64_t(1) << active;
+            active = -1;
+            return true;
+        }
+
+        const JsonSchema& schema;
+        T& out;
+        int depth = 0;
+        int active = -1;
+    };
+
+    std::vector<Field> fields;
+    uint64_t requiredMask = 0;
+};
+
+#endif //JSONSCHEMA_H
@@ -0,0 +1,43 @@
+#ifndef MIDIEVENT_H
+#define MIDIEVENT_H
+
+#include <cstdint>
+#include <string>
+
+#include "JsonSchema.h"
+
+// Typed mirror of the bridge's MidiEventDto, decoded without building a json DOM.
+// Also carries the clock-sync pong ("type": "pong"), which only sets the peer/seq/t0/t1 fields
+// and uses timestamp as its send time; see ClockSync.
+struct MidiEvent {
+    std::string type;
+    std::string role;
+    int note = 0;
+    int velocity = 0;
+    int64_t timestamp = 0;
+    std::string session;
+    // events of one generated phrase share an id; "type": "cancel" drops whatever is still queued
+    int64_t phraseId = 0;
+    std::string peer;
+    int64_t seq = 0;
+    int64_t t0 = 0;
+    int64_t t1 = 0;
+
+    static const JsonSchema<MidiEvent>& schema() {
+        static const JsonSchema<MidiEvent> s = JsonSchema<MidiEvent>()
+                .field("type", &MidiEvent::type)
+                .field("role", &MidiEvent::role, false)
+                .field("note", &MidiEvent::note, false)
+                .field("velocity", &MidiEvent::velocity, false)
+                .field("timestamp", &MidiEvent::timestamp)
+                .field("session", &MidiEvent::session, false)
+                .field("phrase_id", &MidiEvent::phraseId, false)
+                .field("peer", &MidiEvent::peer, false)
+                .field("seq", &MidiEvent::seq, false)
+                .field("t0", &MidiEvent::t0, false)
+                .field("t1", &MidiEvent::t1, false);
+        return s;
+    }
+};
+
+#endif //MIDIEVENT_H
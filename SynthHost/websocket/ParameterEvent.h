@@ -0,0 +1,34 @@
+#ifndef PARAMETEREVENT_H
+#define PARAMETEREVENT_H
+
+#include <cstdint>
+#include <string>
+
+#include "JsonSchema.h"
+
+// Typed mirror of the bridge's ParameterAutomationDto: moves one plugin parameter of a role's
+// streams to a normalized value. parameter is the plugin's parameter id (or its name), the move
+// is ramped over ramp_ms and starts at timestamp (peer clock, see ClockSync), or on arrival if 0.
+struct ParameterEvent {
+    std::string session;
+    std::string role;
+    std::string parameter;
+    double value = 0.0;
+    int rampMs = 20;
+    int64_t timestamp = 0;
+    std::string peer;
+
+    static const JsonSchema<ParameterEvent>& schema() {
+        static const JsonSchema<ParameterEvent> s = JsonSchema<ParameterEvent>()
+                .field("session", &ParameterEvent::session, false)
+                .field("role", &ParameterEvent::role, false)
+                .field("parameter", &ParameterEvent::parameter)
+                .field("value", &ParameterEvent::value)
+                .field("ramp_ms", &ParameterEvent::rampMs, false)
+                .field("timestamp", &ParameterEvent::timestamp, false)
+                .field("peer", &ParameterEvent::peer, false);
+        return s;
+    }
+};
+
+#endif //PARAMETEREVENT_H
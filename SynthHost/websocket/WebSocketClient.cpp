@@ -1,5 +1,6 @@
 #include "WebSocketClient.h"
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
@@ -19,21 +20,115 @@ void WebSocketClient::onJson(JsonHandler jsonHandler) {
     this->jsonHandler = std::move(jsonHandler);
 }
 
-void WebSocketClient::sendJson(const json &json) {
-    auto stringJson = json.dump();
-    net::post(socket.get_executor(), [self = shared_from_this(), stringJson=std::move(stringJson)]() {
-        self->socket.async_write(net::buffer(stringJson), beast::bind_front_handler(&WebSocketClient::onWrite, self));
+void WebSocketClient::setOutboundConfig(OutboundConfig config) {
+    net::post(socket.get_executor(), [self = shared_from_this(), config]() {
+        self->outboundConfig = config;
     });
 }
 
+void WebSocketClient::sendJson(const json &json, std::string mergeKey,
+                               std::chrono::steady_clock::time_point capturedAt) {
+    Outbound message{json.dump(), std::move(mergeKey), std::chrono::steady_clock::now(), capturedAt};
+    net::post(socket.get_executor(), [self = shared_from_this(), message = std::move(message)]() mutable {
+        self->enqueue(std::move(message));
+    });
+}
+
+void WebSocketClient::enqueue(Outbound message) {
+    if (overflowed.load(std::memory_order_relaxed)) {
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // only the newest entry is replaced: moving a value back past a note queued after it would
+    // reorder the stream (a CC64 release landing ahead of the notes it was released after)
+    if (!message.mergeKey.empty() && !outbox.empty() && outbox.back().mergeKey == message.mergeKey) {
+        outbox.back().payload = std::move(message.payload);
+        mergedMessages.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (outbox.size() >= outboundConfig.maxQueueDepth && !outbox.empty()) {
+        auto stale = std::find_if(outbox.begin(), outbox.end(), [](const Outbound &queued) {
+            return !queued.mergeKey.empty();
+        });
+        if (stale != outbox.end()) {
+            outbox.erase(stale);
+            droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        } else if (!message.mergeKey.empty()) {
+            // nothing older is stale-able, so this one goes
+            droppedMessages.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else if (outbox.size() >= outboundConfig.maxBacklog) {
+            // a note dropped here could be a note-off and leave a note hanging downstream
+            return disconnectSlowPeer();
+        }
+    }
+    outbox.push_back(std::move(message));
+    queueDepth.store(outbox.size(), std::memory_order_relaxed);
+    if (outbox.size() > peakQueueDepth.load(std::memory_order_relaxed))
+        peakQueueDepth.store(outbox.size(), std::memory_order_relaxed);
+    if (connected && !writing) doWrite();
+}
+
+void WebSocketClient::disconnectSlowPeer() {
+    std::cout << "[ws " << url << "] peer is " << outbox.size() << " messages behind, closing the connection"
+              << std::endl;
+    overflowed.store(true, std::memory_order_relaxed);
+    droppedMessages.fetch_add(static_cast<int64_t>(outbox.size()) + 1, std::memory_order_relaxed);
+    outbox.clear();
+    queueDepth.store(0, std::memory_order_relaxed);
+    closing = true;
+    connected = false;
+    beast::error_code ec;
+    socket.next_layer().close(ec);
+}
+
+void WebSocketClient::doWrite() {
+    if (outbox.empty()) {
+        writing = false;
+        if (closing && connected) {
+            connected = false;
+            socket.async_close(websocket::close_code::normal,
+                               beast::bind_front_handler(&WebSocketClient::onClose, shared_from_this()));
+        }
+        return;
+    }
+    writing = true;
+    inFlight.clear();
+    writeBuffer.clear();
+    if (!outboundConfig.coalesce || outbox.size() == 1) {
+        writeBuffer = std::move(outbox.front().payload);
+        inFlight.push_back(std::move(outbox.front()));
+        outbox.pop_front();
+    } else {
+        // everything that piled up behind the previous write goes out as one array frame
+        writeBuffer.push_back('[');
+        while (!outbox.empty()) {
+            auto &next = outbox.front();
+            if (!inFlight.empty() && writeBuffer.size() + next.payload.size() + 2 > outboundConfig.maxBatchBytes)
+                break;
+            if (!inFlight.empty()) writeBuffer.push_back(',');
+            writeBuffer += next.payload;
+            inFlight.push_back(std::move(next));
+            outbox.pop_front();
+        }
+        writeBuffer.push_back(']');
+    }
+    queueDepth.store(outbox.size(), std::memory_order_relaxed);
+    socket.async_write(net::buffer(writeBuffer), beast::bind_front_handler(&WebSocketClient::onWrite, shared_from_this()));
+}
+
 void WebSocketClient::close() {
     if (closing) {
         return;
     }
     closing = true;
     net::post(socket.get_executor(), [self = shared_from_this()]() {
-        self->socket.async_close(websocket::close_code::normal,
-                                 beast::bind_front_handler(&WebSocketClient::onClose, self));
+        if (self->connected && !self->writing) {
+            self->doWrite();
+        } else if (!self->connected) {
+            beast::error_code ec;
+            self->socket.next_layer().close(ec);
+        }
     });
 }
 
@@ -58,7 +153,9 @@ void WebSocketClient::onConnect(beast::error_code ec, tcp::endpoint) {
 
 void WebSocketClient::onHandshake(beast::error_code ec) {
     if (ec) return fail(ec, "handshake");
+    connected = true;
     doRead();
+    if (!writing) doWrite();
 }
 
 void WebSocketClient::doRead() {
@@ -73,9 +170,17 @@ void WebSocketClient::onRead(beast::error_code ec, std::size_t bytes) {
         return;
     }
     try {
-        auto message = beast::buffers_to_string(buffer.data());
-        auto j = json::parse(message);
-        if (jsonHandler) jsonHandler(j);
+        if (rawHandler) {
+            auto data = buffer.data();
+            auto begin = static_cast<const char *>(data.data());
+            if (!rawHandler(begin, begin + data.size())) {
+                std::cout << "Could not decode message on " << url << std::endl;
+            }
+        } else {
+            auto message = beast::buffers_to_string(buffer.data());
+            auto j = json::parse(message);
+            if (jsonHandler) jsonHandler(j);
+        }
     } catch (std::exception &e) {
         std::cout << e.what() << std::endl;
     }
@@ -84,7 +189,18 @@ void WebSocketClient::onRead(beast::error_code ec, std::size_t bytes) {
 }
 
 void WebSocketClient::onWrite(beast::error_code ec, std::size_t bytes) {
-    if (ec) fail(ec, "write");
+    if (ec) {
+        writing = false;
+        return fail(ec, "write");
+    }
+    for (const auto &sent: inFlight) {
+        writeLatency.record(sent.enqueuedAt);
+        if (sent.capturedAt.time_since_epoch().count() != 0)
+            inputToWireLatency.record(sent.capturedAt);
+    }
+    writtenFrames.fetch_add(1, std::memory_order_relaxed);
+    writtenMessages.fetch_add(static_cast<int64_t>(inFlight.size()), std::memory_order_relaxed);
+    doWrite();
 }
 
 void WebSocketClient::onClose(beast::error_code ec) {
@@ -98,3 +214,13 @@ void WebSocketClient::fail(beast::error_code ec, char const *what) {
 WebSocketClientID WebSocketClient::getID() {
     return id;
 }
+
+void WebSocketClient::printStats() const {
+    std::cout << "[ws " << url << "] queue: " << queueDepth.load() << " (peak " << peakQueueDepth.load() << ")"
+              << " | sent: " << writtenMessages.load() << " msgs in " << writtenFrames.load() << " frames"
+              << " | merged: " << mergedMessages.load() << " | dropped: " << droppedMessages.load()
+              << (overflowed.load() ? " (closed, peer fell behind)" : "")
+              << " | write latency: " << writeLatency.summary() << std::endl;
+    if (inputToWireLatency.count() > 0)
+        std::cout << "[ws " << url << "] input-to-wire latency: " << inputToWireLatency.summary() << std::endl;
+}
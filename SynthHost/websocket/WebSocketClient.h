@@ -10,8 +10,13 @@
 #include <boost/beast/websocket.hpp>
 #include <boost/asio.hpp>
 #include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
 
+#include "JsonSchema.h"
 #include "../utils/WebSocketClientID.h"
+#include "../utils/LatencyStats.h"
 
 namespace beast = boost::beast;
 namespace websocket = beast::websocket;
@@ -19,16 +24,57 @@ namespace net = boost::asio;
 using tcp = net::ip::tcp;
 using json = nlohmann::json;
 
+struct OutboundConfig {
+    // Messages waiting behind the in-flight write; beyond this the oldest stale event is dropped.
+    std::size_t maxQueueDepth = 256;
+    // Events without a merge key (notes) are never dropped and queue past maxQueueDepth up to this;
+    // a peer that falls this far behind is disconnected instead of being sent a stream with holes.
+    std::size_t maxBacklog = 4096;
+    // Queued messages are sent together as one JSON array frame of at most this many bytes.
+    std::size_t maxBatchBytes = 8192;
+    bool coalesce = true;
+};
+
 class WebSocketClient : public std::enable_shared_from_this<WebSocketClient> {
 public:
     using JsonHandler = std::function<void(const json&)>;
+    // Decodes one raw text frame in place; returns false if the frame did not match.
+    using RawHandler = std::function<bool(const char* begin, const char* end)>;
     WebSocketClient(net::io_context& ioContext, std::string host, std::string port, std::string url, WebSocketClientID id);
     void run();
     void onJson(JsonHandler jsonHandler);
-    void sendJson(const json& json);
+
+    // Typed path: frames are SAX-decoded from the read buffer straight into T.
+    // Takes precedence over onJson when both are set.
+    template <typename T>
+    void onTyped(const JsonSchema<T>& schema, std::function<void(const T&)> handler) {
+        this->rawHandler = [schema, handler = std::move(handler)](const char* begin, const char* end) {
+            T value{};
+            if (!schema.decode(begin, end, value)) return false;
+            handler(value);
+            return true;
+        };
+    }
+
+    void setOutboundConfig(OutboundConfig config);
+
+    // Queues a message behind the single in-flight write. A non-empty mergeKey marks the event as
+    // stale-able: it replaces the last queued message if that has the same key and is dropped first when full;
+    // anything else is always delivered, or the connection is closed (see OutboundConfig::maxBacklog).
+    // capturedAt, when set, is when the event entered the host; it feeds the input-to-wire latency.
+    void sendJson(const json& json, std::string mergeKey = {},
+                  std::chrono::steady_clock::time_point capturedAt = {});
     void close();
     WebSocketClientID getID();
+    void printStats() const;
 private:
+    struct Outbound {
+        std::string payload;
+        std::string mergeKey;
+        std::chrono::steady_clock::time_point enqueuedAt;
+        std::chrono::steady_clock::time_point capturedAt;
+    };
+
     WebSocketClientID id;
     tcp::resolver resolver;
     websocket::stream<tcp::socket> socket;
@@ -37,7 +83,30 @@ private:
     std::string port;
     std::string url;
     JsonHandler jsonHandler;
-    bool closing = false;
+    RawHandler rawHandler;
+    std::atomic<bool> closing{false};
+
+    // outbound queue, only touched on the socket's strand
+    OutboundConfig outboundConfig;
+    std::deque<Outbound> outbox;
+    std::vector<Outbound> inFlight;
+    std::string writeBuffer;
+    bool connected = false;
+    bool writing = false;
+
+    std::atomic<std::size_t> queueDepth{0};
+    std::atomic<std::size_t> peakQueueDepth{0};
+    std::atomic<int64_t> droppedMessages{0};
+    std::atomic<int64_t> mergedMessages{0};
+    std::atomic<int64_t> writtenFrames{0};
+    std::atomic<int64_t> writtenMessages{0};
+    std::atomic<bool> overflowed{false};
+    LatencyStats writeLatency;
+    LatencyStats inputToWireLatency;
+
+    void enqueue(Outbound message);
+    void disconnectSlowPeer();
+    void doWrite();
     void onResolve(beast::error_code ec, tcp::resolver::results_type results);
     void onConnect(beast::error_code ec, tcp::endpoint);
     void onHandshake(beast::error_code ec);
@@ -17,6 +17,10 @@ public class AudioStreamManager : MonoBehaviour
     // we’ll start playback after this many floats are buffered:
     private int startThresholdSamples;
 
+    // SynthHost sends a silent block as an 8-byte marker: this magic ("SLNC"), then the frame count
+    private const int  SilenceMarkerBytes = 8;
+    private const uint SilenceMagic       = 0x434E4C53;
+
     void Start()
     {
         // Compute warm-up threshold: 3 × Unity’s DSP buffer (per channel)
@@ -55,9 +59,18 @@ public class AudioStreamManager : MonoBehaviour
             try
             {
                 byte[] data = udpClient.Receive(ref endpoint);
-                int floatCount = data.Length / sizeof(float);
-                var samples    = new float[floatCount];
-                Buffer.BlockCopy(data, 0, samples, 0, data.Length);
+                float[] samples;
+                if (data.Length == SilenceMarkerBytes && BitConverter.ToUInt32(data, 0) == SilenceMagic)
+                {
+                    // the plugin is idle: play the zeros it didn't send
+                    samples = new float[BitConverter.ToUInt32(data, 4) * channels];
+                }
+                else
+                {
+                    samples = new float[data.Length / sizeof(float)];
+                    Buffer.BlockCopy(data, 0, samples, 0, data.Length);
+                }
+                int floatCount = samples.Length;
 
                 blockCount++;
                 // Debug.Log($"📥 Received block #{blockCount}: {floatCount} floats");